@@ -0,0 +1,96 @@
+#include "acpi.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+enum {
+	BDA_EBDA_SEGMENT = 0x040E,
+	EBDA_SEARCH_SIZE = 0x400,
+	BIOS_AREA_BEGIN  = 0xE0000,
+	BIOS_AREA_END    = 0x100000,
+	RSDP_ALIGN       = 16
+};
+
+static bool             searched;
+static const acpi_rsdp* rsdp;
+
+static inline
+uint8_t acpi_checksum (const void* data, size_t size)
+{
+	const uint8_t* bytes = data;
+	uint8_t sum = 0;
+	for (size_t i = 0; i < size; ++i)
+		sum += bytes [i];
+	return sum;
+}
+
+static inline
+bool signature_equal (const char* a, const char* b, size_t n)
+{
+	for (size_t i = 0; i < n; ++i)
+		if (a [i] != b [i])
+			return false;
+	return true;
+}
+
+static
+const acpi_rsdp* search_rsdp (uintptr_t begin, uintptr_t end)
+{
+	for (uintptr_t addr = begin; addr + 20 <= end; addr += RSDP_ALIGN) {
+		const acpi_rsdp* candidate = (const acpi_rsdp*) addr;
+		if (signature_equal (candidate->signature, "RSD PTR ", 8) &&
+		    acpi_checksum (candidate, 20) == 0)
+			return candidate;
+	}
+	return NULL;
+}
+
+static
+const acpi_rsdp* find_rsdp (void)
+{
+	uintptr_t ebda = (uintptr_t) *(const volatile uint16_t*) BDA_EBDA_SEGMENT << 4;
+	const acpi_rsdp* result = NULL;
+	if (ebda != 0)
+		result = search_rsdp (ebda, ebda + EBDA_SEARCH_SIZE);
+	if (result == NULL)
+		result = search_rsdp (BIOS_AREA_BEGIN, BIOS_AREA_END);
+	return result;
+}
+
+static inline
+bool table_valid (const acpi_sdt_header* table)
+{
+	return acpi_checksum (table, table->length) == 0;
+}
+
+
+// Extern functions
+
+const acpi_sdt_header* acpi_find_table (const char* signature)
+{
+	if (!searched) {
+		rsdp = find_rsdp ();
+		searched = true;
+	}
+	if (rsdp == NULL)
+		return NULL;
+
+	bool extended = rsdp->revision >= 2 && rsdp->xsdt_address != 0;
+	const acpi_sdt_header* root = extended
+		? (const acpi_sdt_header*) (uintptr_t) rsdp->xsdt_address
+		: (const acpi_sdt_header*) (uintptr_t) rsdp->rsdt_address;
+	if (!table_valid (root))
+		return NULL;
+
+	size_t entry_size = extended ? sizeof (uint64_t) : sizeof (uint32_t);
+	size_t entries = (root->length - sizeof (acpi_sdt_header)) / entry_size;
+	const uint8_t* entry = (const uint8_t*) (root + 1);
+	for (size_t i = 0; i < entries; ++i, entry += entry_size) {
+		uint64_t address = extended
+			? *(const uint64_t*) entry
+			: *(const uint32_t*) entry;
+		const acpi_sdt_header* table = (const acpi_sdt_header*) (uintptr_t) address;
+		if (signature_equal (table->signature, signature, 4) && table_valid (table))
+			return table;
+	}
+	return NULL;
+}
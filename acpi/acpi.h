@@ -0,0 +1,118 @@
+#ifndef ACPI_H
+#define ACPI_H
+
+#include <stdint.h>
+
+typedef struct __attribute__ ((packed)) acpi_rsdp {
+	char     signature [8]; // "RSD PTR "
+	uint8_t  checksum;
+	char     oem_id [6];
+	uint8_t  revision;
+	uint32_t rsdt_address;
+
+	// Revision 2 and later
+	uint32_t length;
+	uint64_t xsdt_address;
+	uint8_t  extended_checksum;
+	uint8_t  reserved [3];
+} acpi_rsdp;
+
+typedef struct __attribute__ ((packed)) acpi_sdt_header {
+	char     signature [4];
+	uint32_t length;
+	uint8_t  revision;
+	uint8_t  checksum;
+	char     oem_id [6];
+	char     oem_table_id [8];
+	uint32_t oem_revision;
+	uint32_t creator_id;
+	uint32_t creator_revision;
+} acpi_sdt_header;
+_Static_assert (sizeof (acpi_sdt_header) == 36, "acpi_sdt_header not packed");
+
+typedef struct __attribute__ ((packed)) acpi_address {
+	uint8_t  address_space; // 0 = system memory, 1 = system I/O
+	uint8_t  bit_width;
+	uint8_t  bit_offset;
+	uint8_t  access_size;
+	uint64_t address;
+} acpi_address;
+
+typedef struct __attribute__ ((packed)) acpi_hpet {
+	acpi_sdt_header header;
+	uint32_t        event_timer_block_id;
+	acpi_address    base_address;
+	uint8_t         hpet_number;
+	uint16_t        minimum_tick;
+	uint8_t         page_protection;
+} acpi_hpet;
+
+typedef struct __attribute__ ((packed)) acpi_madt {
+	acpi_sdt_header header;
+	uint32_t        local_apic_address;
+	uint32_t        flags;
+} acpi_madt;
+
+typedef enum {
+	MADT_LOCAL_APIC      = 0,
+	MADT_IO_APIC         = 1,
+	MADT_SOURCE_OVERRIDE = 2,
+	MADT_LOCAL_APIC_NMI  = 4
+} acpi_madt_type;
+
+typedef struct __attribute__ ((packed)) acpi_madt_entry {
+	uint8_t type;
+	uint8_t length;
+} acpi_madt_entry;
+
+enum {
+	MADT_LOCAL_APIC_ENABLED        = 1 << 0,
+	MADT_LOCAL_APIC_ONLINE_CAPABLE = 1 << 1
+};
+
+typedef struct __attribute__ ((packed)) acpi_madt_local_apic {
+	acpi_madt_entry entry;
+	uint8_t         processor_id;
+	uint8_t         apic_id;
+	uint32_t        flags;
+} acpi_madt_local_apic;
+
+typedef struct __attribute__ ((packed)) acpi_madt_io_apic {
+	acpi_madt_entry entry;
+	uint8_t         io_apic_id;
+	uint8_t         reserved;
+	uint32_t        address;
+	uint32_t        gsi_base;
+} acpi_madt_io_apic;
+
+typedef struct __attribute__ ((packed)) acpi_madt_source_override {
+	acpi_madt_entry entry;
+	uint8_t         bus;
+	uint8_t         source; // ISA IRQ
+	uint32_t        gsi;
+	uint16_t        flags;
+} acpi_madt_source_override;
+
+static inline
+const acpi_madt_entry* acpi_madt_begin (const acpi_madt* madt)
+{
+	return (const acpi_madt_entry*) (madt + 1);
+}
+
+static inline
+const acpi_madt_entry* acpi_madt_end (const acpi_madt* madt)
+{
+	return (const acpi_madt_entry*) ((const uint8_t*) madt + madt->header.length);
+}
+
+static inline
+const acpi_madt_entry* acpi_madt_next (const acpi_madt_entry* entry)
+{
+	return (const acpi_madt_entry*) ((const uint8_t*) entry + entry->length);
+}
+
+// Returns NULL if there is no RSDP or no valid table with the given signature.
+// Tables are addressed physically and rely on the identity map set up in init.
+const acpi_sdt_header* acpi_find_table (const char* signature);
+
+#endif
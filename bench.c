@@ -0,0 +1,123 @@
+#include "multiboot/multiboot.h"
+#include "vga/tinyvga.h"
+#include "log/log.h"
+#include "log/console.h"
+#include "serial/serial.h"
+#include "util/kprintf.h"
+#include "bench/bench.h"
+#include "x86/interrupts/IDT.h"
+#include "x86/interrupts/ISR.h"
+#include "x86/interrupts/IRQ.h"
+#include "x86/interrupts/IOAPIC.h"
+#include "x86/fpu.h"
+#include "time/clock.h"
+#include "time/timer.h"
+#include "smp/cpu.h"
+#include "smp/smp.h"
+#include "memory/bootmem.h"
+#include "util/mem.h"
+#include "sched/idle.h"
+#include "sched/thread.h"
+#include "sync/rcu.h"
+#include <stdint.h>
+#include <stddef.h>
+
+static tinyvga vga;
+static IDT idt;
+static ISR_table_t isrt;
+static vga_log_console console;
+static serial_log_console serial_console;
+
+
+
+void halt (void)
+{
+	__asm__ volatile (
+		"cli;"
+		"halt%=:"
+		"hlt;"
+		"jmp halt%="
+		:
+	);
+}
+
+// Exceptions are fatal and reported synchronously; anything else is logged
+static
+void halt_ISR (INT_index interrupt, uint64_t error)
+{
+	char message [40];
+	ksnprintf (message, sizeof (message), "Interrupt: v=%02X e=%04lX", interrupt, error);
+
+	bool fatal = interrupt <= INT_SIMD_exception;
+	if (fatal)
+		log_emergency ();
+	log_write (fatal ? LOG_ERROR : LOG_WARNING, message);
+	if (fatal)
+		halt ();
+}
+
+void kernel_main (multiboot_info_t* info,
+                  __attribute__ ((unused)) multiboot_uint32_t magic)
+{
+	vga = vga_initialize ();
+	vga_set_hardware_scroll (&vga, true);
+	vga_clear (&vga);
+	console = make_vga_log_console (&vga, LOG_INFO);
+	log_register_console (&console.console);
+
+	mem_initialize ();
+	bootmem_initialize (info);
+	ISR_table_initialize (&isrt, &halt_ISR);
+	IDT_initialize (&idt);
+	IRQ_disable (IRQ_PIT);
+	fpu_initialize ();
+	clock_initialize ();
+	cpu_initialize ();
+	timers_initialize ();
+	idle_initialize ();
+	threads_initialize ();
+	smp_initialize ();
+	IOAPIC_initialize ();
+	serial_port* com1 = serial_initialize (SERIAL_COM1, SERIAL_BAUD_MAX);
+	if (com1 != NULL) {
+		serial_console = make_serial_log_console (com1, LOG_INFO);
+		log_register_console (&serial_console.console);
+	}
+	rcu_initialize ();
+
+	bench_initialize (&vga, com1);
+	bench_timers ();
+	bench_locks ();
+	bench_threads ();
+	bench_calls ();
+	bench_rings ();
+	bench_rcu ();
+	bench_mutex ();
+	bench_log ();
+	bench_format ();
+	bench_framebuffer ();
+	bench_memory ();
+	bench_irq_balance ();
+	bench_kernel_fpu ();
+	bench_section ("Done.");
+
+	idle_loop ();
+}
+
+#define FLAGS (MULTIBOOT_PAGE_ALIGN | MULTIBOOT_MEMORY_INFO)
+
+__attribute__ ((aligned (MULTIBOOT_HEADER_ALIGN)))
+const struct multiboot_header kernel_header = {
+	.magic         = MULTIBOOT_HEADER_MAGIC,
+	.flags         = FLAGS,
+	.checksum      = -(MULTIBOOT_HEADER_MAGIC + FLAGS),
+	.header_addr   = 0,
+	.load_addr     = 0,
+	.load_end_addr = 0,
+	.bss_end_addr  = 0,
+	.entry_addr    = 0,
+	.mode_type     = 0,
+	.width         = 0,
+	.height        = 0,
+	.depth         = 0,
+};
@@ -0,0 +1,120 @@
+#include "bench.h"
+#include "smp/cpu.h"
+#include "smp/smp.h"
+#include "smp/call.h"
+#include "time/clock.h"
+#include "x86/control.h"
+#include "util/kprintf.h"
+#include "util/sinks.h"
+
+typedef struct parallel_run {
+	bench_worker function;
+	void*        arg;
+	uint32_t     next_worker;
+	uint32_t     ready;
+	uint32_t     go;
+	uint32_t     done;
+} parallel_run;
+
+static vga_sink     screen;
+static serial_sink  serial;
+static tee_sink     console;
+static uint64_t     random_state;
+static parallel_run parallel;
+
+static
+void run_worker (__attribute__ ((unused)) void* arg)
+{
+	uint32_t worker = __atomic_add_fetch (&parallel.next_worker, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch (&parallel.ready, 1, __ATOMIC_RELEASE);
+	while (!__atomic_load_n (&parallel.go, __ATOMIC_ACQUIRE))
+		cpu_relax ();
+	parallel.function (worker, parallel.arg);
+	__atomic_add_fetch (&parallel.done, 1, __ATOMIC_RELEASE);
+}
+
+static
+void wait_count (const uint32_t* count, uint32_t expected)
+{
+	while (__atomic_load_n (count, __ATOMIC_ACQUIRE) < expected)
+		cpu_relax ();
+}
+
+
+// Extern functions
+
+void bench_initialize (tinyvga* vga, serial_port* port)
+{
+	screen = make_vga_sink (vga);
+	serial = make_serial_sink (port);
+	console = make_tee_sink (&screen.sink, port != NULL ? &serial.sink : NULL);
+	random_state = 0x9E3779B97F4A7C15;
+}
+
+void bench_section (const char* title)
+{
+	kprintf (&console.sink, "%s\n", title);
+}
+
+void bench_report (const char* name, uint64_t operations, uint64_t elapsed_ns)
+{
+	uint64_t per_op = operations ? elapsed_ns / operations : 0;
+	kprintf (&console.sink, "  %-32s%'-8lu ns/op  (%'lu ops)\n", name, per_op, operations);
+}
+
+uint64_t bench_random (void)
+{
+	random_state ^= random_state << 13;
+	random_state ^= random_state >> 7;
+	random_state ^= random_state << 17;
+	return random_state;
+}
+
+void bench_value (const char* name, uint64_t value, const char* unit)
+{
+	kprintf (&console.sink, "  %-32s%'-8lu %s\n", name, value, unit);
+}
+
+void bench_columns (const char* name, const uint64_t* values, uint32_t count, const char* unit)
+{
+	kprintf (&console.sink, "  %-24s", name);
+	for (uint32_t i = 0; i < count; ++i)
+		kprintf (&console.sink, "%'8lu ", values [i]);
+	kprintf (&console.sink, "%s\n", unit);
+}
+
+const char* bench_name (char* buffer, const char* prefix, uint64_t n, const char* suffix)
+{
+	ksnprintf (buffer, BENCH_NAME_MAX, "%s%lu%s", prefix, n, suffix);
+	return buffer;
+}
+
+uint64_t bench_parallel (uint32_t workers, bench_worker fn, void* arg)
+{
+	uint64_t flags = save_flags_cli ();
+	parallel.function = fn;
+	parallel.arg         = arg;
+	parallel.next_worker = 0;
+	parallel.ready       = 0;
+	parallel.go          = 0;
+	parallel.done        = 0;
+
+	cpu_mask mask = 0;
+	uint32_t started = 1;
+	for (uint32_t cpu = 0; cpu < cpu_count () && started < workers; ++cpu)
+		if (cpu != cpu_index () && smp_cpu_online (cpu)) {
+			mask |= (cpu_mask) 1 << cpu;
+			++started;
+		}
+	smp_call_function (mask, &run_worker, NULL, false);
+	wait_count (&parallel.ready, started - 1);
+
+	uint64_t start = clock_now_ns ();
+	__atomic_store_n (&parallel.go, 1, __ATOMIC_RELEASE);
+	fn (0, arg);
+	wait_count (&parallel.done, started - 1);
+	uint64_t elapsed = clock_now_ns () - start;
+
+	restore_flags (flags);
+	return elapsed;
+}
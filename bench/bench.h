@@ -0,0 +1,50 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "serial/serial.h"
+#include "vga/tinyvga.h"
+#include <stdint.h>
+
+// Benchmarks print one line per measurement to the screen, and to the serial
+// port too unless it is NULL.
+void bench_initialize (tinyvga* vga, serial_port* port);
+void bench_section (const char* title);
+void bench_report (const char* name, uint64_t operations, uint64_t elapsed_ns);
+void bench_value (const char* name, uint64_t value, const char* unit);
+
+// One line of count values in columns, for results that form a table
+void bench_columns (const char* name, const uint64_t* values, uint32_t count, const char* unit);
+
+enum {
+	BENCH_NAME_MAX = 32
+};
+
+// Builds "<prefix><n><suffix>" in buffer, for names that vary with a count.
+// The buffer holds BENCH_NAME_MAX bytes; longer names are cut.
+const char* bench_name (char* buffer, const char* prefix, uint64_t n, const char* suffix);
+
+// Runs fn on the calling CPU and on workers - 1 other online CPUs, released
+// together once all are ready. Other CPUs run it in interrupt context.
+// Returns the time from the release until the last worker finished. workers
+// is clamped to the number of online CPUs.
+typedef void (*bench_worker) (uint32_t worker, void* arg);
+uint64_t bench_parallel (uint32_t workers, bench_worker fn, void* arg);
+
+// Deterministic xorshift64 sequence, so runs are comparable
+uint64_t bench_random (void);
+
+void bench_timers (void);
+void bench_locks (void);
+void bench_threads (void);
+void bench_calls (void);
+void bench_rings (void);
+void bench_rcu (void);
+void bench_mutex (void);
+void bench_log (void);
+void bench_format (void);
+void bench_framebuffer (void);
+void bench_memory (void);
+void bench_irq_balance (void);
+void bench_kernel_fpu (void);
+
+#endif
@@ -0,0 +1,55 @@
+#include "bench.h"
+#include "smp/call.h"
+#include "smp/cpu.h"
+#include "smp/smp.h"
+#include "time/clock.h"
+#include "x86/control.h"
+
+enum {
+	BENCH_CALLS = 100000
+};
+
+static uint64_t calls_run;
+
+static
+void count_call (__attribute__ ((unused)) void* arg)
+{
+	__atomic_add_fetch (&calls_run, 1, __ATOMIC_RELAXED);
+}
+
+static
+void report_stats (const smp_call_stats* before)
+{
+	smp_call_stats after = smp_call_statistics ();
+	bench_value ("  IPIs sent", after.ipis - before->ipis, "");
+	bench_value ("  calls coalesced", after.coalesced - before->coalesced, "");
+}
+
+
+// Extern functions
+
+void bench_calls (void)
+{
+	if (smp_online_count () < 2)
+		return;
+	bench_section ("Cross-CPU calls, CPU 0 to CPU 1:");
+	cpu_mask target = (cpu_mask) 1 << 1;
+
+	smp_call_stats before = smp_call_statistics ();
+	uint64_t start = clock_now_ns ();
+	for (uint32_t i = 0; i < BENCH_CALLS; ++i)
+		smp_call_function (target, &count_call, NULL, true);
+	bench_report ("call and wait", BENCH_CALLS, clock_now_ns () - start);
+	report_stats (&before);
+
+	// Calls queued while the target is still taking the IPI share it
+	before = smp_call_statistics ();
+	calls_run = 0;
+	start = clock_now_ns ();
+	for (uint32_t i = 0; i < BENCH_CALLS; ++i)
+		smp_call_function (target, &count_call, NULL, false);
+	while (__atomic_load_n (&calls_run, __ATOMIC_RELAXED) < BENCH_CALLS)
+		cpu_relax ();
+	bench_report ("asynchronous", BENCH_CALLS, clock_now_ns () - start);
+	report_stats (&before);
+}
@@ -0,0 +1,142 @@
+#include "bench.h"
+#include "time/clock.h"
+#include "util/format.h"
+#include "util/kprintf.h"
+#include <stddef.h>
+
+enum {
+	BENCH_VALUES = 1024,
+	BENCH_ROUNDS = 200
+};
+
+typedef void (*format_fn) (char* buffer, uint64_t value);
+
+static uint64_t values [BENCH_VALUES];
+static char     last_digit; // Keeps the results alive
+
+// format_uint and numsep as they were before the table-driven paths, for
+// comparison: a division by the runtime base per digit, a reversal, and a
+// second pass for separators
+
+static
+char* reference_format_uint (char* buffer, uint64_t value, uint_fast8_t mincol, uint_fast8_t base)
+{
+	char* cursor = buffer;
+	do {
+		uint64_t digit = value % base;
+		*cursor++ = (digit < 10) ? digit + '0' : (digit - 10) + 'A';
+		value /= base;
+	}
+	while (value != 0);
+	while (cursor < buffer + mincol)
+		*cursor++ = '0';
+	*cursor = '\0';
+	for (char* begin = buffer, * end = cursor - 1; begin < end; ++begin, --end) {
+		char tmp = *begin;
+		*begin = *end;
+		*end = tmp;
+	}
+	return buffer;
+}
+
+static
+char* reference_numsep (char* bufstr, char sep)
+{
+	size_t n = 0;
+	while (bufstr [n] != '\0')
+		++n;
+	size_t m = n + (n - 1)/3;
+	char* src = bufstr + n - 1;
+	char* dst = bufstr + m - 1;
+	for (int i = 0; src != dst;) {
+		if (i == 3) {
+			i = 0;
+			*dst = sep;
+		}
+		else {
+			i = i + 1;
+			*dst = *src;
+			--src;
+		}
+		--dst;
+	}
+	bufstr [m] = '\0';
+	return bufstr;
+}
+
+static
+void old_decimal (char* b, uint64_t v)
+{
+	reference_format_uint (b, v, 0, 10);
+}
+
+static
+void new_decimal (char* b, uint64_t v)
+{
+	format_uint (b, v, 0, 10);
+}
+
+static
+void old_hex (char* b, uint64_t v)
+{
+	reference_format_uint (b, v, 16, 16);
+}
+
+static
+void new_hex (char* b, uint64_t v)
+{
+	format_uint (b, v, 16, 16);
+}
+
+static
+void old_grouped (char* b, uint64_t v)
+{
+	reference_numsep (reference_format_uint (b, v, 0, 10), ',');
+}
+
+static
+void new_grouped (char* b, uint64_t v)
+{
+	b [format_decimal (b, v, ',')] = '\0';
+}
+
+static
+void kprintf_grouped (char* b, uint64_t v)
+{
+	ksnprintf (b, 32, "%'lu", v);
+}
+
+static
+void run (const char* name, format_fn fn)
+{
+	char buffer [32];
+	uint64_t start = clock_now_ns ();
+	for (uint32_t round = 0; round < BENCH_ROUNDS; ++round)
+		for (uint32_t i = 0; i < BENCH_VALUES; ++i) {
+			fn (buffer, values [i]);
+			last_digit ^= buffer [0];
+		}
+	bench_report (name, BENCH_ROUNDS * BENCH_VALUES, clock_now_ns () - start);
+}
+
+
+// Extern functions
+
+// Magnitudes are spread evenly over 1 to 64 bits, like counters and
+// addresses in a statistics page
+void bench_format (void)
+{
+	for (uint32_t i = 0; i < BENCH_VALUES; ++i) {
+		uint64_t r = bench_random ();
+		values [i] = r >> (r & 63);
+	}
+
+	bench_section ("Integer formatting, ns per number:");
+	run ("decimal, old", &old_decimal);
+	run ("decimal, table", &new_decimal);
+	run ("hex, 16 columns, old", &old_hex);
+	run ("hex, 16 columns, shifts", &new_hex);
+	run ("grouped, old (numsep)", &old_grouped);
+	run ("grouped, one pass", &new_grouped);
+	run ("grouped, ksnprintf", &kprintf_grouped);
+}
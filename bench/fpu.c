@@ -0,0 +1,84 @@
+#include "bench.h"
+#include "time/clock.h"
+#include "x86/fpu.h"
+#include <stdbool.h>
+
+/* kernel_fpu_begin/end around a region that clobbers the x87 control word
+ * and MXCSR, under each switching strategy. The running context's values
+ * must come back afterwards, from its own save area.
+ */
+
+enum {
+	BENCH_REGIONS = 100000,
+
+	// Round to nearest with 53-bit precision; flush to zero with every
+	// exception masked
+	OWNER_FCW   = 0x027F,
+	OWNER_MXCSR = 0x9F80,
+
+	REGION_FCW  = 0x0C7F, // Truncate
+
+	FCW_DEFAULT   = 0x037F,
+	MXCSR_DEFAULT = 0x1F80
+};
+
+static inline
+void load_fpu_controls (uint16_t fcw, uint32_t mxcsr)
+{
+	__asm__ volatile ("fldcw %0; ldmxcsr %1" :: "m" (fcw), "m" (mxcsr));
+}
+
+static inline
+uint16_t store_fcw (void)
+{
+	uint16_t fcw;
+	__asm__ volatile ("fnstcw %0" : "=m" (fcw));
+	return fcw;
+}
+
+static inline
+uint32_t store_mxcsr (void)
+{
+	uint32_t mxcsr;
+	__asm__ volatile ("stmxcsr %0" : "=m" (mxcsr));
+	return mxcsr;
+}
+
+// Returns true if the owner's state survived every region
+static
+bool run_regions (const char* name)
+{
+	// Taking ownership first, so the regions have state to save
+	load_fpu_controls (OWNER_FCW, OWNER_MXCSR);
+
+	uint16_t region_fcw = REGION_FCW;
+	uint64_t start = clock_now_ns ();
+	for (uint32_t i = 0; i < BENCH_REGIONS; ++i) {
+		kernel_fpu_begin ();
+		__asm__ volatile ("fldcw %0" :: "m" (region_fcw));
+		kernel_fpu_end ();
+	}
+	bench_report (name, BENCH_REGIONS, clock_now_ns () - start);
+
+	bool kept = store_fcw () == OWNER_FCW && store_mxcsr () == OWNER_MXCSR;
+	load_fpu_controls (FCW_DEFAULT, MXCSR_DEFAULT);
+	return kept;
+}
+
+
+// Extern functions
+
+void bench_kernel_fpu (void)
+{
+	bench_section ("Kernel FPU regions, 100,000 begin/end pairs:");
+	fpu_strategy chosen = fpu_get_strategy ();
+
+	fpu_set_strategy (FPU_LAZY);
+	bool lazy_kept = run_regions ("lazy");
+	fpu_set_strategy (FPU_EAGER);
+	bool eager_kept = run_regions ("eager");
+	fpu_set_strategy (chosen);
+
+	bench_value ("owner state kept, lazy", lazy_kept, "");
+	bench_value ("owner state kept, eager", eager_kept, "");
+}
@@ -0,0 +1,168 @@
+#include "bench.h"
+#include "fb/double_buffer.h"
+#include "fb/framebuffer.h"
+#include "memory/bootmem.h"
+#include "time/clock.h"
+#include <stddef.h>
+
+enum {
+	SURFACE_WIDTH  = 1280,
+	SURFACE_HEIGHT = 1024,
+	TILE_SIZE      = 64,
+	CELL_WIDTH     = 8,  // A text console's changes, one character each
+	CELL_HEIGHT    = 16,
+	CELLS          = 40,
+	BENCH_FRAMES   = 10
+};
+
+// The 32-bit mode vbetest asks for
+static const fb_format format_32 = {
+	.bytes_per_pixel = 4,
+	.red_shift = 16, .green_shift = 8, .blue_shift = 0,
+	.red_loss = 0, .green_loss = 0, .blue_loss = 0
+};
+
+static const fb_format format_24 = {
+	.bytes_per_pixel = 3,
+	.red_shift = 16, .green_shift = 8, .blue_shift = 0,
+	.red_loss = 0, .green_loss = 0, .blue_loss = 0
+};
+
+static const fb_format format_16 = {
+	.bytes_per_pixel = 2,
+	.red_shift = 11, .green_shift = 5, .blue_shift = 0,
+	.red_loss = 3, .green_loss = 2, .blue_loss = 3
+};
+
+// The per-pixel plot vbetest used before, decoding the mode every time
+static
+void reference_plot (const ModeInfoBlock* mode_info, uint8_t* base,
+                     uint32_t x, uint32_t y, uint32_t R, uint32_t G, uint32_t B)
+{
+	uint16_t pitch  = mode_info->BytesPerScanLine;
+	uint16_t width  = (mode_info->BitsPerPixel + 8 - 1) / 8;
+	uint32_t offset = y * pitch + x * width;
+
+	const uint32_t cdata =
+		(R & ((1 << mode_info->RedMaskSize)   - 1)) << mode_info->RedFieldPosition   |
+		(G & ((1 << mode_info->GreenMaskSize) - 1)) << mode_info->GreenFieldPosition |
+		(B & ((1 << mode_info->BlueMaskSize)  - 1)) << mode_info->BlueFieldPosition;
+	const uint8_t* cdata_raw = (const uint8_t*) &cdata;
+
+	for (uint8_t i = 0; i < width; ++i)
+		base [offset + i] = cdata_raw [i];
+}
+
+static
+void bench_reference (uint8_t* surface)
+{
+	static ModeInfoBlock mode;
+	mode.BytesPerScanLine = SURFACE_WIDTH * 4;
+	mode.BitsPerPixel     = 32;
+	mode.RedMaskSize   = 8;
+	mode.GreenMaskSize = 8;
+	mode.BlueMaskSize  = 8;
+	mode.RedFieldPosition   = 16;
+	mode.GreenFieldPosition = 8;
+	mode.BlueFieldPosition  = 0;
+
+	uint64_t start = clock_now_ns ();
+	for (uint32_t frame = 0; frame < BENCH_FRAMES; ++frame)
+		for (uint32_t y = 0; y < SURFACE_HEIGHT; ++y)
+			for (uint32_t x = 0; x < SURFACE_WIDTH; ++x)
+				reference_plot (&mode, surface, x, y,
+				                x * 256 / SURFACE_WIDTH, y * 256 / SURFACE_HEIGHT, 255);
+	bench_value ("gradient, per-pixel plot", (clock_now_ns () - start) / BENCH_FRAMES / 1000, "us");
+}
+
+static
+void bench_mode (uint8_t* surface, fb_format format)
+{
+	char name [BENCH_NAME_MAX];
+	framebuffer fb = make_framebuffer (surface, SURFACE_WIDTH, SURFACE_HEIGHT,
+	                                   SURFACE_WIDTH * format.bytes_per_pixel, format);
+
+	uint64_t start = clock_now_ns ();
+	for (uint32_t frame = 0; frame < BENCH_FRAMES; ++frame)
+		fb_gradient (&fb, 0, 0, fb.width, fb.height,
+		             make_fb_rgb (0, 0, 255), make_fb_rgb (255, 0, 255), make_fb_rgb (0, 255, 255));
+	bench_value (bench_name (name, "gradient, ", format.bytes_per_pixel * 8, " bpp"),
+	             (clock_now_ns () - start) / BENCH_FRAMES / 1000, "us");
+
+	fb_pixel pixel = fb_pixel_rgb (&format, make_fb_rgb (32, 64, 128));
+	start = clock_now_ns ();
+	for (uint32_t frame = 0; frame < BENCH_FRAMES; ++frame)
+		fb_fill_rect (&fb, 0, 0, fb.width, fb.height, pixel);
+	bench_value (bench_name (name, "fill_rect, ", format.bytes_per_pixel * 8, " bpp"),
+	             (clock_now_ns () - start) / BENCH_FRAMES / 1000, "us");
+
+	// Tiles the screen from its own top-left corner
+	start = clock_now_ns ();
+	for (uint32_t frame = 0; frame < BENCH_FRAMES; ++frame)
+		for (uint32_t y = 0; y < fb.height; y += TILE_SIZE)
+			for (uint32_t x = TILE_SIZE; x < fb.width; x += TILE_SIZE)
+				fb_blit (&fb, x, y, TILE_SIZE, TILE_SIZE, fb.base, fb.pitch);
+	bench_value (bench_name (name, "blit 64x64 tiles, ", format.bytes_per_pixel * 8, " bpp"),
+	             (clock_now_ns () - start) / BENCH_FRAMES / 1000, "us");
+}
+
+// The front buffer is RAM as well, so this shows the cost of the copy without
+// the cost of the bus, which only makes the dirty rectangles count for more
+static
+void bench_present (uint8_t* surface)
+{
+	static framebuffer front;
+	static fb_double_buffer db;
+	front = make_framebuffer (surface, SURFACE_WIDTH, SURFACE_HEIGHT, SURFACE_WIDTH * 4, format_32);
+	if (!fb_double_buffer_initialize (&db, &front))
+		return;
+	fb_gradient (&db.back, 0, 0, db.back.width, db.back.height,
+	             make_fb_rgb (0, 0, 255), make_fb_rgb (255, 0, 255), make_fb_rgb (0, 255, 255));
+
+	uint64_t start = clock_now_ns ();
+	for (uint32_t frame = 0; frame < BENCH_FRAMES; ++frame)
+		fb_blit (&front, 0, 0, front.width, front.height, db.back.base, db.back.pitch);
+	bench_value ("full frame, ordinary stores", (clock_now_ns () - start) / BENCH_FRAMES / 1000, "us");
+
+	start = clock_now_ns ();
+	for (uint32_t frame = 0; frame < BENCH_FRAMES; ++frame) {
+		fb_damage_all (&db);
+		fb_present (&db);
+	}
+	bench_value ("full frame, non-temporal", (clock_now_ns () - start) / BENCH_FRAMES / 1000, "us");
+
+	fb_pixel pixel = fb_pixel_rgb (&db.back.format, make_fb_rgb (255, 255, 255));
+	uint64_t bytes = 0;
+	start = clock_now_ns ();
+	for (uint32_t frame = 0; frame < BENCH_FRAMES; ++frame) {
+		for (uint32_t i = 0; i < CELLS; ++i) {
+			uint32_t x = bench_random () % (SURFACE_WIDTH / CELL_WIDTH) * CELL_WIDTH;
+			uint32_t y = bench_random () % (SURFACE_HEIGHT / CELL_HEIGHT) * CELL_HEIGHT;
+			fb_fill_rect (&db.back, x, y, CELL_WIDTH, CELL_HEIGHT, pixel);
+			fb_damage (&db, make_fb_rect (x, y, CELL_WIDTH, CELL_HEIGHT));
+		}
+		bytes += fb_present (&db);
+	}
+	bench_value ("40 scattered cells, drawn", (clock_now_ns () - start) / BENCH_FRAMES / 1000, "us");
+	bench_value ("  copied per frame", bytes / BENCH_FRAMES / 1024, "KiB");
+}
+
+
+// Extern functions
+
+// Draws into RAM rather than video memory, which measures the primitives
+// rather than the bus
+void bench_framebuffer (void)
+{
+	uint8_t* surface = bootmem_alloc (SURFACE_WIDTH * SURFACE_HEIGHT * 4, 4096);
+	if (surface == NULL)
+		return;
+	bench_section ("Framebuffer, 1280x1024 in RAM, per frame:");
+	bench_reference (surface);
+	bench_mode (surface, format_32);
+	bench_mode (surface, format_24);
+	bench_mode (surface, format_16);
+
+	bench_section ("Present, 1280x1024x32 in RAM, per frame:");
+	bench_present (surface);
+}
@@ -0,0 +1,171 @@
+#include "bench.h"
+#include "time/8254.h"
+#include "time/clock.h"
+#include "sched/thread.h"
+#include "smp/cpu.h"
+#include "smp/smp.h"
+#include "x86/control.h"
+#include "x86/portio.h"
+#include "x86/interrupts/IOAPIC.h"
+#include "x86/interrupts/IRQ.h"
+#include "x86/interrupts/IRQ_balance.h"
+#include "x86/interrupts/ISR.h"
+#include "util/kprintf.h"
+#include <stddef.h>
+
+/* Two IRQs at different rates, both starting on CPU 0: the PIT at 2 kHz and
+ * the RTC periodic interrupt at 1024 Hz. The balancer should move the PIT
+ * away once and then leave both alone. Each handler checks that it runs on
+ * the CPU its move hook last announced, as deferred work following the
+ * interrupts would assume.
+ */
+
+enum {
+	PIT_RATE = 2000,
+
+	// CMOS index and data ports; bit 7 of the index masks NMIs
+	CMOS_INDEX = 0x70,
+	CMOS_DATA  = 0x71,
+	CMOS_NMI_DISABLE = 0x80,
+
+	RTC_REGISTER_A = 0x0A,
+	RTC_REGISTER_B = 0x0B,
+	RTC_REGISTER_C = 0x0C,
+	RTC_RATE_1024HZ = 0x06, // Register A, low nibble
+	RTC_RATE_MASK   = 0x0F,
+	RTC_PERIODIC    = 0x40, // Register B, PIE
+
+	BALANCE_INTERVAL_NS = 100000000, // 100 ms
+	BALANCE_RUN_NS      = 1000000000
+};
+
+typedef struct irq_check {
+	uint32_t announced; // Set by the move hook
+	uint64_t matched;
+	uint64_t strayed;
+} irq_check;
+
+static irq_check pit_check;
+static irq_check rtc_check;
+
+static
+uint8_t cmos_read (uint8_t index)
+{
+	outb (CMOS_INDEX, CMOS_NMI_DISABLE | index);
+	return inb (CMOS_DATA);
+}
+
+static
+void cmos_write (uint8_t index, uint8_t value)
+{
+	outb (CMOS_INDEX, CMOS_NMI_DISABLE | index);
+	outb (CMOS_DATA, value);
+}
+
+static
+void record (irq_check* check)
+{
+	if (cpu_index () == __atomic_load_n (&check->announced, __ATOMIC_RELAXED))
+		__atomic_add_fetch (&check->matched, 1, __ATOMIC_RELAXED);
+	else
+		__atomic_add_fetch (&check->strayed, 1, __ATOMIC_RELAXED);
+}
+
+static
+void pit_ISR (__attribute__ ((unused)) INT_index interrupt,
+              __attribute__ ((unused)) uint64_t error)
+{
+	record (&pit_check);
+}
+
+// Reading register C acknowledges the interrupt; the RTC raises no more
+// until it is read.
+static
+void rtc_ISR (__attribute__ ((unused)) INT_index interrupt,
+              __attribute__ ((unused)) uint64_t error)
+{
+	cmos_read (RTC_REGISTER_C);
+	record (&rtc_check);
+}
+
+// Runs with interrupts disabled, from the balancer's timer
+static
+void announce (__attribute__ ((unused)) IRQ irq, uint32_t cpu, void* arg)
+{
+	irq_check* check = arg;
+	__atomic_store_n (&check->announced, cpu, __ATOMIC_RELAXED);
+}
+
+static
+void watch (IRQ irq, INT_index interrupt, ISR_t isr, irq_check* check)
+{
+	check->announced = IOAPIC_target (irq);
+	check->matched   = 0;
+	check->strayed   = 0;
+	set_ISR (interrupt, isr);
+	IOAPIC_set_move_hook (irq, &announce, check);
+}
+
+static
+void unwatch (IRQ irq, INT_index interrupt)
+{
+	IRQ_disable (irq);
+	IOAPIC_set_move_hook (irq, NULL, NULL);
+	set_ISR (interrupt, &null_ISR);
+}
+
+static
+void report (const char* irq_name, IRQ irq, const irq_check* check)
+{
+	char name [BENCH_NAME_MAX];
+	ksnprintf (name, sizeof (name), "%s on CPU %u", irq_name, IOAPIC_target (irq));
+	bench_value (name, check->matched + check->strayed, "interrupts");
+	ksnprintf (name, sizeof (name), "%s off announced CPU", irq_name);
+	bench_value (name, check->strayed, "interrupts");
+}
+
+
+// Extern functions
+
+void bench_irq_balance (void)
+{
+	bench_section ("IRQ balancing, PIT at 2 kHz and RTC at 1024 Hz for 1 s:");
+	if (!IOAPIC_present () || smp_online_count () < 2) {
+		bench_section ("  skipped, needs an I/O APIC and two CPUs");
+		return;
+	}
+
+	watch (IRQ_PIT, INT_PIT, &pit_ISR, &pit_check);
+	watch (IRQ_CMOS_RTC, INT_CMOS_RTC, &rtc_ISR, &rtc_check);
+
+	uint64_t flags = save_flags_cli ();
+	pit_channel0_periodic (PIT_FREQUENCY / PIT_RATE);
+	cmos_write (RTC_REGISTER_A, (cmos_read (RTC_REGISTER_A) & ~RTC_RATE_MASK) | RTC_RATE_1024HZ);
+	cmos_write (RTC_REGISTER_B, cmos_read (RTC_REGISTER_B) | RTC_PERIODIC);
+	cmos_read (RTC_REGISTER_C);
+	restore_flags (flags);
+	IRQ_enable (IRQ_PIT);
+	IRQ_enable (IRQ_CMOS_RTC);
+
+	IRQ_balance_stats before = IRQ_balance_statistics ();
+	IRQ_balance_start (BALANCE_INTERVAL_NS);
+	uint64_t end = clock_now_ns () + BALANCE_RUN_NS;
+	while (clock_now_ns () < end) {
+		thread_yield ();
+		cpu_relax ();
+	}
+	IRQ_balance_stop ();
+	IRQ_balance_stats after = IRQ_balance_statistics ();
+
+	flags = save_flags_cli ();
+	cmos_write (RTC_REGISTER_B, cmos_read (RTC_REGISTER_B) & ~RTC_PERIODIC);
+	cmos_read (RTC_REGISTER_C);
+	restore_flags (flags);
+	unwatch (IRQ_PIT, INT_PIT);
+	unwatch (IRQ_CMOS_RTC, INT_CMOS_RTC);
+
+	bench_value ("passes", after.passes - before.passes, "");
+	bench_value ("moves", after.moves - before.moves, "");
+	report ("PIT", IRQ_PIT, &pit_check);
+	report ("RTC", IRQ_CMOS_RTC, &rtc_check);
+}
@@ -0,0 +1,85 @@
+#include "bench.h"
+#include "smp/smp.h"
+#include "sync/ticketlock.h"
+#include "sync/qspinlock.h"
+
+enum {
+	BENCH_ACQUISITIONS = 200000, // Per worker
+	CACHE_LINE = 64
+};
+
+// The critical section updates one shared line, as a counter or list head
+// under a lock would.
+typedef struct __attribute__ ((aligned (CACHE_LINE))) protected_data {
+	uint64_t counter;
+} protected_data;
+
+static __attribute__ ((aligned (CACHE_LINE))) ticketlock ticket;
+static __attribute__ ((aligned (CACHE_LINE))) qspinlock  queued;
+static protected_data data;
+
+static
+void ticket_worker (__attribute__ ((unused)) uint32_t worker,
+                    __attribute__ ((unused)) void* arg)
+{
+	for (uint32_t i = 0; i < BENCH_ACQUISITIONS; ++i) {
+		ticketlock_acquire (&ticket);
+		data.counter = data.counter + 1;
+		ticketlock_release (&ticket);
+	}
+}
+
+static
+void queued_worker (__attribute__ ((unused)) uint32_t worker,
+                    __attribute__ ((unused)) void* arg)
+{
+	for (uint32_t i = 0; i < BENCH_ACQUISITIONS; ++i) {
+		qspinlock_acquire (&queued);
+		data.counter = data.counter + 1;
+		qspinlock_release (&queued);
+	}
+}
+
+#ifdef LOCK_STATS
+static
+void report_stats (const lock_stats* stats)
+{
+	bench_value ("  contended", stats->contended, "acquisitions");
+	bench_value ("  max wait", stats->max_wait_cycles, "cycles");
+	bench_value ("  mean wait", stats->contended ? stats->total_wait_cycles / stats->contended : 0,
+	             "cycles");
+}
+#endif
+
+static
+void run (const char* kind, uint32_t workers, bench_worker worker)
+{
+	char name [BENCH_NAME_MAX];
+	ticket = make_ticketlock ();
+	queued = make_qspinlock ();
+	data.counter = 0;
+
+	uint64_t elapsed = bench_parallel (workers, worker, NULL);
+	bench_report (bench_name (name, kind, workers, (workers == 1) ? " CPU" : " CPUs"),
+	              data.counter, elapsed);
+#ifdef LOCK_STATS
+	report_stats ((worker == &ticket_worker) ? &ticket.stats : &queued.stats);
+#endif
+}
+
+
+// Extern functions
+
+void bench_locks (void)
+{
+	bench_section ("Spinlocks, shared counter, ns per acquisition overall:");
+	uint32_t cpus = smp_online_count ();
+	for (uint32_t workers = 1; ; workers *= 2) {
+		if (workers > cpus)
+			workers = cpus;
+		run ("ticket, ", workers, &ticket_worker);
+		run ("queued, ", workers, &queued_worker);
+		if (workers == cpus)
+			break;
+	}
+}
@@ -0,0 +1,36 @@
+#include "bench.h"
+#include "log/log.h"
+#include "time/clock.h"
+
+enum {
+	BENCH_BURSTS = 10000,
+	BURST        = 32 // Fits in a CPU's ring
+};
+
+
+// Extern functions
+
+// Debug records are drained between bursts, but no console prints them
+void bench_log (void)
+{
+	bench_section ("Kernel log, ns per record:");
+	log_stats before = log_statistics ();
+	uint64_t elapsed = 0;
+	for (uint32_t i = 0; i < BENCH_BURSTS; ++i) {
+		uint64_t start = clock_now_ns ();
+		for (uint32_t j = 0; j < BURST; ++j)
+			log_write (LOG_DEBUG, "benchmark record of a typical length");
+		elapsed += clock_now_ns () - start;
+		log_drain ();
+	}
+	bench_report ("log_write", BENCH_BURSTS * BURST, elapsed);
+
+	uint64_t start = clock_now_ns ();
+	for (uint32_t i = 0; i < BENCH_BURSTS; ++i) {
+		for (uint32_t j = 0; j < BURST; ++j)
+			log_write (LOG_DEBUG, "benchmark record of a typical length");
+		log_drain ();
+	}
+	bench_report ("log_write and drain", BENCH_BURSTS * BURST, clock_now_ns () - start);
+	bench_value ("  dropped", log_statistics ().dropped - before.dropped, "records");
+}
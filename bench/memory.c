@@ -0,0 +1,124 @@
+#include "bench.h"
+#include "memory/bootmem.h"
+#include "time/clock.h"
+#include "util/kprintf.h"
+#include "util/mem.h"
+#include <stddef.h>
+
+enum {
+	BUFFER_SIZE   = 2 << 20,
+	BYTES_PER_RUN = 8 << 20, // Each size repeats until it has moved this much
+	SIZES         = 10,
+	COLUMNS       = MEM_STRATEGIES + 1, // Every strategy, then what memcpy chose
+	TITLE_MAX     = 96
+};
+
+static const size_t sizes [SIZES] = {
+	16, 64, 256, 1 << 10, 4 << 10, 16 << 10, 64 << 10, 256 << 10, 1 << 20, 2 << 20
+};
+
+static inline
+uint64_t megabytes_per_second (uint64_t bytes, uint64_t elapsed_ns)
+{
+	return elapsed_ns ? bytes * 1000 / elapsed_ns : 0;
+}
+
+static
+const char* size_name (char* buffer, size_t size)
+{
+	if (size >= 1 << 20)
+		return bench_name (buffer, "", size >> 20, " MiB");
+	if (size >= 1 << 10)
+		return bench_name (buffer, "", size >> 10, " KiB");
+	return bench_name (buffer, "", size, " B");
+}
+
+static
+uint64_t time_copy (int strategy, uint8_t* dst, const uint8_t* src, size_t size)
+{
+	size_t runs = BYTES_PER_RUN / size;
+	uint64_t start = clock_now_ns ();
+	for (size_t i = 0; i < runs; ++i)
+		if (strategy == MEM_STRATEGIES)
+			memcpy (dst, src, size);
+		else
+			mem_copy_with (strategy, dst, src, size);
+	return megabytes_per_second (runs * size, clock_now_ns () - start);
+}
+
+static
+uint64_t time_set (int strategy, uint8_t* dst, size_t size)
+{
+	size_t runs = BYTES_PER_RUN / size;
+	uint64_t start = clock_now_ns ();
+	for (size_t i = 0; i < runs; ++i)
+		if (strategy == MEM_STRATEGIES)
+			memset (dst, (int) i, size);
+		else
+			mem_set_with (strategy, dst, (int) i, size);
+	return megabytes_per_second (runs * size, clock_now_ns () - start);
+}
+
+static
+void header (const char* title, const char* chosen)
+{
+	char line [TITLE_MAX];
+	ksnprintf (line, sizeof (line), "%s by size, MB/s:", title);
+	bench_section (line);
+	ksnprintf (line, sizeof (line), "  %-24s%8s %8s %8s %8s %8s", "",
+	           "loop", "rep q", "rep b", "movnti", chosen);
+	bench_section (line);
+}
+
+
+// Extern functions
+
+void bench_memory (void)
+{
+	uint8_t* src = bootmem_alloc (BUFFER_SIZE, MEM_PAGE_SIZE);
+	uint8_t* dst = bootmem_alloc (BUFFER_SIZE, MEM_PAGE_SIZE);
+	if (src == NULL || dst == NULL)
+		return;
+	for (size_t i = 0; i < BUFFER_SIZE; ++i)
+		src [i] = (uint8_t) bench_random ();
+
+	char title [TITLE_MAX];
+	ksnprintf (title, sizeof (title), "Memory primitives use %s, and movnti from %zu KiB:",
+	           mem_strategy_name (mem_copy_strategy ()), mem_nontemporal_threshold () >> 10);
+	bench_section (title);
+
+	char name [BENCH_NAME_MAX];
+	uint64_t rates [COLUMNS];
+	header ("Copy", "memcpy");
+	for (size_t i = 0; i < SIZES; ++i) {
+		for (int strategy = 0; strategy < COLUMNS; ++strategy)
+			rates [strategy] = time_copy (strategy, dst, src, sizes [i]);
+		bench_columns (size_name (name, sizes [i]), rates, COLUMNS, "");
+	}
+
+	header ("Set", "memset");
+	for (size_t i = 0; i < SIZES; ++i) {
+		for (int strategy = 0; strategy < COLUMNS; ++strategy)
+			rates [strategy] = time_set (strategy, dst, sizes [i]);
+		bench_columns (size_name (name, sizes [i]), rates, COLUMNS, "");
+	}
+
+	uint64_t start = clock_now_ns ();
+	for (size_t i = 0; i < BUFFER_SIZE / MEM_PAGE_SIZE; ++i)
+		clear_page (dst + i * MEM_PAGE_SIZE);
+	bench_value ("clear_page, 2 MiB", (clock_now_ns () - start) / 1000, "us");
+
+	start = clock_now_ns ();
+	for (size_t i = 0; i < BUFFER_SIZE / MEM_PAGE_SIZE; ++i)
+		clear_page_nontemporal (dst + i * MEM_PAGE_SIZE);
+	bench_value ("clear_page_nontemporal, 2 MiB", (clock_now_ns () - start) / 1000, "us");
+
+	start = clock_now_ns ();
+	clear_pages (dst, BUFFER_SIZE / MEM_PAGE_SIZE);
+	bench_value ("clear_pages, 2 MiB", (clock_now_ns () - start) / 1000, "us");
+
+	start = clock_now_ns ();
+	for (size_t i = 0; i < BUFFER_SIZE / MEM_PAGE_SIZE; ++i)
+		copy_page (dst + i * MEM_PAGE_SIZE, src + i * MEM_PAGE_SIZE);
+	bench_value ("copy_page, 2 MiB", (clock_now_ns () - start) / 1000, "us");
+}
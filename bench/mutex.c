@@ -0,0 +1,113 @@
+#include "bench.h"
+#include "sched/thread.h"
+#include "smp/smp.h"
+#include "sync/mutex.h"
+#include "time/clock.h"
+#include "x86/control.h"
+
+enum {
+	BENCH_UNCONTENDED = 1000000,
+	BENCH_ACQUISITIONS = 20000, // Per thread
+	HOLD_NS           = 1000,
+
+	// Sections that block, as around I/O, with every thread on one CPU
+	BLOCKING_THREADS = 4,
+	BLOCKING_ROUNDS  = 200,     // Per thread
+	BLOCKING_HOLD_NS = 20000
+};
+
+static mutex    lock;
+static uint64_t acquisitions;
+static uint32_t finished;
+
+static
+void busy_wait (uint64_t duration_ns)
+{
+	uint64_t end = clock_now_ns () + duration_ns;
+	while (clock_now_ns () < end)
+		cpu_relax ();
+}
+
+static
+void running_worker (__attribute__ ((unused)) void* arg)
+{
+	for (uint32_t i = 0; i < BENCH_ACQUISITIONS; ++i) {
+		mutex_acquire (&lock);
+		++acquisitions;
+		busy_wait (HOLD_NS);
+		mutex_release (&lock);
+	}
+	__atomic_add_fetch (&finished, 1, __ATOMIC_RELEASE);
+}
+
+static
+void blocking_worker (__attribute__ ((unused)) void* arg)
+{
+	for (uint32_t i = 0; i < BLOCKING_ROUNDS; ++i) {
+		mutex_acquire (&lock);
+		++acquisitions;
+		thread_sleep (BLOCKING_HOLD_NS);
+		mutex_release (&lock);
+	}
+	__atomic_add_fetch (&finished, 1, __ATOMIC_RELEASE);
+}
+
+#ifdef LOCK_STATS
+static
+void report_stats (void)
+{
+	const mutex_stats* stats = &lock.stats;
+	bench_value ("  spun", stats->spun, "acquisitions");
+	bench_value ("  slept", stats->slept, "acquisitions");
+	bench_value ("  max sleep", stats->max_sleep_ns, "ns");
+	bench_value ("  mean sleep", stats->slept ? stats->total_sleep_ns / stats->slept : 0, "ns");
+}
+#endif
+
+// The caller is CPU 0's idle thread; it yields until every worker is done
+static
+void run (const char* name, uint32_t threads, thread_function worker, bool spread)
+{
+	mutex_initialize (&lock);
+	acquisitions = 0;
+	finished = 0;
+
+	uint64_t start = clock_now_ns ();
+	uint32_t created = 0;
+	for (uint32_t i = 0; i < threads; ++i)
+		created += thread_create_on (spread ? i : 0, worker, NULL) != NULL;
+	while (__atomic_load_n (&finished, __ATOMIC_ACQUIRE) < created) {
+		thread_yield ();
+		cpu_relax ();
+	}
+	bench_report (name, acquisitions, clock_now_ns () - start);
+#ifdef LOCK_STATS
+	report_stats ();
+#endif
+}
+
+
+// Extern functions
+
+void bench_mutex (void)
+{
+	char name [BENCH_NAME_MAX];
+	bench_section ("Mutexes, ns per acquisition overall:");
+
+	mutex_initialize (&lock);
+	uint64_t start = clock_now_ns ();
+	for (uint32_t i = 0; i < BENCH_UNCONTENDED; ++i) {
+		mutex_acquire (&lock);
+		mutex_release (&lock);
+	}
+	bench_report ("uncontended", BENCH_UNCONTENDED, clock_now_ns () - start);
+
+	// Owners are running elsewhere, so waiters spin rather than sleep
+	uint32_t cpus = smp_online_count ();
+	if (cpus > 1)
+		run (bench_name (name, "1 us sections, ", cpus, " CPUs"), cpus, &running_worker, true);
+
+	// Owners sleep, so waiters sleep too and are handed the mutex in turn
+	run (bench_name (name, "blocking, ", BLOCKING_THREADS, " threads"),
+	     BLOCKING_THREADS, &blocking_worker, false);
+}
@@ -0,0 +1,131 @@
+#include "bench.h"
+#include "sched/thread.h"
+#include "smp/smp.h"
+#include "sync/qspinlock.h"
+#include "sync/rcu.h"
+#include "time/clock.h"
+#include "x86/control.h"
+#include <stddef.h>
+
+enum {
+	BENCH_LOOKUPS = 500000, // Per worker
+	BENCH_UPDATES = 500,
+	TABLE_SIZE    = 16,
+	CACHE_LINE    = 64
+};
+
+// A small routing-style table, replaced as a whole on update
+typedef struct table {
+	rcu_head rcu;
+	uint64_t entries [TABLE_SIZE];
+} table;
+
+// Every update takes a fresh version, since an old one may still be queued
+// for reclamation
+static table    tables [2 * BENCH_UPDATES + 1];
+static uint32_t last_table;
+static table*   current;
+static __attribute__ ((aligned (CACHE_LINE))) qspinlock table_lock;
+static __attribute__ ((aligned (CACHE_LINE))) uint64_t  lookups_done;
+static uint64_t checksum; // Keeps the lookups from being optimized out
+static uint64_t reclaimed;
+
+static
+void rcu_reader (uint32_t worker, __attribute__ ((unused)) void* arg)
+{
+	uint64_t sum = 0;
+	for (uint32_t i = 0; i < BENCH_LOOKUPS; ++i) {
+		rcu_read_lock ();
+		const table* t = rcu_dereference (current);
+		sum += t->entries [(i + worker) % TABLE_SIZE];
+		rcu_read_unlock ();
+	}
+	__atomic_add_fetch (&lookups_done, BENCH_LOOKUPS, __ATOMIC_RELAXED);
+	__atomic_add_fetch (&checksum, sum, __ATOMIC_RELAXED);
+}
+
+static
+void locked_reader (uint32_t worker, __attribute__ ((unused)) void* arg)
+{
+	uint64_t sum = 0;
+	for (uint32_t i = 0; i < BENCH_LOOKUPS; ++i) {
+		qspinlock_acquire (&table_lock);
+		sum += current->entries [(i + worker) % TABLE_SIZE];
+		qspinlock_release (&table_lock);
+	}
+	__atomic_add_fetch (&lookups_done, BENCH_LOOKUPS, __ATOMIC_RELAXED);
+	__atomic_add_fetch (&checksum, sum, __ATOMIC_RELAXED);
+}
+
+static
+void run (const char* kind, uint32_t workers, bench_worker worker)
+{
+	char name [BENCH_NAME_MAX];
+	lookups_done = 0;
+	uint64_t elapsed = bench_parallel (workers, worker, NULL);
+	bench_report (bench_name (name, kind, workers, (workers == 1) ? " CPU" : " CPUs"),
+	              lookups_done, elapsed);
+}
+
+static
+void count_reclaimed (__attribute__ ((unused)) rcu_head* head)
+{
+	__atomic_add_fetch (&reclaimed, 1, __ATOMIC_RELAXED);
+}
+
+static
+table* update (void)
+{
+	table* old = current;
+	table* next = &tables [++last_table];
+	for (uint32_t i = 0; i < TABLE_SIZE; ++i)
+		next->entries [i] = old->entries [i] + 1;
+	rcu_assign_pointer (current, next);
+	return old;
+}
+
+
+// Extern functions
+
+void bench_rcu (void)
+{
+	for (uint32_t i = 0; i < TABLE_SIZE; ++i)
+		tables [0].entries [i] = i + 1;
+	current = &tables [0];
+	last_table = 0;
+	table_lock = make_qspinlock ();
+
+	bench_section ("Read-mostly table, ns per lookup overall:");
+	uint32_t cpus = smp_online_count ();
+	for (uint32_t workers = 1; ; workers *= 2) {
+		if (workers > cpus)
+			workers = cpus;
+		run ("RCU, ", workers, &rcu_reader);
+		run ("spinlocked, ", workers, &locked_reader);
+		if (workers == cpus)
+			break;
+	}
+
+	// The other CPUs are idle, so each grace period waits for them to wake
+	// up and report.
+	uint64_t start = clock_now_ns ();
+	for (uint32_t i = 0; i < BENCH_UPDATES; ++i) {
+		update ();
+		rcu_synchronize ();
+	}
+	bench_report ("update and synchronize", BENCH_UPDATES, clock_now_ns () - start);
+
+	// Callbacks run from a thread on this CPU, which gets to run once the
+	// caller yields
+	rcu_stats before = rcu_statistics ();
+	reclaimed = 0;
+	start = clock_now_ns ();
+	for (uint32_t i = 0; i < BENCH_UPDATES; ++i)
+		rcu_call (&update ()->rcu, &count_reclaimed);
+	while (__atomic_load_n (&reclaimed, __ATOMIC_RELAXED) < BENCH_UPDATES) {
+		thread_yield ();
+		cpu_relax ();
+	}
+	bench_report ("update and rcu_call", BENCH_UPDATES, clock_now_ns () - start);
+	bench_value ("  grace periods", rcu_statistics ().grace_periods - before.grace_periods, "");
+}
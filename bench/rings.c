@@ -0,0 +1,114 @@
+#include "bench.h"
+#include "smp/smp.h"
+#include "sync/ring.h"
+#include "x86/control.h"
+
+enum {
+	BENCH_ITEMS = 1000000, // Per producer
+	RING_SIZE   = 1024,
+	MAX_BATCH   = 32
+};
+
+typedef struct ring_run {
+	uint32_t batch;
+	uint32_t producers;
+	uint64_t received;
+} ring_run;
+
+static spsc_ring spsc;
+static mpsc_ring mpsc;
+static uint64_t  spsc_slots [RING_SIZE];
+static mpsc_slot mpsc_slots [RING_SIZE];
+
+static
+void spsc_worker (uint32_t worker, void* arg)
+{
+	ring_run* run = arg;
+	uint64_t values [MAX_BATCH];
+	if (worker == 0) {
+		while (run->received < BENCH_ITEMS) {
+			uint32_t n = spsc_ring_dequeue (&spsc, values, run->batch);
+			if (n == 0)
+				cpu_relax ();
+			run->received += n;
+		}
+		return;
+	}
+
+	for (uint64_t sent = 0; sent < BENCH_ITEMS;) {
+		uint32_t batch = (BENCH_ITEMS - sent < run->batch) ? BENCH_ITEMS - sent : run->batch;
+		for (uint32_t i = 0; i < batch; ++i)
+			values [i] = sent + i;
+		uint32_t n = spsc_ring_enqueue (&spsc, values, batch);
+		if (n == 0)
+			cpu_relax ();
+		sent += n;
+	}
+}
+
+static
+void mpsc_worker (uint32_t worker, void* arg)
+{
+	ring_run* run = arg;
+	uint64_t values [MAX_BATCH];
+	if (worker == 0) {
+		uint64_t expected = (uint64_t) run->producers * BENCH_ITEMS;
+		while (run->received < expected) {
+			uint32_t n = mpsc_ring_dequeue (&mpsc, values, run->batch);
+			if (n == 0)
+				cpu_relax ();
+			run->received += n;
+		}
+		return;
+	}
+
+	for (uint64_t sent = 0; sent < BENCH_ITEMS;) {
+		uint32_t batch = (BENCH_ITEMS - sent < run->batch) ? BENCH_ITEMS - sent : run->batch;
+		for (uint32_t i = 0; i < batch; ++i)
+			values [i] = sent + i;
+		uint32_t n = mpsc_ring_enqueue (&mpsc, values, batch);
+		if (n == 0)
+			cpu_relax ();
+		sent += n;
+	}
+}
+
+static
+void run_spsc (uint32_t batch)
+{
+	char name [BENCH_NAME_MAX];
+	ring_run run = {.batch = batch, .producers = 1, .received = 0};
+	spsc_ring_initialize (&spsc, spsc_slots, RING_SIZE);
+	uint64_t elapsed = bench_parallel (2, &spsc_worker, &run);
+	bench_report (bench_name (name, "SPSC, 2 CPUs, batch ", batch, ""), run.received, elapsed);
+}
+
+static
+void run_mpsc (uint32_t cpus, uint32_t batch)
+{
+	char name [BENCH_NAME_MAX];
+	ring_run run = {.batch = batch, .producers = cpus - 1, .received = 0};
+	mpsc_ring_initialize (&mpsc, mpsc_slots, RING_SIZE);
+	uint64_t elapsed = bench_parallel (cpus, &mpsc_worker, &run);
+	bench_report (bench_name (name, "MPSC, ", cpus, (batch == 1) ? " CPUs, batch 1" : " CPUs, batch 32"),
+	              run.received, elapsed);
+}
+
+
+// Extern functions
+
+void bench_rings (void)
+{
+	uint32_t cpus = smp_online_count ();
+	if (cpus < 2)
+		return;
+	bench_section ("Rings, CPU 0 consuming, ns per item:");
+	run_spsc (1);
+	run_spsc (MAX_BATCH);
+	run_mpsc (2, 1);
+	run_mpsc (2, MAX_BATCH);
+	if (cpus > 2) {
+		run_mpsc (cpus, 1);
+		run_mpsc (cpus, MAX_BATCH);
+	}
+}
@@ -0,0 +1,55 @@
+#include "bench.h"
+#include "sched/thread.h"
+#include "time/clock.h"
+
+enum {
+	BENCH_ROUNDS = 1000000
+};
+
+static thread*           players [2];
+static volatile uint32_t turn;
+
+static
+void yield_player (__attribute__ ((unused)) void* arg)
+{
+	for (uint32_t i = 0; i < BENCH_ROUNDS; ++i)
+		thread_yield ();
+}
+
+// Each side waits for its turn, hands the turn over and wakes the other
+static
+void wake_player (void* arg)
+{
+	uint32_t self = (uint32_t) (uintptr_t) arg;
+	for (uint32_t i = 0; i < BENCH_ROUNDS; ++i) {
+		while (turn != self)
+			thread_block ();
+		turn = !self;
+		thread_wake (players [!self]);
+	}
+}
+
+// The caller is the idle thread, which only runs again once both players
+// have exited.
+static
+uint64_t play (thread_function function)
+{
+	uint64_t start = clock_now_ns ();
+	players [0] = thread_create (function, (void*) 0);
+	players [1] = thread_create (function, (void*) 1);
+	if (players [0] == NULL || players [1] == NULL)
+		return 0;
+	thread_yield ();
+	return clock_now_ns () - start;
+}
+
+
+// Extern functions
+
+void bench_threads (void)
+{
+	bench_section ("Threads, two on one CPU, ns per switch:");
+	bench_report ("yield ping-pong", 2 * BENCH_ROUNDS, play (&yield_player));
+	turn = 0;
+	bench_report ("wake/block ping-pong", 2 * BENCH_ROUNDS, play (&wake_player));
+}
@@ -0,0 +1,70 @@
+#include "bench.h"
+#include "time/clock.h"
+#include "time/timer.h"
+#include "x86/control.h"
+
+enum {
+	BENCH_TIMERS = 100000,
+	BENCH_CHURN  = 1000000
+};
+
+static const uint64_t spread_ns = 10000000000; // 10 s
+static const uint64_t past_ns   = 100000000;   // 100 ms
+
+static timer timers [BENCH_TIMERS];
+static volatile uint64_t fired;
+
+static
+void count_expiry (__attribute__ ((unused)) void* arg)
+{
+	fired = fired + 1;
+}
+
+
+// Extern functions
+
+void bench_timers (void)
+{
+	bench_section ("Timer wheel, 100,000 timers:");
+	for (uint32_t i = 0; i < BENCH_TIMERS; ++i)
+		timers [i] = make_timer (&count_expiry, NULL);
+
+	// Nothing expires while interrupts are disabled, and every deadline is at
+	// least a second away in any case.
+	uint64_t base = clock_now_ns () + 1000000000;
+	uint64_t start = clock_now_ns ();
+	for (uint32_t i = 0; i < BENCH_TIMERS; ++i)
+		timer_arm (&timers [i], base + bench_random () % spread_ns);
+	bench_report ("arm", BENCH_TIMERS, clock_now_ns () - start);
+
+	start = clock_now_ns ();
+	for (uint32_t n = 0; n < BENCH_CHURN; ++n)
+		timer_arm (&timers [bench_random () % BENCH_TIMERS], base + bench_random () % spread_ns);
+	bench_report ("re-arm pending", BENCH_CHURN, clock_now_ns () - start);
+
+	start = clock_now_ns ();
+	for (uint32_t n = 0; n < BENCH_CHURN; ++n) {
+		timer* t = &timers [bench_random () % BENCH_TIMERS];
+		timer_cancel (t);
+		timer_arm (t, base + bench_random () % spread_ns);
+	}
+	bench_report ("cancel + arm", BENCH_CHURN, clock_now_ns () - start);
+
+	start = clock_now_ns ();
+	for (uint32_t i = 0; i < BENCH_TIMERS; ++i)
+		timer_cancel (&timers [i]);
+	bench_report ("cancel", BENCH_TIMERS, clock_now_ns () - start);
+
+	// Deadlines spread over the last 100 ms span several wheel levels, so
+	// expiry includes cascading.
+	uint64_t now = clock_now_ns ();
+	fired = 0;
+	for (uint32_t i = 0; i < BENCH_TIMERS; ++i)
+		timer_arm (&timers [i], now - bench_random () % past_ns);
+	start = clock_now_ns ();
+	__asm__ volatile ("sti");
+	while (fired < BENCH_TIMERS)
+		cpu_relax ();
+	__asm__ volatile ("cli");
+	bench_report ("expire", BENCH_TIMERS, clock_now_ns () - start);
+}
@@ -0,0 +1,165 @@
+#include "double_buffer.h"
+#include "memory/bootmem.h"
+#include <stddef.h>
+
+enum {
+	BACK_PITCH_ALIGN = 64,
+	BACK_ALIGN       = 4096,
+
+	// Rectangles are merged when the union covers at most this many more
+	// pixels than the two did, which also joins rectangles that touch
+	MERGE_SLACK = 1024
+};
+
+static inline
+uint32_t min_u32 (uint32_t a, uint32_t b)
+{
+	return a < b ? a : b;
+}
+
+static inline
+uint32_t max_u32 (uint32_t a, uint32_t b)
+{
+	return a > b ? a : b;
+}
+
+static inline
+uint64_t area (fb_rect rect)
+{
+	return (uint64_t) rect.width * rect.height;
+}
+
+static inline
+fb_rect bounds (fb_rect a, fb_rect b)
+{
+	uint32_t x = min_u32 (a.x, b.x);
+	uint32_t y = min_u32 (a.y, b.y);
+	return make_fb_rect (x, y,
+	                     max_u32 (a.x + a.width, b.x + b.width) - x,
+	                     max_u32 (a.y + a.height, b.y + b.height) - y);
+}
+
+// Pixels the union adds beyond the two rectangles. Overlapping pixels are
+// counted twice in the sum, so overlapping rectangles cost less.
+static inline
+int64_t merge_cost (fb_rect a, fb_rect b)
+{
+	return (int64_t) area (bounds (a, b)) - (int64_t) (area (a) + area (b));
+}
+
+static inline
+bool intersects (fb_rect a, fb_rect b)
+{
+	return a.x < b.x + b.width && b.x < a.x + a.width &&
+	       a.y < b.y + b.height && b.y < a.y + a.height;
+}
+
+static
+void remove_damage (fb_double_buffer* db, uint32_t index)
+{
+	db->damage [index] = db->damage [--db->damage_count];
+}
+
+// Merges rect into the list until nothing it intersects, or is cheap to merge
+// with, is left. The list therefore never holds two rectangles that share a
+// pixel.
+static
+void add_damage (fb_double_buffer* db, fb_rect rect)
+{
+	for (uint32_t i = 0; i < db->damage_count;) {
+		if (intersects (rect, db->damage [i]) || merge_cost (rect, db->damage [i]) <= MERGE_SLACK) {
+			rect = bounds (rect, db->damage [i]);
+			remove_damage (db, i);
+			i = 0;
+		}
+		else
+			++i;
+	}
+	if (db->damage_count < FB_DAMAGE_MAX) {
+		db->damage [db->damage_count++] = rect;
+		return;
+	}
+
+	uint32_t best = 0;
+	for (uint32_t i = 1; i < db->damage_count; ++i)
+		if (merge_cost (rect, db->damage [i]) < merge_cost (rect, db->damage [best]))
+			best = i;
+	rect = bounds (rect, db->damage [best]);
+	remove_damage (db, best);
+	add_damage (db, rect);
+}
+
+// Streams a row to video memory with movnti, after aligning the destination
+// to eight bytes with ordinary stores. The caller fences.
+static
+void stream_row (uint8_t* dst, const uint8_t* src, size_t bytes)
+{
+	for (; bytes != 0 && ((uintptr_t) dst & 7) != 0; --bytes)
+		*dst++ = *src++;
+	for (; bytes >= 8; bytes -= 8, dst += 8, src += 8) {
+		uint64_t word;
+		__builtin_memcpy (&word, src, 8);
+		__asm__ volatile ("movnti %1, %0" : "=m" (*(uint64_t*) dst) : "r" (word));
+	}
+	for (; bytes != 0; --bytes)
+		*dst++ = *src++;
+}
+
+
+// Extern functions
+
+bool fb_double_buffer_initialize (fb_double_buffer* db, framebuffer* front)
+{
+	uint32_t row_bytes = front->width * front->format.bytes_per_pixel;
+	uint32_t pitch = (row_bytes + BACK_PITCH_ALIGN - 1) & ~(BACK_PITCH_ALIGN - 1);
+	void* back = bootmem_alloc ((size_t) pitch * front->height, BACK_ALIGN);
+	if (back == NULL)
+		return false;
+
+	db->back  = make_framebuffer (back, front->width, front->height, pitch, front->format);
+	db->front = front;
+	db->damage_count = 0;
+	db->stats = (fb_present_stats) {.presents = 0, .rects = 0, .bytes = 0};
+	return true;
+}
+
+void fb_damage (fb_double_buffer* db, fb_rect rect)
+{
+	if (rect.x >= db->back.width || rect.y >= db->back.height)
+		return;
+	rect.width  = min_u32 (rect.width, db->back.width - rect.x);
+	rect.height = min_u32 (rect.height, db->back.height - rect.y);
+	if (rect.width != 0 && rect.height != 0)
+		add_damage (db, rect);
+}
+
+void fb_damage_all (fb_double_buffer* db)
+{
+	db->damage [0] = make_fb_rect (0, 0, db->back.width, db->back.height);
+	db->damage_count = 1;
+}
+
+uint64_t fb_present (fb_double_buffer* db)
+{
+	uint32_t bytes_per_pixel = db->back.format.bytes_per_pixel;
+	uint64_t bytes = 0;
+	for (uint32_t i = 0; i < db->damage_count; ++i) {
+		fb_rect rect = db->damage [i];
+		size_t row_bytes = (size_t) rect.width * bytes_per_pixel;
+		uint8_t* dst = fb_address (db->front, rect.x, rect.y);
+		const uint8_t* src = fb_address (&db->back, rect.x, rect.y);
+		for (uint32_t row = 0; row < rect.height; ++row) {
+			stream_row (dst, src, row_bytes);
+			dst += db->front->pitch;
+			src += db->back.pitch;
+		}
+		bytes += row_bytes * rect.height;
+	}
+	__asm__ volatile ("sfence" ::: "memory");
+
+	++db->stats.presents;
+	db->stats.rects += db->damage_count;
+	db->stats.bytes += bytes;
+	db->damage_count = 0;
+	return bytes;
+}
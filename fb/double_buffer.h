@@ -0,0 +1,61 @@
+#ifndef DOUBLE_BUFFER_H
+#define DOUBLE_BUFFER_H
+
+#include "framebuffer.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/* A back buffer in RAM for a framebuffer in video memory. Drawing goes to the
+ * back buffer with the fb_ primitives, and the caller marks what it drew as
+ * damaged; fb_present then copies only the damaged rectangles to the screen,
+ * with non-temporal stores so the copy does not evict the cache, and video
+ * memory is never read.
+ *
+ * Damage that intersects or nearly touches earlier damage is merged into it,
+ * however much the union covers beyond the two, so the rectangle list stays
+ * short and no pixel is copied twice. When the list is full, new damage is
+ * merged into whichever rectangle grows least.
+ */
+
+enum {
+	FB_DAMAGE_MAX = 16
+};
+
+typedef struct fb_rect {
+	uint32_t x;
+	uint32_t y;
+	uint32_t width;
+	uint32_t height;
+} fb_rect;
+
+typedef struct fb_present_stats {
+	uint64_t presents;
+	uint64_t rects;
+	uint64_t bytes;
+} fb_present_stats;
+
+typedef struct fb_double_buffer {
+	framebuffer      back;
+	framebuffer*     front;
+	fb_rect          damage [FB_DAMAGE_MAX];
+	uint32_t         damage_count;
+	fb_present_stats stats;
+} fb_double_buffer;
+
+static inline
+fb_rect make_fb_rect (uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+{
+	return (fb_rect) {.x = x, .y = y, .width = width, .height = height};
+}
+
+// Allocates a back buffer the size of front. Returns false when out of memory.
+bool fb_double_buffer_initialize (fb_double_buffer* db, framebuffer* front);
+
+void fb_damage (fb_double_buffer* db, fb_rect rect);
+void fb_damage_all (fb_double_buffer* db);
+
+// Copies the damage to the front buffer and clears it. Returns the number of
+// bytes copied.
+uint64_t fb_present (fb_double_buffer* db);
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef FONT_H
+#define FONT_H
+
+#include <stdint.h>
+
+// 8x8 bitmap font for printable ASCII. Each glyph is eight rows, top first;
+// the most significant bit of a row is its leftmost pixel. Glyphs are 5x7
+// with room for descenders, so cells need no extra spacing.
+
+enum {
+	FONT_WIDTH  = 8,
+	FONT_HEIGHT = 8,
+	FONT_FIRST  = 0x20,
+	FONT_LAST   = 0x7E,
+	FONT_GLYPHS = FONT_LAST - FONT_FIRST + 1
+};
+
+extern const uint8_t font_8x8 [FONT_GLYPHS] [FONT_HEIGHT];
+
+// Characters outside the font are drawn as '?'
+static inline
+uint32_t font_glyph_index (char c)
+{
+	uint8_t code = c;
+	return (code >= FONT_FIRST && code <= FONT_LAST) ? code - FONT_FIRST : '?' - FONT_FIRST;
+}
+
+#endif
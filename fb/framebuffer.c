@@ -0,0 +1,227 @@
+#include "framebuffer.h"
+#include "util/mem.h"
+#include <stdbool.h>
+
+// Rows are not aligned to the word size in 24-bit modes, or at odd x
+typedef uint16_t __attribute__ ((may_alias, aligned (1))) unaligned_u16;
+typedef uint32_t __attribute__ ((may_alias, aligned (1))) unaligned_u32;
+typedef uint64_t __attribute__ ((may_alias, aligned (1))) unaligned_u64;
+
+enum {
+	FIXED_SHIFT = 16 // Gradient channels are stepped in 16.16 fixed point
+};
+
+static
+bool clip (const framebuffer* fb, uint32_t x, uint32_t y, uint32_t* width, uint32_t* height)
+{
+	if (x >= fb->width || y >= fb->height)
+		return false;
+	if (*width > fb->width - x)
+		*width = fb->width - x;
+	if (*height > fb->height - y)
+		*height = fb->height - y;
+	return *width != 0 && *height != 0;
+}
+
+static inline
+void store_pixel (uint8_t* dst, fb_pixel pixel, uint32_t bytes_per_pixel)
+{
+	switch (bytes_per_pixel) {
+	case 4:
+		*(unaligned_u32*) dst = pixel;
+		break;
+	case 3:
+		*(unaligned_u16*) dst = pixel;
+		dst [2] = pixel >> 16;
+		break;
+	default:
+		*(unaligned_u16*) dst = pixel;
+		break;
+	}
+}
+
+// Always inlined with a constant bytes_per_pixel, so each mode gets its own
+// loop without a switch inside it
+static inline __attribute__ ((always_inline))
+void fill_row (uint8_t* dst, uint32_t count, fb_pixel pixel, uint32_t bytes_per_pixel)
+{
+	if (bytes_per_pixel == 4) {
+		uint64_t pattern = pixel * 0x100000001ull;
+		for (; count >= 2; count -= 2, dst += 8)
+			*(unaligned_u64*) dst = pattern;
+	}
+	else if (bytes_per_pixel == 3) {
+		// Four pixels make three words
+		pixel &= 0xFFFFFF;
+		uint32_t word0 = pixel | pixel << 24;
+		uint32_t word1 = pixel >> 8 | pixel << 16;
+		uint32_t word2 = pixel >> 16 | pixel << 8;
+		for (; count >= 4; count -= 4, dst += 12) {
+			((unaligned_u32*) dst) [0] = word0;
+			((unaligned_u32*) dst) [1] = word1;
+			((unaligned_u32*) dst) [2] = word2;
+		}
+	}
+	else {
+		uint64_t pattern = (uint16_t) pixel * 0x0001000100010001ull;
+		for (; count >= 4; count -= 4, dst += 8)
+			*(unaligned_u64*) dst = pattern;
+	}
+	for (; count != 0; --count, dst += bytes_per_pixel)
+		store_pixel (dst, pixel, bytes_per_pixel);
+}
+
+static
+void fill (framebuffer* fb, uint32_t x, uint32_t y, uint32_t width, uint32_t height,
+           fb_pixel pixel)
+{
+	uint8_t* row = fb_address (fb, x, y);
+	for (uint32_t i = 0; i < height; ++i, row += fb->pitch)
+		switch (fb->format.bytes_per_pixel) {
+		case 4:
+			fill_row (row, width, pixel, 4);
+			break;
+		case 3:
+			fill_row (row, width, pixel, 3);
+			break;
+		default:
+			fill_row (row, width, pixel, 2);
+			break;
+		}
+}
+
+typedef struct gradient_channels {
+	int32_t value [3]; // 16.16 fixed point, red first
+	int32_t step [3];
+} gradient_channels;
+
+static inline __attribute__ ((always_inline))
+void gradient_row (uint8_t* dst, uint32_t count, gradient_channels channels,
+                   const fb_format* format, uint32_t bytes_per_pixel)
+{
+	uint32_t red_down   = FIXED_SHIFT + format->red_loss;
+	uint32_t green_down = FIXED_SHIFT + format->green_loss;
+	uint32_t blue_down  = FIXED_SHIFT + format->blue_loss;
+	for (; count != 0; --count, dst += bytes_per_pixel) {
+		fb_pixel pixel =
+			(fb_pixel) (channels.value [0] >> red_down)   << format->red_shift   |
+			(fb_pixel) (channels.value [1] >> green_down) << format->green_shift |
+			(fb_pixel) (channels.value [2] >> blue_down)  << format->blue_shift;
+		store_pixel (dst, pixel, bytes_per_pixel);
+		for (uint32_t c = 0; c < 3; ++c)
+			channels.value [c] += channels.step [c];
+	}
+}
+
+static inline
+int32_t fixed_step (uint8_t from, uint8_t to, uint32_t distance)
+{
+	return ((int32_t) to - from) * (1 << FIXED_SHIFT) / (int32_t) distance;
+}
+
+
+// Extern functions
+
+framebuffer make_framebuffer (void* base, uint32_t width, uint32_t height,
+                              uint32_t pitch, fb_format format)
+{
+	return (framebuffer) {
+		.base   = base,
+		.width  = width,
+		.height = height,
+		.pitch  = pitch,
+		.format = format
+	};
+}
+
+framebuffer make_framebuffer_vbe (const ModeInfoBlock* mode)
+{
+	fb_format format = {
+		.bytes_per_pixel = (mode->BitsPerPixel + 8 - 1) / 8,
+		.red_shift       = mode->RedFieldPosition,
+		.green_shift     = mode->GreenFieldPosition,
+		.blue_shift      = mode->BlueFieldPosition,
+		.red_loss        = 8 - mode->RedMaskSize,
+		.green_loss      = 8 - mode->GreenMaskSize,
+		.blue_loss       = 8 - mode->BlueMaskSize
+	};
+	return make_framebuffer ((void*) (uintptr_t) mode->PhysBasePtr,
+	                         mode->XResolution, mode->YResolution,
+	                         mode->BytesPerScanLine, format);
+}
+
+void fb_plot (framebuffer* fb, uint32_t x, uint32_t y, fb_pixel pixel)
+{
+	if (x < fb->width && y < fb->height)
+		store_pixel (fb_address (fb, x, y), pixel, fb->format.bytes_per_pixel);
+}
+
+void fb_hline (framebuffer* fb, uint32_t x, uint32_t y, uint32_t length, fb_pixel pixel)
+{
+	uint32_t height = 1;
+	if (clip (fb, x, y, &length, &height))
+		fill (fb, x, y, length, 1, pixel);
+}
+
+void fb_fill_rect (framebuffer* fb, uint32_t x, uint32_t y, uint32_t width, uint32_t height,
+                   fb_pixel pixel)
+{
+	if (clip (fb, x, y, &width, &height))
+		fill (fb, x, y, width, height, pixel);
+}
+
+void fb_blit (framebuffer* fb, uint32_t x, uint32_t y, uint32_t width, uint32_t height,
+              const void* src, uint32_t src_pitch)
+{
+	if (!clip (fb, x, y, &width, &height))
+		return;
+	uint8_t* row = fb_address (fb, x, y);
+	const uint8_t* src_row = src;
+	size_t bytes = (size_t) width * fb->format.bytes_per_pixel;
+	for (uint32_t i = 0; i < height; ++i, row += fb->pitch, src_row += src_pitch)
+		memcpy (row, src_row, bytes);
+}
+
+void fb_gradient (framebuffer* fb, uint32_t x, uint32_t y, uint32_t width, uint32_t height,
+                  fb_rgb top_left, fb_rgb right_end, fb_rgb bottom_end)
+{
+	uint32_t full_width = width;
+	uint32_t full_height = height;
+	if (!clip (fb, x, y, &width, &height))
+		return;
+
+	gradient_channels row = {
+		.value = {
+			top_left.r << FIXED_SHIFT,
+			top_left.g << FIXED_SHIFT,
+			top_left.b << FIXED_SHIFT
+		},
+		.step = {
+			fixed_step (top_left.r, right_end.r, full_width),
+			fixed_step (top_left.g, right_end.g, full_width),
+			fixed_step (top_left.b, right_end.b, full_width)
+		}
+	};
+	int32_t down [3] = {
+		fixed_step (top_left.r, bottom_end.r, full_height),
+		fixed_step (top_left.g, bottom_end.g, full_height),
+		fixed_step (top_left.b, bottom_end.b, full_height)
+	};
+
+	uint8_t* dst = fb_address (fb, x, y);
+	for (uint32_t i = 0; i < height; ++i, dst += fb->pitch) {
+		switch (fb->format.bytes_per_pixel) {
+		case 4:
+			gradient_row (dst, width, row, &fb->format, 4);
+			break;
+		case 3:
+			gradient_row (dst, width, row, &fb->format, 3);
+			break;
+		default:
+			gradient_row (dst, width, row, &fb->format, 2);
+			break;
+		}
+		for (uint32_t c = 0; c < 3; ++c)
+			row.value [c] += down [c];
+	}
+}
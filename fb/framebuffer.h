@@ -0,0 +1,81 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include "vbe/vbe.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/* Linear framebuffers in direct-colour modes of 16, 24 or 32 bits per pixel.
+ * The mode is decoded once into an fb_format; colours are converted to the
+ * native pixel value by the caller, once per colour rather than per pixel,
+ * and the primitives store whole rows a machine word at a time. Coordinates
+ * are clipped to the framebuffer.
+ */
+
+// A colour in the framebuffer's own format
+typedef uint32_t fb_pixel;
+
+typedef struct fb_rgb {
+	uint8_t r;
+	uint8_t g;
+	uint8_t b;
+} fb_rgb;
+
+typedef struct fb_format {
+	uint8_t bytes_per_pixel;
+	uint8_t red_shift;
+	uint8_t green_shift;
+	uint8_t blue_shift;
+	uint8_t red_loss;   // 8 less the width of the channel
+	uint8_t green_loss;
+	uint8_t blue_loss;
+} fb_format;
+
+typedef struct framebuffer {
+	uint8_t*  base;
+	uint32_t  width;
+	uint32_t  height;
+	uint32_t  pitch;    // Bytes from one row to the next
+	fb_format format;
+} framebuffer;
+
+framebuffer make_framebuffer (void* base, uint32_t width, uint32_t height,
+                              uint32_t pitch, fb_format format);
+framebuffer make_framebuffer_vbe (const ModeInfoBlock* mode);
+
+static inline
+fb_rgb make_fb_rgb (uint8_t r, uint8_t g, uint8_t b)
+{
+	return (fb_rgb) {.r = r, .g = g, .b = b};
+}
+
+static inline
+fb_pixel fb_pixel_rgb (const fb_format* format, fb_rgb color)
+{
+	return (fb_pixel) (color.r >> format->red_loss)   << format->red_shift   |
+	       (fb_pixel) (color.g >> format->green_loss) << format->green_shift |
+	       (fb_pixel) (color.b >> format->blue_loss)  << format->blue_shift;
+}
+
+static inline
+uint8_t* fb_address (const framebuffer* fb, uint32_t x, uint32_t y)
+{
+	return fb->base + (size_t) y * fb->pitch + (size_t) x * fb->format.bytes_per_pixel;
+}
+
+void fb_plot (framebuffer* fb, uint32_t x, uint32_t y, fb_pixel pixel);
+void fb_hline (framebuffer* fb, uint32_t x, uint32_t y, uint32_t length, fb_pixel pixel);
+void fb_fill_rect (framebuffer* fb, uint32_t x, uint32_t y, uint32_t width, uint32_t height,
+                   fb_pixel pixel);
+
+// Copies pixels already in the framebuffer's format, rows src_pitch bytes apart
+void fb_blit (framebuffer* fb, uint32_t x, uint32_t y, uint32_t width, uint32_t height,
+              const void* src, uint32_t src_pitch);
+
+// Each channel goes linearly from top_left to right_end across the rectangle
+// and from top_left to bottom_end down it. The two steps add up, so their sum
+// must stay within a channel's range.
+void fb_gradient (framebuffer* fb, uint32_t x, uint32_t y, uint32_t width, uint32_t height,
+                  fb_rgb top_left, fb_rgb right_end, fb_rgb bottom_end);
+
+#endif
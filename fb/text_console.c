@@ -0,0 +1,164 @@
+#include "text_console.h"
+#include "memory/bootmem.h"
+#include "util/mem.h"
+#include <stddef.h>
+
+enum {
+	GLYPH_ALIGN = 64
+};
+
+static
+void render_glyphs (fb_console* console, fb_glyph_set* set)
+{
+	const fb_format* format = &console->display->back.format;
+	uint32_t scale = console->cell_height / FONT_HEIGHT;
+	framebuffer sheet = make_framebuffer (set->pixels, console->cell_width,
+	                                      console->cell_height * FONT_GLYPHS,
+	                                      console->glyph_pitch, *format);
+	for (uint32_t glyph = 0; glyph < FONT_GLYPHS; ++glyph)
+		for (uint32_t y = 0; y < console->cell_height; ++y) {
+			uint8_t bits = font_8x8 [glyph] [y / scale];
+			for (uint32_t x = 0; x < FONT_WIDTH; ++x)
+				fb_plot (&sheet, x, glyph * console->cell_height + y,
+				         (bits & (0x80 >> x)) ? set->fg : set->bg);
+		}
+	set->rendered = true;
+}
+
+// Moves everything below the first text row up into it
+static
+void scroll (fb_console* console)
+{
+	framebuffer* back = &console->display->back;
+	size_t line_bytes = (size_t) console->cell_height * back->pitch;
+	memmove (back->base, back->base + line_bytes, (console->rows - 1) * line_bytes);
+
+	fb_fill_rect (back, 0, (console->rows - 1) * console->cell_height,
+	              console->columns * console->cell_width, console->cell_height,
+	              console->current->bg);
+	fb_damage_all (console->display);
+}
+
+static
+void newline (fb_console* console)
+{
+	console->current_column = 0;
+	if (console->current_row + 1 < console->rows)
+		++console->current_row;
+	else
+		scroll (console);
+}
+
+static
+void putraw (fb_console* console, char c)
+{
+	if (c == '\n') {
+		newline (console);
+		return;
+	}
+
+	uint32_t x = console->current_column * console->cell_width;
+	uint32_t y = console->current_row * console->cell_height;
+	const uint8_t* glyph = console->current->pixels
+		+ (size_t) font_glyph_index (c) * console->glyph_bytes;
+	fb_blit (&console->display->back, x, y, console->cell_width, console->cell_height,
+	         glyph, console->glyph_pitch);
+	fb_damage (console->display, make_fb_rect (x, y, console->cell_width, console->cell_height));
+
+	if (++console->current_column == console->columns)
+		newline (console);
+}
+
+
+// Extern functions
+
+bool fb_console_initialize (fb_console* console, fb_double_buffer* display, uint32_t scale,
+                            fb_rgb fg, fb_rgb bg)
+{
+	const framebuffer* back = &display->back;
+	console->display        = display;
+	console->cell_width     = FONT_WIDTH;
+	console->cell_height    = FONT_HEIGHT * scale;
+	console->columns        = back->width / console->cell_width;
+	console->rows           = back->height / console->cell_height;
+	console->current_row    = 0;
+	console->current_column = 0;
+	console->glyph_pitch    = FONT_WIDTH * back->format.bytes_per_pixel;
+	console->glyph_bytes    = console->glyph_pitch * console->cell_height;
+	console->uses           = 0;
+	if (console->columns == 0 || console->rows == 0)
+		return false;
+
+	size_t set_bytes = (size_t) console->glyph_bytes * FONT_GLYPHS;
+	set_bytes = (set_bytes + GLYPH_ALIGN - 1) & ~(size_t) (GLYPH_ALIGN - 1);
+	uint8_t* pixels = bootmem_alloc (set_bytes * FB_CONSOLE_COLORS, GLYPH_ALIGN);
+	if (pixels == NULL)
+		return false;
+	for (uint32_t i = 0; i < FB_CONSOLE_COLORS; ++i)
+		console->sets [i] = (fb_glyph_set) {
+			.fg        = 0,
+			.bg        = 0,
+			.last_used = 0,
+			.rendered  = false,
+			.pixels    = pixels + i * set_bytes
+		};
+	fb_console_set_color (console, fg, bg);
+	return true;
+}
+
+void fb_console_set_color (fb_console* console, fb_rgb fg, fb_rgb bg)
+{
+	const fb_format* format = &console->display->back.format;
+	fb_pixel fg_pixel = fb_pixel_rgb (format, fg);
+	fb_pixel bg_pixel = fb_pixel_rgb (format, bg);
+
+	// Sets never rendered have last_used 0, so they are taken first
+	fb_glyph_set* set = NULL;
+	fb_glyph_set* oldest = &console->sets [0];
+	for (uint32_t i = 0; i < FB_CONSOLE_COLORS && set == NULL; ++i) {
+		fb_glyph_set* candidate = &console->sets [i];
+		if (candidate->rendered && candidate->fg == fg_pixel && candidate->bg == bg_pixel)
+			set = candidate;
+		else if (candidate->last_used < oldest->last_used)
+			oldest = candidate;
+	}
+	if (set == NULL) {
+		set = oldest;
+		set->fg = fg_pixel;
+		set->bg = bg_pixel;
+		render_glyphs (console, set);
+	}
+	set->last_used = ++console->uses;
+	console->current = set;
+}
+
+void fb_console_clear (fb_console* console)
+{
+	framebuffer* back = &console->display->back;
+	fb_fill_rect (back, 0, 0, back->width, back->height, console->current->bg);
+	fb_damage_all (console->display);
+	console->current_row = 0;
+	console->current_column = 0;
+	fb_present (console->display);
+}
+
+void fb_console_putchar (fb_console* console, char c)
+{
+	putraw (console, c);
+	fb_present (console->display);
+}
+
+void fb_console_put (fb_console* console, const char* str)
+{
+	for (size_t i = 0; str [i] != '\0'; ++i)
+		putraw (console, str [i]);
+	fb_present (console->display);
+}
+
+void fb_console_putline (fb_console* console, const char* str)
+{
+	for (size_t i = 0; str [i] != '\0'; ++i)
+		putraw (console, str [i]);
+	putraw (console, '\n');
+	fb_present (console->display);
+}
@@ -0,0 +1,56 @@
+#ifndef TEXT_CONSOLE_H
+#define TEXT_CONSOLE_H
+
+#include "double_buffer.h"
+#include "font.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Text output on a double-buffered framebuffer, with the same calls as
+ * tinyvga. Every glyph of the font is rendered once per foreground and
+ * background pair into the native pixel format, so drawing a character is a
+ * copy of its rows into the back buffer. A few pairs are kept, and the least
+ * recently chosen is rendered over when a new one is needed.
+ *
+ * Scrolling moves the back buffer up by one text row in a single copy. Every
+ * function below that prints ends with a present. There is no cursor.
+ */
+
+enum {
+	FB_CONSOLE_COLORS = 4
+};
+
+typedef struct fb_glyph_set {
+	fb_pixel fg;
+	fb_pixel bg;
+	uint32_t last_used;
+	bool     rendered;
+	uint8_t* pixels;
+} fb_glyph_set;
+
+typedef struct fb_console {
+	fb_double_buffer* display;
+	uint32_t          cell_width;
+	uint32_t          cell_height;
+	uint32_t          columns;
+	uint32_t          rows;
+	uint32_t          current_row;
+	uint32_t          current_column;
+	uint32_t          glyph_pitch; // Bytes per row of a rendered glyph
+	uint32_t          glyph_bytes;
+	uint32_t          uses;
+	fb_glyph_set*     current;
+	fb_glyph_set      sets [FB_CONSOLE_COLORS];
+} fb_console;
+
+// Each font row is drawn scale times, so 2 gives 8x16 cells. Allocates the
+// glyph sets; returns false when out of memory.
+bool fb_console_initialize (fb_console* console, fb_double_buffer* display, uint32_t scale,
+                            fb_rgb fg, fb_rgb bg);
+void fb_console_set_color (fb_console* console, fb_rgb fg, fb_rgb bg);
+void fb_console_clear (fb_console* console);
+void fb_console_putchar (fb_console* console, char c);
+void fb_console_put (fb_console* console, const char* str);
+void fb_console_putline (fb_console* console, const char* str);
+
+#endif
@@ -19,6 +19,9 @@ extern const void _kbss_start;
 extern const void _kbss_end;
 extern const void _kbss_size;
 
+extern const void _kpercpu_start;
+extern const void _kpercpu_end;
+
 extern const void _ktext_lma;
 extern const void _ktext_start;
 extern const void _ktext_end;
@@ -0,0 +1,53 @@
+#include "console.h"
+#include <stddef.h>
+
+static
+void vga_console_write (log_console* console, __attribute__ ((unused)) log_level level,
+                        const char* line)
+{
+	vga_putline (((vga_log_console*) console)->vga, line);
+}
+
+static
+void serial_console_write (log_console* console, __attribute__ ((unused)) log_level level,
+                           const char* line)
+{
+	serial_port* port = ((serial_log_console*) console)->port;
+	size_t length = 0;
+	while (line [length] != '\0')
+		++length;
+	if (log_in_emergency ()) {
+		serial_write_polled (port, line, length);
+		serial_write_polled (port, "\r\n", 2);
+	} else {
+		serial_write (port, line, length);
+		serial_write (port, "\r\n", 2);
+	}
+}
+
+
+// Extern functions
+
+vga_log_console make_vga_log_console (tinyvga* vga, log_level max_level)
+{
+	return (vga_log_console) {
+		.console = {
+			.write     = &vga_console_write,
+			.max_level = max_level,
+			.next      = NULL
+		},
+		.vga = vga
+	};
+}
+
+serial_log_console make_serial_log_console (serial_port* port, log_level max_level)
+{
+	return (serial_log_console) {
+		.console = {
+			.write     = &serial_console_write,
+			.max_level = max_level,
+			.next      = NULL
+		},
+		.port = port
+	};
+}
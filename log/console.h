@@ -0,0 +1,26 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include "log.h"
+#include "serial/serial.h"
+#include "vga/tinyvga.h"
+
+// Log consoles for the devices the kernel can print to
+
+typedef struct vga_log_console {
+	log_console console;
+	tinyvga*    vga;
+} vga_log_console;
+
+vga_log_console make_vga_log_console (tinyvga* vga, log_level max_level);
+
+// Lines end in CRLF. In an emergency they are sent by polling, so a panic
+// message is not left in the ring for an interrupt that may never come.
+typedef struct serial_log_console {
+	log_console  console;
+	serial_port* port;
+} serial_log_console;
+
+serial_log_console make_serial_log_console (serial_port* port, log_level max_level);
+
+#endif
@@ -0,0 +1,212 @@
+#include "log.h"
+#include "sched/idle.h"
+#include "smp/cpu.h"
+#include "smp/smp.h"
+#include "sync/qspinlock.h"
+#include "time/clock.h"
+#include "util/kprintf.h"
+#include "x86/control.h"
+#include <stddef.h>
+
+enum {
+	LOG_RING_SIZE = 64, // Records per CPU
+	CACHE_LINE    = 64,
+
+	// How long emergency output waits for the consoles before writing to
+	// them regardless
+	EMERGENCY_SPINS = 1000000
+};
+
+// Only the owning CPU writes records and tail, only the drainer head
+typedef struct log_ring {
+	__attribute__ ((aligned (CACHE_LINE))) uint64_t head;
+	__attribute__ ((aligned (CACHE_LINE))) uint64_t tail;
+	uint64_t   written;
+	uint64_t   dropped;
+	log_record records [LOG_RING_SIZE];
+} log_ring;
+
+static DEFINE_PER_CPU (log_ring, cpu_log);
+
+// Guards the consoles and every ring's head. Drains hold it with interrupts
+// enabled, so interrupt context only tries it, or waits a bounded time in an
+// emergency.
+static qspinlock    drain_lock;
+static log_console* consoles;
+static bool         emergency;
+
+static inline
+bool cpu_present (uint32_t cpu)
+{
+	return cpu == 0 || smp_cpu_online (cpu);
+}
+
+static
+void fill_record (log_record* record, log_level level, const char* message)
+{
+	record->timestamp_ns = clock_now_ns ();
+	record->cpu   = cpu_index ();
+	record->level = level;
+	size_t length = 0;
+	for (; length < LOG_MESSAGE_MAX - 1 && message [length] != '\0'; ++length)
+		record->message [length] = message [length];
+	record->message [length] = '\0';
+	record->length = length;
+}
+
+static
+void emit (const log_record* record)
+{
+	char line [LOG_LINE_MAX];
+	log_format (line, record);
+	for (log_console* console = consoles; console != NULL; console = console->next)
+		if (record->level <= console->max_level)
+			console->write (console, record->level, line);
+}
+
+// Called with the drain lock held. Copies the oldest pending record out and
+// frees its slot, with interrupts disabled only for that; each ring is already
+// in timestamp order, so the oldest record is at one of the heads.
+static
+bool take_oldest (log_record* out)
+{
+	uint64_t flags = save_flags_cli ();
+	log_ring* oldest = NULL;
+	const log_record* record = NULL;
+	for (uint32_t cpu = 0; cpu < MAX_CPUS; ++cpu) {
+		if (!cpu_present (cpu))
+			continue;
+		log_ring* ring = per_cpu_ptr (cpu_log, cpu);
+		if (ring->head == __atomic_load_n (&ring->tail, __ATOMIC_ACQUIRE))
+			continue;
+		const log_record* candidate = &ring->records [ring->head % LOG_RING_SIZE];
+		if (record == NULL || candidate->timestamp_ns < record->timestamp_ns) {
+			oldest = ring;
+			record = candidate;
+		}
+	}
+	if (record != NULL) {
+		*out = *record;
+		__atomic_store_n (&oldest->head, oldest->head + 1, __ATOMIC_RELEASE);
+	}
+	restore_flags (flags);
+	return record != NULL;
+}
+
+// Called with the drain lock held. The consoles run with interrupts as the
+// caller had them.
+static
+uint32_t drain_locked (void)
+{
+	uint32_t drained = 0;
+	log_record record;
+	while (take_oldest (&record)) {
+		emit (&record);
+		++drained;
+	}
+	return drained;
+}
+
+// Waits a bounded time for the drain lock, so that a CPU which died holding
+// it, or a fault inside a console, cannot keep a panic message from the
+// consoles
+static
+bool acquire_for_emergency (void)
+{
+	for (uint32_t i = 0; i < EMERGENCY_SPINS; ++i) {
+		if (qspinlock_try_acquire (&drain_lock))
+			return true;
+		cpu_relax ();
+	}
+	return false;
+}
+
+// Extern functions
+
+void log_register_console (log_console* console)
+{
+	uint64_t flags = qspinlock_acquire_irqsave (&drain_lock);
+	console->next = consoles;
+	consoles = console;
+	qspinlock_release_irqrestore (&drain_lock, flags);
+}
+
+void log_write (log_level level, const char* message)
+{
+	if (__atomic_load_n (&emergency, __ATOMIC_RELAXED)) {
+		log_record record;
+		fill_record (&record, level, message);
+		uint64_t flags = save_flags_cli ();
+		bool locked = acquire_for_emergency ();
+		emit (&record);
+		if (locked)
+			qspinlock_release (&drain_lock);
+		restore_flags (flags);
+		return;
+	}
+
+	uint64_t flags = save_flags_cli ();
+	log_ring* ring = this_cpu_ptr (cpu_log);
+	uint64_t tail = ring->tail;
+	uint64_t pending = tail - __atomic_load_n (&ring->head, __ATOMIC_ACQUIRE);
+	if (pending == LOG_RING_SIZE)
+		++ring->dropped;
+	else {
+		fill_record (&ring->records [tail % LOG_RING_SIZE], level, message);
+		__atomic_store_n (&ring->tail, tail + 1, __ATOMIC_RELEASE);
+		++ring->written;
+	}
+	restore_flags (flags);
+
+	// The drainer only needs a nudge for the first record of a burst
+	if (pending == 0)
+		idle_wake (0);
+}
+
+uint32_t log_drain (void)
+{
+	if (__atomic_load_n (&emergency, __ATOMIC_RELAXED))
+		return 0;
+	if (!qspinlock_try_acquire (&drain_lock))
+		return 0;
+	uint32_t drained = drain_locked ();
+	qspinlock_release (&drain_lock);
+	return drained;
+}
+
+// Interrupts stay disabled on the panicking CPU from here on
+void log_emergency (void)
+{
+	save_flags_cli ();
+	if (__atomic_exchange_n (&emergency, true, __ATOMIC_ACQ_REL))
+		return;
+	bool locked = acquire_for_emergency ();
+	drain_locked ();
+	if (locked)
+		qspinlock_release (&drain_lock);
+}
+
+bool log_in_emergency (void)
+{
+	return __atomic_load_n (&emergency, __ATOMIC_RELAXED);
+}
+
+char* log_format (char* line, const log_record* record)
+{
+	static const char levels [] = "EWID";
+	ksnprintf (line, LOG_LINE_MAX, "[%lu.%06lu] %u %c %s",
+	           record->timestamp_ns / 1000000000, record->timestamp_ns % 1000000000 / 1000,
+	           record->cpu, levels [record->level], record->message);
+	return line;
+}
+
+log_stats log_statistics (void)
+{
+	log_stats stats = {.written = 0, .dropped = 0};
+	for (uint32_t cpu = 0; cpu < MAX_CPUS; ++cpu) {
+		const log_ring* ring = per_cpu_ptr (cpu_log, cpu);
+		stats.written += __atomic_load_n (&ring->written, __ATOMIC_RELAXED);
+		stats.dropped += __atomic_load_n (&ring->dropped, __ATOMIC_RELAXED);
+	}
+	return stats;
+}
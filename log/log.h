@@ -0,0 +1,73 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Kernel log. log_write stamps a record with the time, CPU and level and
+ * copies it into the calling CPU's ring, with interrupts disabled for the
+ * copy but without locks or shared writes; when the ring is full, the record
+ * is dropped and counted. Consoles see nothing until the rings are drained,
+ * which CPU 0's idle loop does, oldest record first across all CPUs; the
+ * first record into an empty ring wakes CPU 0 for it.
+ *
+ * After log_emergency, for panics, everything pending is drained at once and
+ * later records go straight to the consoles from the caller.
+ */
+
+enum {
+	LOG_MESSAGE_MAX = 112, // Including the terminator; longer messages are cut
+	LOG_LINE_MAX    = LOG_MESSAGE_MAX + 40
+};
+
+typedef enum {
+	LOG_ERROR,
+	LOG_WARNING,
+	LOG_INFO,
+	LOG_DEBUG
+} log_level;
+
+typedef struct log_record {
+	uint64_t timestamp_ns;
+	uint16_t cpu;
+	uint8_t  level;
+	uint8_t  length;
+	char     message [LOG_MESSAGE_MAX];
+} log_record;
+_Static_assert (sizeof (log_record) == 128, "log_record not two cache lines");
+
+// A console is handed each record of max_level or below as one formatted
+// line, without the trailing newline. Consoles are only called from one CPU
+// at a time, with interrupts enabled when draining from a context that had
+// them enabled. In an emergency, a CPU that cannot get the consoles within a
+// bounded wait writes to them anyway.
+typedef struct log_console {
+	void (*write) (struct log_console* console, log_level level, const char* line);
+	log_level           max_level;
+	struct log_console* next;
+} log_console;
+
+typedef struct log_stats {
+	uint64_t written;
+	uint64_t dropped;
+} log_stats;
+
+void log_register_console (log_console* console);
+
+// May be called from any context, including interrupt handlers
+void log_write (log_level level, const char* message);
+
+// Hands every pending record to the consoles. Returns the number drained, or
+// 0 if another CPU is draining.
+uint32_t log_drain (void);
+
+// Switches to synchronous output for good
+void log_emergency (void);
+bool log_in_emergency (void);
+
+// Formats a record the way consoles receive it. Returns line.
+char* log_format (char* line, const log_record* record);
+
+log_stats log_statistics (void);
+
+#endif
@@ -0,0 +1,81 @@
+#include "bootmem.h"
+#include "util/mem.h"
+#include "kernel.h"
+#include "sync/qspinlock.h"
+
+// Only the first 512 GiB are identity-mapped by init
+static const uint64_t mapped_end = (uint64_t) 1 << 39;
+
+static uint64_t cursor;
+static uint64_t limit;
+static qspinlock lock;
+
+static inline
+uint64_t align_up (uint64_t value, uint64_t align)
+{
+	return (value + align - 1) & ~(align - 1);
+}
+
+// Moves begin past [object, object + size) if the two overlap
+static inline
+uint64_t skip_object (uint64_t begin, uint64_t end, uint64_t object, uint64_t size)
+{
+	if (object < end && begin < object + size)
+		return object + size;
+	return begin;
+}
+
+
+// Extern functions
+
+void bootmem_initialize (const multiboot_info_t* info)
+{
+	cursor = 0;
+	limit  = 0;
+	if (!(info->flags & MULTIBOOT_INFO_MEM_MAP))
+		return;
+
+	uint64_t mmap_begin = info->mmap_addr;
+	uint64_t mmap_end   = mmap_begin + info->mmap_length;
+	for (uint64_t addr = mmap_begin; addr < mmap_end;) {
+		const multiboot_memory_map_t* map = (const multiboot_memory_map_t*) addr;
+		addr += map->size + sizeof (map->size);
+		if (map->type != MULTIBOOT_MEMORY_AVAILABLE)
+			continue;
+
+		uint64_t begin = map->addr;
+		uint64_t end   = map->addr + map->len;
+		if (end > mapped_end)
+			end = mapped_end;
+		begin = skip_object (begin, end, 0, _linkaddr (_kernel_end));
+		begin = skip_object (begin, end, (uintptr_t) info, sizeof (*info));
+		begin = skip_object (begin, end, mmap_begin, info->mmap_length);
+		if (begin < end && end - begin > limit - cursor) {
+			cursor = begin;
+			limit  = end;
+		}
+	}
+}
+
+void* bootmem_alloc (size_t size, size_t align)
+{
+	uint64_t flags = qspinlock_acquire_irqsave (&lock);
+	uint64_t begin = align_up (cursor, align);
+	if (begin > limit || limit - begin < size) {
+		qspinlock_release_irqrestore (&lock, flags);
+		return NULL;
+	}
+	cursor = begin + size;
+	qspinlock_release_irqrestore (&lock, flags);
+
+	if (((begin | size) & (MEM_PAGE_SIZE - 1)) == 0)
+		clear_pages ((void*) begin, size / MEM_PAGE_SIZE);
+	else
+		memset ((void*) begin, 0, size);
+	return (void*) begin;
+}
+
+uint64_t bootmem_remaining (void)
+{
+	return limit - cursor;
+}
@@ -0,0 +1,21 @@
+#ifndef BOOTMEM_H
+#define BOOTMEM_H
+
+#include "multiboot/multiboot.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Takes the largest available region of the multiboot memory map, less the
+// kernel image and the multiboot structures, for permanent allocations made
+// during start-up: stacks, per-CPU areas and the like. Memory is identity-mapped
+// and never returned.
+void bootmem_initialize (const multiboot_info_t* info);
+
+// Returns zeroed memory, or NULL when the region is exhausted. Alignment must
+// be a power of two. Safe to call from any CPU.
+void* bootmem_alloc (size_t size, size_t align);
+
+// Bytes still available
+uint64_t bootmem_remaining (void);
+
+#endif
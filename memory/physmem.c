@@ -1,11 +1,5 @@
 #include "physmem.h"
-
-static inline
-void mzero64 (uint64_t* begin, uint64_t* end)
-{
-	for (uint64_t* ptr = begin; ptr != end; ++ptr)
-		*ptr = 0;
-}
+#include "util/mem.h"
 
 static inline
 uint8_t lowest_nonzero_bit (uint64_t value)
@@ -25,7 +19,7 @@ physmem_allocator physmem_make_allocator (uint64_t* bmp_buffer, uint64_t begin,
 		.bmp_end   = bmp_buffer + (end - begin)/(4096 * 64)
 	};
 
-	mzero64 (phy.bmp_begin, phy.bmp_end);
+	memset (phy.bmp_begin, 0, (phy.bmp_end - phy.bmp_begin) * sizeof (uint64_t));
 	return phy;
 }
 
@@ -0,0 +1,88 @@
+#include "vmap.h"
+#include "bootmem.h"
+#include "sync/qspinlock.h"
+#include <stdint.h>
+
+/* The identity map and the kernel image use 1 GiB pages, which cannot leave a
+ * single page unmapped. Guarded mappings instead live in their own PML4 slot,
+ * below the kernel image, with page tables built on demand from bootmem. The
+ * page tables are reached through the identity map. Only not-present entries
+ * are ever filled in, so no TLB invalidation is needed.
+ */
+
+enum {
+	PTE_PRESENT  = 1 << 0,
+	PTE_WRITABLE = 1 << 1,
+	PTE_GLOBAL   = 1 << 8,
+
+	TABLE_ENTRIES = 512,
+	VMAP_PML4_SLOT = 510
+};
+
+static const uint64_t pte_nx        = (uint64_t) 1 << 63;
+static const uint64_t pte_addr_mask = 0x000FFFFFFFFFF000;
+static const uint64_t vmap_base     = 0xFFFFFF0000000000; // PML4 slot 510
+static const uint64_t vmap_size     = (uint64_t) 1 << 39;
+
+static qspinlock lock;
+static uint64_t  next_free; // Offset into the region
+
+static inline
+uint64_t* pml4 (void)
+{
+	uint64_t cr3;
+	__asm__ volatile ("mov %%cr3, %0" : "=r" (cr3));
+	return (uint64_t*) (cr3 & pte_addr_mask);
+}
+
+// Returns the table an entry points to, creating it if absent
+static
+uint64_t* next_table (uint64_t* entry)
+{
+	if (!(*entry & PTE_PRESENT)) {
+		void* table = bootmem_alloc (PAGE_SIZE, PAGE_SIZE);
+		if (table == NULL)
+			return NULL;
+		*entry = (uint64_t) table | PTE_PRESENT | PTE_WRITABLE;
+	}
+	return (uint64_t*) (*entry & pte_addr_mask);
+}
+
+static
+bool map_page (uint64_t virtual, uint64_t physical)
+{
+	uint64_t* table = pml4 ();
+	for (uint32_t shift = 39; shift > 12; shift -= 9) {
+		table = next_table (&table [(virtual >> shift) % TABLE_ENTRIES]);
+		if (table == NULL)
+			return false;
+	}
+	table [(virtual >> 12) % TABLE_ENTRIES] = physical | PTE_PRESENT | PTE_WRITABLE | PTE_GLOBAL | pte_nx;
+	return true;
+}
+
+
+// Extern functions
+
+void* vmap_alloc_guarded (size_t size)
+{
+	size = (size + PAGE_SIZE - 1) & ~(size_t) (PAGE_SIZE - 1);
+	uint64_t flags = qspinlock_acquire_irqsave (&lock);
+
+	void* result = NULL;
+	uint64_t virtual = vmap_base + next_free + PAGE_SIZE;
+	uint8_t* physical = bootmem_alloc (size, PAGE_SIZE);
+	if (physical != NULL && next_free + PAGE_SIZE + size <= vmap_size) {
+		size_t mapped = 0;
+		for (; mapped < size; mapped += PAGE_SIZE)
+			if (!map_page (virtual + mapped, (uint64_t) physical + mapped))
+				break;
+		if (mapped == size) {
+			next_free += PAGE_SIZE + size;
+			result = (void*) virtual;
+		}
+	}
+
+	qspinlock_release_irqrestore (&lock, flags);
+	return result;
+}
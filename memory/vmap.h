@@ -0,0 +1,17 @@
+#ifndef VMAP_H
+#define VMAP_H
+
+#include <stddef.h>
+
+enum {
+	PAGE_SIZE = 4096
+};
+
+// Maps size bytes (rounded up to whole pages) of zeroed memory from bootmem
+// into a kernel region mapped with 4 KiB pages, directly above an unmapped
+// guard page, so that running off the bottom faults instead of corrupting the
+// neighbouring mapping. Returns the lowest mapped address, or NULL if memory
+// ran out. Mappings are never removed; callers recycle them.
+void* vmap_alloc_guarded (size_t size);
+
+#endif
@@ -1,15 +1,35 @@
 #include "multiboot/multiboot.h"
 #include "vga/tinyvga.h"
-#include "util/format.h"
+#include "log/log.h"
+#include "log/console.h"
+#include "serial/serial.h"
+#include "util/kprintf.h"
+#include "util/sinks.h"
 #include "x86/interrupts/IDT.h"
 #include "x86/interrupts/ISR.h"
 #include "x86/interrupts/IRQ.h"
+#include "x86/interrupts/IOAPIC.h"
+#include "x86/fpu.h"
+#include "time/clock.h"
+#include "time/clockevent.h"
+#include "time/timer.h"
+#include "smp/cpu.h"
+#include "smp/smp.h"
+#include "memory/bootmem.h"
+#include "util/mem.h"
+#include "sched/idle.h"
+#include "sched/thread.h"
+#include "sched/task.h"
+#include "sync/rcu.h"
 #include <stdint.h>
 #include <stddef.h>
 
 static tinyvga vga;
+static vga_sink screen;
 static IDT idt;
 static ISR_table_t isrt;
+static vga_log_console console;
+static serial_log_console serial_console;
 
 
 
@@ -35,21 +55,15 @@ void print_multiboot_memmap_entry (const multiboot_memory_map_t* map)
 {
 	static const char* typenames [] = {
 		NULL,
-		"AVAILABLE       ",
-		"RESERVED        ",
+		"AVAILABLE",
+		"RESERVED",
 		"ACPI_RECLAIMABLE",
-		"NVS             ",
-		"BADRAM          "
+		"NVS",
+		"BADRAM"
 	};
 
-	char buffer [17];
-	vga_put (&vga, "  ");
-	vga_put (&vga, typenames [map->type]);
-	vga_put (&vga, " [0x");
-	vga_put (&vga, format_uint (buffer, map->addr, 16, 16));
-	vga_put (&vga, " - 0x");
-	vga_put (&vga, format_uint (buffer, map->addr + map->len - 1, 16, 16));
-	vga_putline (&vga, "]");
+	kprintf (&screen.sink, "  %-16s [0x%016llX - 0x%016llX]\n",
+	         typenames [map->type], map->addr, map->addr + map->len - 1);
 }
 
 void print_multiboot_memmap (const multiboot_info_t* info)
@@ -57,7 +71,7 @@ void print_multiboot_memmap (const multiboot_info_t* info)
 	if (!(info->flags & MULTIBOOT_INFO_MEM_MAP))
 		return;
 
-	vga_putline (&vga, "Memory map:");
+	kprintf (&screen.sink, "Memory map:\n");
 	uint64_t memsize = 0;
 	uint64_t amemsize = 0;
 	for (const multiboot_memory_map_t* map = mmap_begin (info);
@@ -70,15 +84,108 @@ void print_multiboot_memmap (const multiboot_info_t* info)
 			amemsize += map->len;
 	}
 
-	char buffer [20 + (20 - 1)/3 + 1];
-	vga_put (&vga, "  Total ");
-	vga_put (&vga, numsep (format_uint (buffer, memsize, 0, 10), ','));
-	vga_put (&vga, " bytes (");
-	vga_put (&vga, numsep (format_uint (buffer, amemsize, 0, 10), ','));
-	vga_putline (&vga, " bytes available)");
+	kprintf (&screen.sink, "  Total %'lu bytes (%'lu bytes available)\n", memsize, amemsize);
 }
 
 
+enum {
+	SCAN_PAGE        = 4096,
+	SCAN_GRAIN       = 64, // Pages per task
+	SCAN_MAX_REGIONS = 64
+};
+
+// Only the first 512 GiB are identity-mapped
+static const uint64_t scan_limit = (uint64_t) 1 << 39;
+
+typedef struct scan_region {
+	uint64_t address;
+	uint64_t first_page; // Index of the region's first page among all scanned
+	uint64_t pages;
+} scan_region;
+
+static scan_region scan_regions [SCAN_MAX_REGIONS];
+static uint32_t    scan_region_count;
+static uint64_t    scan_pages;
+static uint64_t    scan_sum;
+
+uint64_t collect_scan_regions (const multiboot_info_t* info)
+{
+	scan_region_count = 0;
+	scan_pages = 0;
+	if (!(info->flags & MULTIBOOT_INFO_MEM_MAP))
+		return 0;
+
+	for (const multiboot_memory_map_t* map = mmap_begin (info);
+	     map != mmap_end (info) && scan_region_count < SCAN_MAX_REGIONS;
+	     map = mmap_next (map))
+	{
+		if (map->type != MULTIBOOT_MEMORY_AVAILABLE)
+			continue;
+		uint64_t begin = (map->addr + SCAN_PAGE - 1) & ~(uint64_t) (SCAN_PAGE - 1);
+		uint64_t end   = (map->addr + map->len) & ~(uint64_t) (SCAN_PAGE - 1);
+		if (end > scan_limit)
+			end = scan_limit;
+		if (begin >= end)
+			continue;
+		scan_regions [scan_region_count++] = (scan_region) {
+			.address    = begin,
+			.first_page = scan_pages,
+			.pages      = (end - begin) / SCAN_PAGE
+		};
+		scan_pages += (end - begin) / SCAN_PAGE;
+	}
+	return scan_pages;
+}
+
+// Sums every word of pages [begin, end) of the available memory
+void scan_pages_body (uint64_t begin, uint64_t end, __attribute__ ((unused)) void* arg)
+{
+	uint64_t sum = 0;
+	for (uint32_t r = 0; r < scan_region_count && begin < end; ++r) {
+		const scan_region* region = &scan_regions [r];
+		uint64_t region_end = region->first_page + region->pages;
+		if (begin >= region_end)
+			continue;
+		uint64_t stop = (end < region_end) ? end : region_end;
+		const uint64_t* word = (const uint64_t*) (region->address + (begin - region->first_page) * SCAN_PAGE);
+		const uint64_t* last = word + (stop - begin) * (SCAN_PAGE / sizeof (uint64_t));
+		for (; word != last; ++word)
+			sum += *word;
+		begin = stop;
+	}
+	__atomic_add_fetch (&scan_sum, sum, __ATOMIC_RELAXED);
+}
+
+void print_memory_scan (const multiboot_info_t* info)
+{
+	if (collect_scan_regions (info) == 0)
+		return;
+
+	kprintf (&screen.sink, "Scanning %'lu bytes of available memory:\n", scan_pages * SCAN_PAGE);
+
+	uint64_t baseline_ns = 0;
+	uint32_t cpus = smp_online_count ();
+	for (uint32_t workers = 1; ; workers *= 2) {
+		if (workers > cpus)
+			workers = cpus;
+		task_set_concurrency (workers);
+		scan_sum = 0;
+		uint64_t start = clock_now_ns ();
+		parallel_for (0, scan_pages, SCAN_GRAIN, &scan_pages_body, NULL);
+		uint64_t elapsed = clock_now_ns () - start;
+		if (workers == 1)
+			baseline_ns = elapsed;
+
+		uint64_t speedup = elapsed ? baseline_ns * 100 / elapsed : 0;
+		kprintf (&screen.sink, "  %u CPUs: %'lu us, speedup %lu.%02lux, sum 0x%016lX\n",
+		         workers, elapsed / 1000, speedup / 100, speedup % 100, scan_sum);
+		if (workers == cpus)
+			break;
+	}
+	task_set_concurrency (cpus);
+}
+
+
 
 void halt (void)
 {
@@ -91,27 +198,18 @@ void halt (void)
 	);
 }
 
-void wait (void)
-{
-	__asm__ volatile (
-		"sti;"
-		"wait%=:"
-		"hlt;"
-		"jmp wait%="
-		:
-	);
-}
-
+// Exceptions are fatal and reported synchronously; anything else is logged
 static
 void halt_ISR (INT_index interrupt, uint64_t error)
 {
-	char buffer [5];
-	vga_put (&vga, "Interrupt: v=");
-	vga_put (&vga, format_uint (buffer, interrupt, 2, 16));
-	vga_put (&vga, " e=");
-	vga_putline (&vga, format_uint (buffer, error, 4, 16));
+	char message [40];
+	ksnprintf (message, sizeof (message), "Interrupt: v=%02X e=%04lX", interrupt, error);
 
-	if (interrupt <= INT_SIMD_exception)
+	bool fatal = interrupt <= INT_SIMD_exception;
+	if (fatal)
+		log_emergency ();
+	log_write (fatal ? LOG_ERROR : LOG_WARNING, message);
+	if (fatal)
 		halt ();
 }
 
@@ -121,22 +219,63 @@ void kernel_main (multiboot_info_t* info,
                   __attribute__ ((unused)) multiboot_uint32_t magic)
 {
 	vga = vga_initialize ();
+	vga_set_hardware_scroll (&vga, true);
 	vga_clear (&vga);
-	vga_putline (&vga, "Success.");
+	screen = make_vga_sink (&vga);
+	console = make_vga_log_console (&vga, LOG_INFO);
+	log_register_console (&console.console);
+	kprintf (&screen.sink, "Success.\n");
 
+	mem_initialize ();
+	bootmem_initialize (info);
 	ISR_table_initialize (&isrt, &halt_ISR);
 	IDT_initialize (&idt);
 	IRQ_disable (IRQ_PIT);
+	fpu_initialize ();
+	clock_initialize ();
+	cpu_initialize ();
+	timers_initialize ();
+	idle_initialize ();
+	threads_initialize ();
+	smp_initialize ();
+	IOAPIC_initialize ();
+	serial_port* com1 = serial_initialize (SERIAL_COM1, SERIAL_BAUD_MAX);
+	if (com1 != NULL) {
+		serial_console = make_serial_log_console (com1, LOG_INFO);
+		log_register_console (&serial_console.console);
+	}
+	tasks_initialize ();
+	rcu_initialize ();
 
 	print_multiboot_memmap (info);
 
-	char buffer [17];
-	vga_put (&vga, "Kernel image start: 0x");
-	vga_putline (&vga, format_uint (buffer, _linkaddr(_kernel_start), 16, 16));
-	vga_put (&vga, "Kernel image end:   0x");
-	vga_putline (&vga, format_uint (buffer, _linkaddr(_kernel_end), 16, 16));
+	kprintf (&screen.sink,
+	         "Kernel image start: 0x%016lX\n"
+	         "Kernel image end:   0x%016lX\n"
+	         "FPU save area:      %zu bytes, %s\n",
+	         _linkaddr(_kernel_start), _linkaddr(_kernel_end),
+	         fpu_area_size (), fpu_get_strategy () == FPU_EAGER ? "eager" : "lazy");
+	char serial_name [32] = "none";
+	if (com1 != NULL)
+		ksnprintf (serial_name, sizeof (serial_name), "COM1, %u baud", SERIAL_BAUD_MAX);
+	kprintf (&screen.sink,
+	         "Clock source:       %s, TSC %'lu Hz%s\n"
+	         "Timer events:       %s\n"
+	         "Interrupts:         %s\n"
+	         "Serial console:     %s\n"
+	         "Idle:               %s\n",
+	         clock_source_name (), clock_tsc_hz (),
+	         clock_tsc_invariant () ? " (invariant)" : "",
+	         clockevent_name (),
+	         IOAPIC_present () ? "I/O APIC" : "8259 PIC",
+	         serial_name,
+	         idle_method_name ());
+	kprintf (&screen.sink, "CPUs:               %u online in %lu us\n",
+	         smp_online_count (), smp_boot_time_ns () / 1000);
+
+	print_memory_scan (info);
 
-	wait ();
+	idle_loop ();
 }
 
 #define FLAGS (MULTIBOOT_PAGE_ALIGN | MULTIBOOT_MEMORY_INFO)
@@ -0,0 +1,200 @@
+#include "idle.h"
+#include "thread.h"
+#include "log/log.h"
+#include "smp/cpu.h"
+#include "sync/rcu.h"
+#include "time/clock.h"
+#include "time/timer.h"
+#include "x86/control.h"
+#include "x86/cpuid.h"
+#include "x86/interrupts/ISR.h"
+#include "x86/interrupts/LAPIC.h"
+#include <stddef.h>
+
+enum {
+	CACHE_LINE = 64,
+	MAX_CSTATES = 8
+};
+
+typedef struct idle_cstate {
+	const char* name;
+	uint32_t    hint;           // MWAIT EAX: C-state - 1 in bits 7:4, sub-state in 3:0
+	uint32_t    exit_latency_ns;
+	uint32_t    target_residency_ns;
+} idle_cstate;
+
+// CPUID only enumerates which MWAIT states exist, not what they cost; these
+// latencies are conservative figures for recent Intel cores.
+static const idle_cstate known_cstates [] = {
+	{"C1",  0x00,    2000,    2000},
+	{"C1E", 0x01,   10000,   20000},
+	{"C3",  0x10,   70000,  100000},
+	{"C6",  0x20,   85000,  200000},
+	{"C7s", 0x33,  124000,  800000},
+	{"C8",  0x40,  200000,  800000},
+	{"C9",  0x50,  480000, 5000000},
+	{"C10", 0x60,  890000, 5000000}
+};
+
+// The wakeup flag is alone on the line that MWAIT monitors, so that nothing but
+// a wakeup ends the wait early.
+typedef struct __attribute__ ((aligned (CACHE_LINE))) idle_state {
+	uint32_t wake;
+	uint32_t polling; // Set while in MWAIT; a store to wake is then enough
+	uint64_t average_ns;
+	uint8_t  padding [CACHE_LINE - 2 * sizeof (uint32_t) - sizeof (uint64_t)];
+} idle_state;
+_Static_assert (sizeof (idle_state) == CACHE_LINE, "idle_state not one line");
+
+static idle_method        method;
+static const idle_cstate* cstates [MAX_CSTATES];
+static uint32_t           cstate_count;
+static uint64_t           latency_limit_ns;
+
+static DEFINE_PER_CPU (idle_state, cpu_idle);
+
+static inline
+void monitor (const void* address)
+{
+	__asm__ volatile ("monitor" :: "a" (address), "c" (0), "d" (0));
+}
+
+static inline
+void sti_mwait (uint32_t hint)
+{
+	// The interrupt shadow of STI covers MWAIT, so an interrupt that is
+	// already pending ends the wait instead of being taken before it.
+	__asm__ volatile ("sti; mwait" :: "a" (hint), "c" (0) : "memory");
+}
+
+static inline
+void sti_hlt (void)
+{
+	__asm__ volatile ("sti; hlt" ::: "memory");
+}
+
+static
+void enumerate_cstates (void)
+{
+	cpuid_result leaf = cpuid (5, 0);
+	bool enumerated = leaf.ecx & CPUID_5_ECX_EMX;
+
+	cstate_count = 0;
+	for (size_t i = 0; i < sizeof (known_cstates) / sizeof (known_cstates [0]); ++i) {
+		uint32_t cstate   = (known_cstates [i].hint >> 4) + 1;
+		uint32_t substate = known_cstates [i].hint & 0xF;
+		uint32_t substates = enumerated ? (leaf.edx >> (4 * cstate)) & 0xF : (cstate == 1);
+		if (substate < substates && cstate_count < MAX_CSTATES)
+			cstates [cstate_count++] = &known_cstates [i];
+	}
+}
+
+// The idle period ends at the next timer at the latest; interrupts from devices
+// tend to end it sooner, which the running average of past idle periods
+// captures.
+static
+uint64_t predict_idle_ns (const idle_state* state, uint64_t now)
+{
+	uint64_t deadline = timer_next_deadline ();
+	uint64_t predicted = (deadline > now) ? deadline - now : 0;
+	if (state->average_ns != 0 && 2 * state->average_ns < predicted)
+		predicted = 2 * state->average_ns;
+	return predicted;
+}
+
+static
+const idle_cstate* select_cstate (uint64_t predicted_ns)
+{
+	const idle_cstate* selected = NULL;
+	for (uint32_t i = 0; i < cstate_count; ++i) {
+		const idle_cstate* candidate = cstates [i];
+		if (candidate->target_residency_ns > predicted_ns ||
+		    candidate->exit_latency_ns > latency_limit_ns)
+			break;
+		selected = candidate;
+	}
+	return (selected != NULL) ? selected : cstates [0];
+}
+
+
+// Extern functions
+
+void idle_initialize (void)
+{
+	cpuid_result leaf = cpuid (1, 0);
+	method = IDLE_HLT;
+	latency_limit_ns = UINT64_MAX;
+	if ((leaf.ecx & CPUID_1_ECX_MONITOR) && cpuid_max_leaf () >= 5) {
+		enumerate_cstates ();
+		if (cstate_count != 0)
+			method = IDLE_MWAIT;
+	}
+	set_ISR (INT_IPI_wakeup, &null_ISR);
+}
+
+idle_method idle_get_method (void)
+{
+	return method;
+}
+
+const char* idle_method_name (void)
+{
+	return (method == IDLE_MWAIT) ? "MWAIT" : "HLT";
+}
+
+void idle_set_latency_limit (uint64_t latency_ns)
+{
+	latency_limit_ns = latency_ns;
+}
+
+bool idle_enter (void)
+{
+	__asm__ volatile ("cli" ::: "memory");
+	idle_state* state = this_cpu_ptr (cpu_idle);
+	uint64_t start = clock_now_ns ();
+
+	if (__atomic_load_n (&state->wake, __ATOMIC_ACQUIRE) == 0) {
+		if (method == IDLE_MWAIT) {
+			const idle_cstate* cstate = select_cstate (predict_idle_ns (state, start));
+			__atomic_store_n (&state->polling, 1, __ATOMIC_SEQ_CST);
+			monitor (&state->wake);
+			if (__atomic_load_n (&state->wake, __ATOMIC_SEQ_CST) == 0)
+				sti_mwait (cstate->hint);
+			__asm__ volatile ("cli" ::: "memory");
+			__atomic_store_n (&state->polling, 0, __ATOMIC_RELAXED);
+		}
+		else {
+			sti_hlt ();
+			__asm__ volatile ("cli" ::: "memory");
+		}
+	}
+
+	uint64_t idle_ns = clock_now_ns () - start;
+	state->average_ns = (3 * state->average_ns + idle_ns) / 4;
+	bool woken = __atomic_exchange_n (&state->wake, 0, __ATOMIC_ACQ_REL);
+	__asm__ volatile ("sti" ::: "memory");
+	return woken;
+}
+
+void idle_loop (void)
+{
+	bool drains_log = (cpu_index () == 0);
+	for (;;) {
+		rcu_quiescent ();
+		if (drains_log)
+			log_drain ();
+		thread_yield ();
+		idle_enter ();
+	}
+}
+
+void idle_wake (uint32_t cpu)
+{
+	idle_state* state = per_cpu_ptr (cpu_idle, cpu);
+	if (__atomic_exchange_n (&state->wake, 1, __ATOMIC_SEQ_CST) != 0)
+		return;
+	if (__atomic_load_n (&state->polling, __ATOMIC_SEQ_CST))
+		return;
+	if (cpu != cpu_index () && LAPIC_present ())
+		LAPIC_send_IPI (cpu_apic_id (cpu), INT_IPI_wakeup);
+}
@@ -0,0 +1,35 @@
+#ifndef IDLE_H
+#define IDLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum {
+	IDLE_HLT,
+	IDLE_MWAIT
+} idle_method;
+
+// Uses MONITOR/MWAIT when CPUID reports it, with the C-states that CPUID
+// enumerates, and HLT otherwise. Requires cpu_initialize and timers_initialize.
+void idle_initialize (void);
+
+idle_method idle_get_method (void);
+const char* idle_method_name (void);
+
+// Deepest acceptable exit latency; states that take longer to wake up from are
+// not entered. Defaults to no limit.
+void idle_set_latency_limit (uint64_t latency_ns);
+
+// Idles the calling CPU until an interrupt or idle_wake. Must be called with
+// interrupts enabled. Returns true if woken by idle_wake.
+bool idle_enter (void);
+
+// Body of each CPU's idle thread: runs queued threads, idling in between, and
+// reports RCU quiescent states. CPU 0 also drains the kernel log.
+__attribute__ ((noreturn)) void idle_loop (void);
+
+// Wakes an idle CPU. A CPU waiting in MWAIT is woken by the store to the line
+// it monitors; an IPI is only sent to CPUs waiting in HLT.
+void idle_wake (uint32_t cpu);
+
+#endif
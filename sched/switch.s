@@ -0,0 +1,32 @@
+.section .text
+
+# Only the registers the calling convention makes callee-saved are kept; the
+# caller of context_switch has already saved everything else it needs.
+	.global context_switch
+	.type context_switch, @function
+context_switch: # (uint64_t* save_sp, uint64_t next_sp)
+	pushq	%rbp
+	pushq	%rbx
+	pushq	%r12
+	pushq	%r13
+	pushq	%r14
+	pushq	%r15
+	movq	%rsp, (%rdi)
+	movq	%rsi, %rsp
+	popq	%r15
+	popq	%r14
+	popq	%r13
+	popq	%r12
+	popq	%rbx
+	popq	%rbp
+	ret
+	.size context_switch, . - context_switch
+
+# A new thread's first context_switch returns here, with the stack 16-byte
+# aligned as at a call site.
+	.global thread_entry
+	.type thread_entry, @function
+thread_entry:
+	call	thread_start
+	ud2
+	.size thread_entry, . - thread_entry
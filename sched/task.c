@@ -0,0 +1,297 @@
+#include "task.h"
+#include "thread.h"
+#include "smp/cpu.h"
+#include "smp/smp.h"
+#include "x86/control.h"
+#include <stddef.h>
+
+/* Each CPU has a fixed-size Chase-Lev deque. The owner pushes and pops at the
+ * bottom without atomic read-modify-writes except when taking the last task;
+ * thieves take from the top with a compare-and-swap. Threads are cooperative,
+ * so whichever thread runs on a CPU is that deque's owner. A spawn that finds
+ * the deque full runs the task at once.
+ *
+ * Workers that find nothing to run or steal spin briefly, then announce that
+ * they are sleeping, look once more and block. Spawners check for sleepers
+ * after pushing; the sequentially consistent flag and deque accesses on both
+ * sides ensure that one of the two sees the other.
+ */
+
+enum {
+	CACHE_LINE = 64,
+	DEQUE_SIZE = 256, // Power of two
+	STEAL_SPINS = 256
+};
+
+typedef struct task_deque {
+	__attribute__ ((aligned (CACHE_LINE))) int64_t top;    // Thieves
+	__attribute__ ((aligned (CACHE_LINE))) int64_t bottom; // Owner
+	task*    slots [DEQUE_SIZE];
+	uint64_t random_state;
+	thread*  worker;
+	uint32_t sleeping;
+} task_deque;
+
+static DEFINE_PER_CPU (task_deque, cpu_deque);
+
+static uint32_t concurrency;
+static uint32_t sleepers;
+
+static
+bool deque_push (task_deque* deque, task* t)
+{
+	int64_t bottom = __atomic_load_n (&deque->bottom, __ATOMIC_RELAXED);
+	int64_t top    = __atomic_load_n (&deque->top, __ATOMIC_ACQUIRE);
+	if (bottom - top >= DEQUE_SIZE)
+		return false;
+	__atomic_store_n (&deque->slots [bottom & (DEQUE_SIZE - 1)], t, __ATOMIC_RELAXED);
+	__atomic_thread_fence (__ATOMIC_RELEASE);
+	__atomic_store_n (&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+	return true;
+}
+
+static
+task* deque_pop (task_deque* deque)
+{
+	int64_t bottom = __atomic_load_n (&deque->bottom, __ATOMIC_RELAXED) - 1;
+	__atomic_store_n (&deque->bottom, bottom, __ATOMIC_RELAXED);
+	__atomic_thread_fence (__ATOMIC_SEQ_CST);
+	int64_t top = __atomic_load_n (&deque->top, __ATOMIC_RELAXED);
+
+	task* t = NULL;
+	if (top <= bottom) {
+		t = __atomic_load_n (&deque->slots [bottom & (DEQUE_SIZE - 1)], __ATOMIC_RELAXED);
+		if (top != bottom)
+			return t;
+		// Last task: race the thieves for it
+		if (!__atomic_compare_exchange_n (&deque->top, &top, top + 1, false,
+		                                  __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+			t = NULL;
+	}
+	__atomic_store_n (&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+	return t;
+}
+
+static
+task* deque_steal (task_deque* deque)
+{
+	int64_t top = __atomic_load_n (&deque->top, __ATOMIC_ACQUIRE);
+	__atomic_thread_fence (__ATOMIC_SEQ_CST);
+	int64_t bottom = __atomic_load_n (&deque->bottom, __ATOMIC_ACQUIRE);
+	if (top >= bottom)
+		return NULL;
+	task* t = __atomic_load_n (&deque->slots [top & (DEQUE_SIZE - 1)], __ATOMIC_RELAXED);
+	if (!__atomic_compare_exchange_n (&deque->top, &top, top + 1, false,
+	                                  __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+		return NULL;
+	return t;
+}
+
+static
+uint32_t random_victim (task_deque* self, uint32_t cpus)
+{
+	uint64_t x = self->random_state;
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	self->random_state = x;
+	return x % cpus;
+}
+
+// One pass over the other CPUs, starting at a random one
+static
+task* steal (task_deque* self, uint32_t cpu)
+{
+	uint32_t cpus = __atomic_load_n (&concurrency, __ATOMIC_RELAXED);
+	if (cpus <= 1)
+		return NULL;
+	uint32_t first = random_victim (self, cpus);
+	for (uint32_t i = 0; i < cpus; ++i) {
+		uint32_t victim = (first + i) % cpus;
+		if (victim == cpu || !smp_cpu_online (victim))
+			continue;
+		task* t = deque_steal (per_cpu_ptr (cpu_deque, victim));
+		if (t != NULL)
+			return t;
+	}
+	return NULL;
+}
+
+// The calling CPU's own deque first; stealing only within the concurrency
+// limit. A CPU outside the limit still runs the tasks it spawned itself.
+static
+task* find_task (void)
+{
+	uint32_t cpu = cpu_index ();
+	task_deque* self = this_cpu_ptr (cpu_deque);
+	task* t = deque_pop (self);
+	if (t == NULL && cpu < __atomic_load_n (&concurrency, __ATOMIC_RELAXED))
+		t = steal (self, cpu);
+	return t;
+}
+
+static
+void run_task (task* t)
+{
+	task_group* group = t->group;
+	t->function (t->arg);
+	__atomic_sub_fetch (&group->pending, 1, __ATOMIC_RELEASE);
+}
+
+static
+void wake_sleeper (void)
+{
+	if (__atomic_load_n (&sleepers, __ATOMIC_SEQ_CST) == 0)
+		return;
+	uint32_t self = cpu_index ();
+	uint32_t cpus = __atomic_load_n (&concurrency, __ATOMIC_RELAXED);
+	for (uint32_t cpu = 0; cpu < cpus; ++cpu) {
+		task_deque* deque = per_cpu_ptr (cpu_deque, cpu);
+		uint32_t expected = 1;
+		if (cpu != self && deque->worker != NULL &&
+		    __atomic_compare_exchange_n (&deque->sleeping, &expected, 0, false,
+		                                 __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+			__atomic_sub_fetch (&sleepers, 1, __ATOMIC_SEQ_CST);
+			thread_wake (deque->worker);
+			return;
+		}
+	}
+}
+
+// Undoes the sleep announcement unless a spawner already took it back
+static
+void withdraw_sleep (task_deque* self)
+{
+	uint32_t expected = 1;
+	if (__atomic_compare_exchange_n (&self->sleeping, &expected, 0, false,
+	                                 __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+		__atomic_sub_fetch (&sleepers, 1, __ATOMIC_SEQ_CST);
+}
+
+static
+void worker_main (__attribute__ ((unused)) void* arg)
+{
+	task_deque* self = this_cpu_ptr (cpu_deque);
+	for (;;) {
+		task* t = NULL;
+		for (uint32_t spin = 0; t == NULL && spin < STEAL_SPINS; ++spin)
+			if ((t = find_task ()) == NULL)
+				cpu_relax ();
+
+		if (t == NULL) {
+			__atomic_store_n (&self->sleeping, 1, __ATOMIC_SEQ_CST);
+			__atomic_add_fetch (&sleepers, 1, __ATOMIC_SEQ_CST);
+			t = find_task ();
+			if (t == NULL)
+				thread_block ();
+			withdraw_sleep (self);
+			if (t == NULL)
+				continue;
+		}
+
+		run_task (t);
+		// Let other threads on this CPU run between tasks
+		thread_yield ();
+	}
+}
+
+typedef struct range_job {
+	parallel_body body;
+	void*         arg;
+	uint64_t      begin;
+	uint64_t      end;
+	uint64_t      grain;
+	task          task;
+} range_job;
+
+// Splits off the upper half as a task and recurses on the lower half, so the
+// largest pieces sit at the top of the deque where thieves find them.
+static
+void run_range (void* job_ptr)
+{
+	range_job* job = job_ptr;
+	if (job->end - job->begin <= job->grain) {
+		job->body (job->begin, job->end, job->arg);
+		return;
+	}
+
+	uint64_t middle = job->begin + (job->end - job->begin) / 2;
+	task_group group = make_task_group ();
+	range_job upper = *job;
+	upper.begin = middle;
+	task_spawn (&group, &upper.task, &run_range, &upper);
+
+	range_job lower = *job;
+	lower.end = middle;
+	run_range (&lower);
+	task_sync (&group);
+}
+
+
+// Extern functions
+
+void tasks_initialize (void)
+{
+	uint32_t cpus = cpu_count ();
+	for (uint32_t cpu = 0; cpu < cpus; ++cpu) {
+		task_deque* deque = per_cpu_ptr (cpu_deque, cpu);
+		deque->random_state = 0x9E3779B97F4A7C15 * (cpu + 1);
+		if (smp_cpu_online (cpu))
+			deque->worker = thread_create_on (cpu, &worker_main, NULL);
+	}
+	concurrency = cpus;
+}
+
+void task_spawn (task_group* group, task* t, task_function function, void* arg)
+{
+	t->function = function;
+	t->arg      = arg;
+	t->group    = group;
+	__atomic_add_fetch (&group->pending, 1, __ATOMIC_RELAXED);
+
+	if (!deque_push (this_cpu_ptr (cpu_deque), t)) {
+		run_task (t);
+		return;
+	}
+	__atomic_thread_fence (__ATOMIC_SEQ_CST);
+	wake_sleeper ();
+}
+
+void task_sync (task_group* group)
+{
+	while (__atomic_load_n (&group->pending, __ATOMIC_ACQUIRE) != 0) {
+		task* t = find_task ();
+		if (t != NULL)
+			run_task (t);
+		else
+			cpu_relax ();
+	}
+}
+
+void parallel_for (uint64_t begin, uint64_t end, uint64_t grain, parallel_body body, void* arg)
+{
+	if (begin >= end)
+		return;
+	range_job job = {
+		.body  = body,
+		.arg   = arg,
+		.begin = begin,
+		.end   = end,
+		.grain = (grain != 0) ? grain : 1
+	};
+	run_range (&job);
+}
+
+void task_set_concurrency (uint32_t cpus)
+{
+	if (cpus == 0)
+		cpus = 1;
+	if (cpus > cpu_count ())
+		cpus = cpu_count ();
+	__atomic_store_n (&concurrency, cpus, __ATOMIC_RELAXED);
+}
+
+uint32_t task_concurrency (void)
+{
+	return __atomic_load_n (&concurrency, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,50 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Fork/join parallelism over a pool of one worker thread per CPU. A spawned
+ * task goes on the spawning CPU's deque, from which that CPU takes the newest
+ * task and other CPUs steal the oldest. Tasks run to completion on whichever
+ * CPU takes them and must not block. The caller owns the storage of every
+ * task and group and keeps it alive until task_sync returns.
+ */
+
+typedef void (*task_function) (void* arg);
+
+typedef struct task_group {
+	uint32_t pending;
+} task_group;
+
+typedef struct task {
+	task_function function;
+	void*         arg;
+	task_group*   group;
+} task;
+
+static inline
+task_group make_task_group (void)
+{
+	return (task_group) {.pending = 0};
+}
+
+// Starts a worker on every online CPU. Requires threads_initialize and
+// smp_initialize.
+void tasks_initialize (void);
+
+void task_spawn (task_group* group, task* t, task_function function, void* arg);
+
+// Runs and steals tasks until every task spawned into the group has finished
+void task_sync (task_group* group);
+
+// Calls body on disjoint subranges of [begin, end) no longer than grain,
+// spread over the pool, and returns once all calls have finished.
+typedef void (*parallel_body) (uint64_t begin, uint64_t end, void* arg);
+void parallel_for (uint64_t begin, uint64_t end, uint64_t grain, parallel_body body, void* arg);
+
+// Limits task execution to CPUs 0 to cpus - 1, for measuring scaling
+void task_set_concurrency (uint32_t cpus);
+uint32_t task_concurrency (void);
+
+#endif
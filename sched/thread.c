@@ -0,0 +1,266 @@
+#include "thread.h"
+#include "idle.h"
+#include "memory/bootmem.h"
+#include "memory/vmap.h"
+#include "smp/cpu.h"
+#include "sync/qspinlock.h"
+#include "sync/rcu.h"
+#include "time/clock.h"
+#include "x86/control.h"
+#include <stddef.h>
+
+enum {
+	STACK_SIZE = 16384,
+
+	// Callee-saved registers popped by context_switch
+	SWITCH_FRAME_WORDS = 6
+};
+
+typedef struct run_queue {
+	qspinlock lock; // Guards head, tail and the state of queued threads
+	thread*   head;
+	thread*   tail;
+	thread*   current;
+	thread*   dead; // Exited; recycled once switched away from
+	thread    idle;
+} run_queue;
+
+static DEFINE_PER_CPU (run_queue, cpu_rq);
+
+static qspinlock free_lock;
+static thread*   free_threads;
+
+extern void context_switch (uint64_t* save_sp, uint64_t next_sp);
+extern void thread_entry (void);
+__attribute__ ((noreturn)) void thread_start (void);
+
+static inline
+void enqueue (run_queue* rq, thread* t)
+{
+	t->next = NULL;
+	if (rq->tail != NULL)
+		rq->tail->next = t;
+	else
+		rq->head = t;
+	rq->tail = t;
+}
+
+static inline
+thread* dequeue (run_queue* rq)
+{
+	thread* t = rq->head;
+	if (t != NULL) {
+		rq->head = t->next;
+		if (rq->head == NULL)
+			rq->tail = NULL;
+	}
+	return t;
+}
+
+static
+void finish_switch (run_queue* rq)
+{
+	thread* dead = rq->dead;
+	if (dead == NULL)
+		return;
+	rq->dead = NULL;
+	fpu_context_release (dead->fpu);
+
+	uint64_t flags = qspinlock_acquire_irqsave (&free_lock);
+	dead->next = free_threads;
+	free_threads = dead;
+	qspinlock_release_irqrestore (&free_lock, flags);
+}
+
+// Called with interrupts disabled and the run queue locked; prev's state has
+// been set, and prev queued if it is to run again. Unlocks the queue.
+static
+void schedule_locked (run_queue* rq, thread* prev)
+{
+	thread* next = dequeue (rq);
+	if (next == NULL)
+		next = &rq->idle;
+	next->state = THREAD_RUNNING;
+	rq->current = next; // Under the lock, for thread_wake's idle check
+	qspinlock_release (&rq->lock);
+	if (next == prev)
+		return;
+
+	rcu_quiescent ();
+	fpu_switch (next->fpu);
+	context_switch (&prev->sp, next->sp);
+	finish_switch (this_cpu_ptr (cpu_rq));
+}
+
+static
+thread* allocate_thread (void)
+{
+	uint64_t flags = qspinlock_acquire_irqsave (&free_lock);
+	thread* t = free_threads;
+	if (t != NULL)
+		free_threads = t->next;
+	qspinlock_release_irqrestore (&free_lock, flags);
+	if (t != NULL)
+		return t;
+
+	t = bootmem_alloc (sizeof (thread), sizeof (uint64_t));
+	void* area = bootmem_alloc (fpu_area_size (), FPU_AREA_ALIGN);
+	void* stack = vmap_alloc_guarded (STACK_SIZE);
+	if (t == NULL || area == NULL || stack == NULL)
+		return NULL;
+	t->fpu_state.area = area;
+	t->stack = stack;
+	return t;
+}
+
+static
+void wake_sleeper (void* t)
+{
+	thread_wake (t);
+}
+
+static
+void initialize_idle (void)
+{
+	run_queue* rq = this_cpu_ptr (cpu_rq);
+	rq->idle.state = THREAD_RUNNING;
+	rq->idle.cpu   = cpu_index ();
+	rq->idle.fpu   = fpu_current_context ();
+	rq->idle.sleep_timer = make_timer (&wake_sleeper, &rq->idle);
+	rq->current = &rq->idle;
+}
+
+
+// Extern functions
+
+void thread_start (void)
+{
+	run_queue* rq = this_cpu_ptr (cpu_rq);
+	finish_switch (rq);
+	thread* self = rq->current;
+	__asm__ volatile ("sti" ::: "memory");
+	self->function (self->arg);
+	thread_exit ();
+}
+
+void threads_initialize (void)
+{
+	initialize_idle ();
+}
+
+void threads_initialize_cpu (void)
+{
+	initialize_idle ();
+}
+
+thread* thread_create (thread_function function, void* arg)
+{
+	return thread_create_on (cpu_index (), function, arg);
+}
+
+thread* thread_create_on (uint32_t cpu, thread_function function, void* arg)
+{
+	thread* t = allocate_thread ();
+	if (t == NULL)
+		return NULL;
+
+	t->state        = THREAD_BLOCKED;
+	t->wake_pending = false;
+	t->cpu          = cpu;
+	t->function     = function;
+	t->arg          = arg;
+	t->sleep_timer  = make_timer (&wake_sleeper, t);
+	fpu_context_initialize (&t->fpu_state, t->fpu_state.area);
+	t->fpu = &t->fpu_state;
+
+	// The return address sits in the top word, so thread_entry starts with
+	// the stack aligned as after a call
+	uint64_t* top = (uint64_t*) ((uint8_t*) t->stack + STACK_SIZE);
+	top [-1] = (uint64_t) &thread_entry;
+	for (int i = 2; i <= SWITCH_FRAME_WORDS + 1; ++i)
+		top [-i] = 0;
+	t->sp = (uint64_t) &top [-(SWITCH_FRAME_WORDS + 1)];
+
+	thread_wake (t);
+	return t;
+}
+
+thread* thread_current (void)
+{
+	return this_cpu_read (cpu_rq.current);
+}
+
+void thread_yield (void)
+{
+	run_queue* rq = this_cpu_ptr (cpu_rq);
+	if (__atomic_load_n (&rq->head, __ATOMIC_RELAXED) == NULL)
+		return;
+
+	uint64_t flags = save_flags_cli ();
+	thread* self = rq->current;
+	qspinlock_acquire (&rq->lock);
+	if (self != &rq->idle) {
+		self->state = THREAD_RUNNABLE;
+		enqueue (rq, self);
+	}
+	schedule_locked (rq, self);
+	restore_flags (flags);
+}
+
+void thread_block (void)
+{
+	uint64_t flags = save_flags_cli ();
+	run_queue* rq = this_cpu_ptr (cpu_rq);
+	thread* self = rq->current;
+	qspinlock_acquire (&rq->lock);
+	if (self->wake_pending || self == &rq->idle) {
+		self->wake_pending = false;
+		qspinlock_release (&rq->lock);
+	}
+	else {
+		self->state = THREAD_BLOCKED;
+		schedule_locked (rq, self);
+	}
+	restore_flags (flags);
+}
+
+void thread_wake (thread* t)
+{
+	run_queue* rq = per_cpu_ptr (cpu_rq, t->cpu);
+	uint64_t flags = qspinlock_acquire_irqsave (&rq->lock);
+	bool kick = false;
+	if (t->state == THREAD_BLOCKED) {
+		t->state = THREAD_RUNNABLE;
+		enqueue (rq, t);
+		kick = (rq->current == &rq->idle);
+	}
+	else if (t->state != THREAD_DEAD)
+		t->wake_pending = true;
+	qspinlock_release_irqrestore (&rq->lock, flags);
+
+	if (kick)
+		idle_wake (t->cpu);
+}
+
+void thread_sleep (uint64_t duration_ns)
+{
+	thread* self = thread_current ();
+	uint64_t deadline = clock_now_ns () + duration_ns;
+	while (clock_now_ns () < deadline) {
+		timer_arm (&self->sleep_timer, deadline);
+		thread_block ();
+	}
+	timer_cancel (&self->sleep_timer);
+}
+
+void thread_exit (void)
+{
+	save_flags_cli ();
+	run_queue* rq = this_cpu_ptr (cpu_rq);
+	thread* self = rq->current;
+	qspinlock_acquire (&rq->lock);
+	self->state = THREAD_DEAD;
+	rq->dead = self;
+	schedule_locked (rq, self);
+	__builtin_unreachable ();
+}
@@ -0,0 +1,67 @@
+#ifndef THREAD_H
+#define THREAD_H
+
+#include "time/timer.h"
+#include "x86/fpu.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef void (*thread_function) (void* arg);
+
+typedef enum {
+	THREAD_RUNNING,
+	THREAD_RUNNABLE,
+	THREAD_BLOCKED,
+	THREAD_DEAD
+} thread_state;
+
+typedef struct thread {
+	uint64_t        sp; // Saved stack pointer while switched out
+	struct thread*  next;
+	thread_state    state;
+	bool            wake_pending; // thread_wake came while not blocked
+	uint32_t        cpu;
+	thread_function function;
+	void*           arg;
+	fpu_context*    fpu;
+	fpu_context     fpu_state;
+	void*           stack;
+	timer           sleep_timer;
+} thread;
+
+/* Threads are cooperative and stay on the CPU they were created on. Each CPU
+ * has a FIFO run queue; when it is empty, the CPU's idle thread (the context
+ * that called threads_initialize) runs idle_loop. A switch saves only the
+ * callee-saved registers and the stack pointer; FPU state moves through
+ * fpu_switch, which leaves it alone for threads that never used it. Stacks
+ * have an unmapped guard page below them.
+ */
+
+// Turns the calling context into the idle thread of CPU 0. Requires
+// bootmem_initialize, fpu_initialize, cpu_initialize and timers_initialize.
+void threads_initialize (void);
+
+// The same for an application processor
+void threads_initialize_cpu (void);
+
+// New threads start runnable with interrupts enabled. Returns NULL if no
+// memory is left for a stack.
+thread* thread_create (thread_function function, void* arg);
+thread* thread_create_on (uint32_t cpu, thread_function function, void* arg);
+
+thread* thread_current (void);
+
+// Runs the next runnable thread, if any, and requeues the caller
+void thread_yield (void);
+
+// Waits for thread_wake. A wake that arrives first is remembered, so a
+// thread checking a condition and then blocking does not miss it; callers
+// recheck their condition after returning. The idle thread cannot block.
+void thread_block (void);
+void thread_wake (thread* t);
+
+void thread_sleep (uint64_t duration_ns);
+
+__attribute__ ((noreturn)) void thread_exit (void);
+
+#endif
@@ -0,0 +1,116 @@
+#include "waitqueue.h"
+#include "time/clock.h"
+#include "time/timer.h"
+#include <stddef.h>
+
+static
+void unlink (wait_queue* wq, waiter* w)
+{
+	*w->pprev = w->next;
+	if (w->next != NULL)
+		w->next->pprev = w->pprev;
+	else
+		wq->tail = w->pprev;
+	w->next  = NULL;
+	w->pprev = NULL;
+}
+
+// Removes the waiter if nobody has woken it yet
+static
+bool finish (wait_queue* wq, waiter* w)
+{
+	uint64_t flags = qspinlock_acquire_irqsave (&wq->lock);
+	if (w->pprev != NULL)
+		unlink (wq, w);
+	qspinlock_release_irqrestore (&wq->lock, flags);
+	return __atomic_load_n (&w->woken, __ATOMIC_ACQUIRE);
+}
+
+
+// Extern functions
+
+void wait_queue_initialize (wait_queue* wq)
+{
+	wq->lock = make_qspinlock ();
+	wq->head = NULL;
+	wq->tail = &wq->head;
+}
+
+void wait_queue_add_locked (wait_queue* wq, waiter* w)
+{
+	w->next   = NULL;
+	w->pprev  = wq->tail;
+	w->thread = thread_current ();
+	w->woken  = false;
+	*wq->tail = w;
+	wq->tail  = &w->next;
+}
+
+waiter* wait_queue_pop_locked (wait_queue* wq)
+{
+	waiter* w = wq->head;
+	if (w != NULL)
+		unlink (wq, w);
+	return w;
+}
+
+void waiter_wake (waiter* w)
+{
+	// The waiter's frame may be gone as soon as woken is set
+	thread* t = w->thread;
+	__atomic_store_n (&w->woken, true, __ATOMIC_RELEASE);
+	thread_wake (t);
+}
+
+void wait_queue_prepare (wait_queue* wq, waiter* w)
+{
+	uint64_t flags = qspinlock_acquire_irqsave (&wq->lock);
+	wait_queue_add_locked (wq, w);
+	qspinlock_release_irqrestore (&wq->lock, flags);
+}
+
+bool wait_queue_sleep (wait_queue* wq, waiter* w, uint64_t deadline_ns)
+{
+	timer* timeout = &w->thread->sleep_timer;
+	if (deadline_ns != WAIT_FOREVER)
+		timer_arm (timeout, deadline_ns);
+
+	// thread_block also returns for the timeout and for stray wakes
+	while (!__atomic_load_n (&w->woken, __ATOMIC_ACQUIRE)) {
+		if (deadline_ns != WAIT_FOREVER && clock_now_ns () >= deadline_ns)
+			break;
+		thread_block ();
+	}
+
+	if (deadline_ns != WAIT_FOREVER)
+		timer_cancel (timeout);
+	return finish (wq, w);
+}
+
+bool wait_queue_cancel (wait_queue* wq, waiter* w)
+{
+	return finish (wq, w);
+}
+
+uint32_t wait_queue_wake_one (wait_queue* wq)
+{
+	uint64_t flags = qspinlock_acquire_irqsave (&wq->lock);
+	waiter* w = wait_queue_pop_locked (wq);
+	if (w != NULL)
+		waiter_wake (w);
+	qspinlock_release_irqrestore (&wq->lock, flags);
+	return w != NULL;
+}
+
+uint32_t wait_queue_wake_all (wait_queue* wq)
+{
+	uint32_t woken = 0;
+	uint64_t flags = qspinlock_acquire_irqsave (&wq->lock);
+	waiter* w;
+	while ((w = wait_queue_pop_locked (wq)) != NULL) {
+		waiter_wake (w);
+		++woken;
+	}
+	qspinlock_release_irqrestore (&wq->lock, flags);
+	return woken;
+}
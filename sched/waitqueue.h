@@ -0,0 +1,72 @@
+#ifndef WAITQUEUE_H
+#define WAITQUEUE_H
+
+#include "thread.h"
+#include "sync/qspinlock.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Threads waiting for a condition queue up in FIFO order on a wait_queue.
+ * Waking one waiter takes it off the queue and marks it woken before the
+ * thread runs, so a wakeup is handed to exactly one thread and is never lost
+ * in the window between a waiter's check and its sleep:
+ *
+ *	waiter w;
+ *	wait_queue_prepare (wq, &w);
+ *	if (!condition)
+ *		wait_queue_sleep (wq, &w, deadline_ns);
+ *	else
+ *		wait_queue_cancel (wq, &w);
+ *
+ * Waiters live on the waiting thread's stack. Only threads other than the
+ * idle thread can sleep; wakeups may come from anywhere, including interrupt
+ * handlers and other CPUs.
+ */
+
+enum {
+	WAIT_FOREVER = UINT64_MAX
+};
+
+typedef struct waiter {
+	struct waiter*  next;
+	struct waiter** pprev; // NULL once off the queue
+	thread*         thread;
+	bool            woken;
+} waiter;
+
+typedef struct wait_queue {
+	qspinlock lock;
+	waiter*   head;
+	waiter**  tail;
+} wait_queue;
+
+void wait_queue_initialize (wait_queue* wq);
+
+static inline
+bool wait_queue_empty (const wait_queue* wq)
+{
+	return __atomic_load_n (&wq->head, __ATOMIC_RELAXED) == 0;
+}
+
+// Queues the calling thread
+void wait_queue_prepare (wait_queue* wq, waiter* w);
+
+// Sleeps until woken or until the clock reaches deadline_ns, then leaves the
+// queue. Returns true if woken.
+bool wait_queue_sleep (wait_queue* wq, waiter* w, uint64_t deadline_ns);
+
+// Leaves the queue without sleeping. Returns true if a wakeup had already
+// been handed to this waiter, which the caller then owns.
+bool wait_queue_cancel (wait_queue* wq, waiter* w);
+
+// Wake the first waiter, or all of them. Return the number woken.
+uint32_t wait_queue_wake_one (wait_queue* wq);
+uint32_t wait_queue_wake_all (wait_queue* wq);
+
+// For primitives built on the queue that must update their own state under
+// the queue's lock: the caller holds wq->lock with interrupts disabled.
+void    wait_queue_add_locked (wait_queue* wq, waiter* w);
+waiter* wait_queue_pop_locked (wait_queue* wq);
+void    waiter_wake (waiter* w);
+
+#endif
@@ -0,0 +1,239 @@
+#include "serial.h"
+#include "x86/control.h"
+#include "x86/portio.h"
+#include "x86/interrupts/ISR.h"
+
+enum {
+	// Register offsets; DLL and DLM replace DATA and IER while LCR_DLAB is set
+	UART_DATA = 0,
+	UART_IER  = 1,
+	UART_IIR  = 2, // Read
+	UART_FCR  = 2, // Write
+	UART_LCR  = 3,
+	UART_MCR  = 4,
+	UART_LSR  = 5,
+	UART_MSR  = 6,
+	UART_SCR  = 7,
+	UART_DLL  = 0,
+	UART_DLM  = 1,
+
+	IER_RX_DATA     = 0x01,
+	IER_THR_EMPTY   = 0x02,
+	IER_LINE_STATUS = 0x04,
+
+	IIR_NONE        = 0x01,
+	IIR_ID_MASK     = 0x0E,
+	IIR_MODEM       = 0x00,
+	IIR_THR_EMPTY   = 0x02,
+	IIR_RX_DATA     = 0x04,
+	IIR_LINE_STATUS = 0x06,
+	IIR_RX_TIMEOUT  = 0x0C,
+	IIR_FIFO_MASK   = 0xC0, // Both set on a 16550A with working FIFOs
+
+	FCR_ENABLE     = 0x01,
+	FCR_CLEAR_RX   = 0x02,
+	FCR_CLEAR_TX   = 0x04,
+	FCR_TRIGGER_14 = 0xC0,
+
+	LCR_8N1  = 0x03,
+	LCR_DLAB = 0x80,
+
+	MCR_DTR      = 0x01,
+	MCR_RTS      = 0x02,
+	MCR_OUT2     = 0x08, // Gates the IRQ line on PCs
+	MCR_LOOPBACK = 0x10,
+
+	LSR_DATA_READY = 0x01,
+	LSR_OVERRUN    = 0x02,
+	LSR_THR_EMPTY  = 0x20,
+
+	UART_FIFO_SIZE = 16,
+	PROBE_BYTE     = 0xAE,
+
+	READ_CHUNK = 16 // Bytes serial_read takes from the ring per dequeue
+};
+
+typedef struct serial_config {
+	uint16_t  io_base;
+	IRQ       irq;
+	INT_index interrupt;
+} serial_config;
+
+static const serial_config configs [] = {
+	[SERIAL_COM1] = {0x3F8, IRQ_COM1, INT_COM1},
+	[SERIAL_COM2] = {0x2F8, IRQ_COM2, INT_COM2}
+};
+
+static serial_port ports [2];
+
+static inline
+uint8_t read_reg (const serial_port* port, uint16_t reg)
+{
+	return inb (port->io_base + reg);
+}
+
+static inline
+void write_reg (const serial_port* port, uint16_t reg, uint8_t value)
+{
+	outb (port->io_base + reg, value);
+}
+
+static inline
+uint32_t tx_pending (const serial_port* port)
+{
+	return port->tx_tail - port->tx_head;
+}
+
+static
+bool probe (serial_port* port)
+{
+	write_reg (port, UART_SCR, PROBE_BYTE);
+	if (read_reg (port, UART_SCR) != PROBE_BYTE)
+		return false;
+	write_reg (port, UART_MCR, MCR_LOOPBACK | MCR_RTS | MCR_DTR);
+	write_reg (port, UART_DATA, PROBE_BYTE);
+	for (uint32_t i = 0; i < 1000 && !(read_reg (port, UART_LSR) & LSR_DATA_READY); ++i)
+		cpu_relax ();
+	return read_reg (port, UART_DATA) == PROBE_BYTE;
+}
+
+// Called with the lock held and the transmitter empty
+static
+void fill_fifo (serial_port* port)
+{
+	uint32_t count = tx_pending (port);
+	if (count > port->fifo_size)
+		count = port->fifo_size;
+	for (uint32_t i = 0; i < count; ++i)
+		write_reg (port, UART_DATA, port->tx [port->tx_head++ % SERIAL_TX_SIZE]);
+	port->tx_busy = (count != 0);
+}
+
+// Called with the lock held
+static
+void poll_fifo (serial_port* port)
+{
+	while (!(read_reg (port, UART_LSR) & LSR_THR_EMPTY))
+		cpu_relax ();
+	fill_fifo (port);
+}
+
+static
+void receive (serial_port* port)
+{
+	uint8_t status;
+	while ((status = read_reg (port, UART_LSR)) & LSR_DATA_READY) {
+		uint8_t byte = read_reg (port, UART_DATA);
+		uint64_t value = byte;
+		if (status & LSR_OVERRUN)
+			++port->rx_dropped;
+		if (spsc_ring_enqueue (&port->rx, &value, 1) == 0)
+			++port->rx_dropped;
+	}
+}
+
+static
+void serial_ISR (INT_index interrupt, __attribute__ ((unused)) uint64_t error)
+{
+	serial_port* port = &ports [(interrupt == INT_COM1) ? SERIAL_COM1 : SERIAL_COM2];
+	qspinlock_acquire (&port->lock);
+	uint8_t iir;
+	while (!((iir = read_reg (port, UART_IIR)) & IIR_NONE)) {
+		switch (iir & IIR_ID_MASK) {
+		case IIR_THR_EMPTY:
+			fill_fifo (port);
+			break;
+		case IIR_RX_DATA:
+		case IIR_RX_TIMEOUT:
+			receive (port);
+			break;
+		case IIR_LINE_STATUS:
+			if (read_reg (port, UART_LSR) & LSR_OVERRUN)
+				++port->rx_dropped;
+			break;
+		default:
+			read_reg (port, UART_MSR);
+			break;
+		}
+	}
+	qspinlock_release (&port->lock);
+}
+
+
+// Extern functions
+
+serial_port* serial_initialize (serial_com com, uint32_t baud)
+{
+	const serial_config* config = &configs [com];
+	serial_port* port = &ports [com];
+	port->io_base = config->io_base;
+	port->irq     = config->irq;
+	port->lock    = make_qspinlock ();
+	spsc_ring_initialize (&port->rx, port->rx_slots, SERIAL_RX_SIZE);
+	if (baud == 0 || baud > SERIAL_BAUD_MAX || !probe (port))
+		return NULL;
+
+	uint16_t divisor = SERIAL_BAUD_MAX / baud;
+	write_reg (port, UART_IER, 0);
+	write_reg (port, UART_LCR, LCR_DLAB);
+	write_reg (port, UART_DLL, divisor & 0xFF);
+	write_reg (port, UART_DLM, divisor >> 8);
+	write_reg (port, UART_LCR, LCR_8N1);
+	write_reg (port, UART_FCR, FCR_ENABLE | FCR_CLEAR_RX | FCR_CLEAR_TX | FCR_TRIGGER_14);
+	bool fifo = (read_reg (port, UART_IIR) & IIR_FIFO_MASK) == IIR_FIFO_MASK;
+	port->fifo_size = fifo ? UART_FIFO_SIZE : 1;
+	write_reg (port, UART_MCR, MCR_OUT2 | MCR_RTS | MCR_DTR);
+
+	set_ISR (config->interrupt, &serial_ISR);
+	write_reg (port, UART_IER, IER_RX_DATA | IER_THR_EMPTY | IER_LINE_STATUS);
+	IRQ_enable (port->irq);
+	return port;
+}
+
+void serial_write (serial_port* port, const char* data, size_t length)
+{
+	uint64_t flags = qspinlock_acquire_irqsave (&port->lock);
+	for (size_t i = 0; i < length; ++i) {
+		if (tx_pending (port) == SERIAL_TX_SIZE)
+			poll_fifo (port);
+		port->tx [port->tx_tail++ % SERIAL_TX_SIZE] = data [i];
+	}
+	// Without a THR-empty interrupt on its way, nothing would send the bytes
+	if (!port->tx_busy && (read_reg (port, UART_LSR) & LSR_THR_EMPTY))
+		fill_fifo (port);
+	qspinlock_release_irqrestore (&port->lock, flags);
+}
+
+size_t serial_read (serial_port* port, char* buffer, size_t max)
+{
+	uint64_t bytes [READ_CHUNK];
+	size_t count = 0;
+	while (count < max) {
+		uint32_t wanted = (max - count < READ_CHUNK) ? max - count : READ_CHUNK;
+		uint32_t taken = spsc_ring_dequeue (&port->rx, bytes, wanted);
+		for (uint32_t i = 0; i < taken; ++i)
+			buffer [count + i] = bytes [i];
+		count += taken;
+		if (taken < wanted)
+			break;
+	}
+	return count;
+}
+
+void serial_flush (serial_port* port)
+{
+	uint64_t flags = qspinlock_acquire_irqsave (&port->lock);
+	while (tx_pending (port) != 0)
+		poll_fifo (port);
+	qspinlock_release_irqrestore (&port->lock, flags);
+}
+
+void serial_write_polled (serial_port* port, const char* data, size_t length)
+{
+	for (size_t i = 0; i < length; i += port->fifo_size) {
+		while (!(read_reg (port, UART_LSR) & LSR_THR_EMPTY))
+			cpu_relax ();
+		for (size_t j = i; j < length && j < i + port->fifo_size; ++j)
+			write_reg (port, UART_DATA, data [j]);
+	}
+}
@@ -0,0 +1,66 @@
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include "sync/qspinlock.h"
+#include "sync/ring.h"
+#include "x86/interrupts/IRQ.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Interrupt-driven 16550 UART on COM1 or COM2, 8N1. Output goes into a
+ * software ring; the transmitter is refilled a whole FIFO (16 bytes) at a
+ * time from the THR-empty interrupt rather than polled per byte. Received
+ * bytes are moved by the receive interrupt into an spsc_ring, which
+ * serial_read empties without taking the lock. On a 16450, which has no FIFO,
+ * the same code moves one byte per interrupt.
+ *
+ * The polled functions bypass the rings and the lock, for panics.
+ */
+
+enum {
+	SERIAL_TX_SIZE = 4096,
+	SERIAL_RX_SIZE = 256,
+
+	SERIAL_BAUD_MAX = 115200 // Divisor 1 with the standard 1.8432 MHz clock
+};
+
+typedef enum {
+	SERIAL_COM1,
+	SERIAL_COM2
+} serial_com;
+
+typedef struct serial_port {
+	uint16_t  io_base;
+	IRQ       irq;
+	uint32_t  fifo_size;  // Bytes the transmitter takes per THR-empty
+	bool      tx_busy;    // A THR-empty interrupt is on its way
+	qspinlock lock;       // Guards the transmit ring and the UART registers
+	uint32_t  tx_head;
+	uint32_t  tx_tail;
+	uint64_t  rx_dropped; // Ring full, or overrun in the UART
+	uint8_t   tx [SERIAL_TX_SIZE];
+	spsc_ring rx;         // Filled by the interrupt handler only
+	uint64_t  rx_slots [SERIAL_RX_SIZE];
+} serial_port;
+
+// Probes and programs the UART, then enables its IRQ. baud must divide
+// SERIAL_BAUD_MAX. Returns NULL if there is no UART at the port.
+serial_port* serial_initialize (serial_com com, uint32_t baud);
+
+// Queues the bytes. When the ring is full, the caller transmits from it by
+// polling until there is room, so nothing is lost even with interrupts
+// disabled.
+void serial_write (serial_port* port, const char* data, size_t length);
+
+// Takes up to max received bytes. Returns the count. Only one caller may
+// read a port at a time.
+size_t serial_read (serial_port* port, char* buffer, size_t max);
+
+// Transmits everything queued by polling
+void serial_flush (serial_port* port);
+
+// For panics: transmits by polling, without taking the lock
+void serial_write_polled (serial_port* port, const char* data, size_t length);
+
+#endif
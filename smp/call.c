@@ -0,0 +1,161 @@
+#include "call.h"
+#include "cpu.h"
+#include "smp.h"
+#include "x86/control.h"
+#include "x86/interrupts/ISR.h"
+#include "x86/interrupts/LAPIC.h"
+#include <stddef.h>
+
+/* Senders push onto the target's queue with a compare-and-swap; the target
+ * takes the whole queue with one exchange and runs it oldest first. A push
+ * that finds the queue empty is the one that sends the IPI; any push before
+ * the target's exchange rides on that interrupt.
+ *
+ * Each CPU sends from its own fixed pool of entries, so calls need no
+ * allocation. An entry is busy from the push until the target has read it; a
+ * sender that finds the whole pool busy waits for its targets to catch up.
+ */
+
+enum {
+	CALL_ENTRIES = 64
+};
+
+typedef struct call_entry {
+	struct call_entry* next;
+	smp_function       function;
+	void*              arg;
+	uint32_t*          pending; // Counts down as targets finish, when waiting
+	uint32_t           busy;
+} call_entry;
+
+typedef struct call_queue {
+	call_entry* head;
+} call_queue;
+
+typedef struct call_pool {
+	call_entry entries [CALL_ENTRIES];
+	uint32_t   cursor; // Where to start looking for a free entry
+} call_pool;
+
+static DEFINE_PER_CPU (call_queue, cpu_queue);
+static DEFINE_PER_CPU (call_pool, cpu_pool);
+static DEFINE_PER_CPU (smp_call_stats, cpu_stats);
+
+// Returns true if the queue was empty
+static
+bool push (call_queue* queue, call_entry* entry)
+{
+	call_entry* head = __atomic_load_n (&queue->head, __ATOMIC_RELAXED);
+	do
+		entry->next = head;
+	while (!__atomic_compare_exchange_n (&queue->head, &head, entry, true,
+	                                     __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+	return head == NULL;
+}
+
+static
+call_entry* take_entry (call_pool* pool)
+{
+	for (;;) {
+		for (uint32_t i = 0; i < CALL_ENTRIES; ++i) {
+			call_entry* entry = &pool->entries [(pool->cursor + i) % CALL_ENTRIES];
+			if (!__atomic_load_n (&entry->busy, __ATOMIC_ACQUIRE)) {
+				pool->cursor = (pool->cursor + i + 1) % CALL_ENTRIES;
+				entry->busy = 1;
+				return entry;
+			}
+		}
+		cpu_relax ();
+	}
+}
+
+static
+void run_entry (call_entry* entry)
+{
+	smp_function function = entry->function;
+	void* arg = entry->arg;
+	uint32_t* pending = entry->pending;
+	__atomic_store_n (&entry->busy, 0, __ATOMIC_RELEASE);
+
+	function (arg);
+	if (pending != NULL)
+		__atomic_sub_fetch (pending, 1, __ATOMIC_RELEASE);
+}
+
+static
+void call_ISR (__attribute__ ((unused)) INT_index interrupt,
+               __attribute__ ((unused)) uint64_t error)
+{
+	call_entry* list = __atomic_exchange_n (&this_cpu_ptr (cpu_queue)->head, NULL, __ATOMIC_ACQUIRE);
+
+	// Pushed newest first; reverse to run in order of arrival
+	call_entry* ordered = NULL;
+	while (list != NULL) {
+		call_entry* next = list->next;
+		list->next = ordered;
+		ordered = list;
+		list = next;
+	}
+
+	while (ordered != NULL) {
+		call_entry* next = ordered->next;
+		run_entry (ordered);
+		ordered = next;
+	}
+}
+
+
+// Extern functions
+
+void smp_call_initialize (void)
+{
+	set_ISR (INT_IPI_call, &call_ISR);
+}
+
+void smp_call_function (cpu_mask mask, smp_function fn, void* arg, bool wait)
+{
+	uint32_t pending = 0;
+	uint64_t flags = save_flags_cli ();
+	uint32_t self = cpu_index ();
+	call_pool* pool = this_cpu_ptr (cpu_pool);
+	smp_call_stats* stats = this_cpu_ptr (cpu_stats);
+
+	for (uint32_t cpu = 0; cpu < cpu_count (); ++cpu) {
+		if (!(mask & ((cpu_mask) 1 << cpu)) || cpu == self || !smp_cpu_online (cpu))
+			continue;
+
+		call_entry* entry = take_entry (pool);
+		entry->function = fn;
+		entry->arg      = arg;
+		entry->pending  = wait ? &pending : NULL;
+		if (wait)
+			__atomic_add_fetch (&pending, 1, __ATOMIC_RELAXED);
+
+		++stats->calls;
+		if (push (per_cpu_ptr (cpu_queue, cpu), entry)) {
+			++stats->ipis;
+			LAPIC_send_IPI (cpu_apic_id (cpu), INT_IPI_call);
+		}
+		else
+			++stats->coalesced;
+	}
+
+	if (mask & ((cpu_mask) 1 << self))
+		fn (arg);
+	restore_flags (flags);
+
+	while (__atomic_load_n (&pending, __ATOMIC_ACQUIRE) != 0)
+		cpu_relax ();
+}
+
+smp_call_stats smp_call_statistics (void)
+{
+	smp_call_stats total = {0, 0, 0};
+	for (uint32_t cpu = 0; cpu < cpu_count (); ++cpu) {
+		const smp_call_stats* stats = per_cpu_ptr (cpu_stats, cpu);
+		total.calls     += stats->calls;
+		total.ipis      += stats->ipis;
+		total.coalesced += stats->coalesced;
+	}
+	return total;
+}
@@ -0,0 +1,30 @@
+#ifndef CALL_H
+#define CALL_H
+
+#include "cpu.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef void (*smp_function) (void* arg);
+
+typedef struct smp_call_stats {
+	uint64_t calls;     // Calls queued for other CPUs
+	uint64_t ipis;      // IPIs sent
+	uint64_t coalesced; // Calls that found their target's queue non-empty
+} smp_call_stats;
+
+// Installs the call IPI handler. Called by smp_initialize.
+void smp_call_initialize (void);
+
+// Runs fn (arg) on every online CPU in the mask, in interrupt context on other
+// CPUs and with interrupts disabled on the calling one. Each CPU has a
+// lock-free queue of calls; an IPI is only sent when a call finds its target's
+// queue empty, so a burst of calls to one CPU shares a single interrupt. With
+// wait, returns only after every CPU has finished fn. Must not be called with
+// interrupts disabled while another CPU may be waiting on the caller.
+void smp_call_function (cpu_mask mask, smp_function fn, void* arg, bool wait);
+
+// Totals over all CPUs
+smp_call_stats smp_call_statistics (void);
+
+#endif
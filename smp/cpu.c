@@ -0,0 +1,90 @@
+#include "cpu.h"
+#include "memory/bootmem.h"
+#include "x86/GDT.h"
+#include "x86/interrupts/LAPIC.h"
+
+enum {
+	DOUBLE_FAULT_STACK_SIZE = 8192
+};
+
+typedef struct cpu_tables {
+	GDT    gdt;
+	TSS_64 tss;
+} cpu_tables;
+
+// Unregistered APIC IDs, including the bootstrap processor's, map to 0
+static uint8_t  index_of_apic [256];
+static uint8_t  apic_of_index [MAX_CPUS];
+static uint32_t secondary_count;
+
+DEFINE_PER_CPU (uint32_t, cpu_number);
+static DEFINE_PER_CPU (cpu_tables, tables);
+
+// Gives the calling CPU its own GDT and TSS. The segment descriptors are
+// copied from the GDT in use. Double faults switch to a stack of their own, so
+// a thread that runs into its guard page gets a report instead of a triple
+// fault when the page fault cannot push its frame.
+static
+void load_descriptor_tables (void)
+{
+	cpu_tables* own = this_cpu_ptr (tables);
+	descriptor_register gdtr;
+	__asm__ volatile ("sgdt %0" : "=m" (gdtr));
+	const GDT* current = (const GDT*) gdtr.base;
+	for (uint32_t i = 0; i < TSS_SELECTOR; ++i)
+		own->gdt.GDTEs [i] = current->GDTEs [i];
+
+	uint8_t* stack = bootmem_alloc (DOUBLE_FAULT_STACK_SIZE, 16);
+	if (stack != NULL)
+		own->tss.ist [IST_DOUBLE_FAULT - 1] = (uint64_t) (stack + DOUBLE_FAULT_STACK_SIZE);
+	own->tss.iomap_base = sizeof (TSS_64); // No I/O permission bitmap
+	own->gdt.TSSD = make_TSSD (&own->tss, 0);
+
+	gdtr = (descriptor_register) {.limit = sizeof (GDT) - 1, .base = (uint64_t) &own->gdt};
+	__asm__ volatile ("lgdt %0" :: "m" (gdtr));
+	install_TSS (TSS_SELECTOR);
+}
+
+
+// Extern functions
+
+void cpu_initialize (void)
+{
+	percpu_initialize_cpu (0);
+	load_descriptor_tables ();
+	LAPIC_initialize ();
+	if (LAPIC_present ())
+		apic_of_index [0] = LAPIC_id ();
+}
+
+uint32_t cpu_initialize_ap (void)
+{
+	LAPIC_initialize ();
+	uint32_t index = index_of_apic [LAPIC_id ()];
+	if (index == 0)
+		return UINT32_MAX;
+	percpu_initialize_cpu (index);
+	load_descriptor_tables ();
+	this_cpu_write (cpu_number, index);
+	return index;
+}
+
+uint32_t cpu_count (void)
+{
+	return secondary_count + 1;
+}
+
+uint8_t cpu_apic_id (uint32_t index)
+{
+	return apic_of_index [index];
+}
+
+uint32_t cpu_register (uint8_t apic_id)
+{
+	if (cpu_count () == MAX_CPUS)
+		return UINT32_MAX;
+	uint32_t index = ++secondary_count;
+	index_of_apic [apic_id] = index;
+	apic_of_index [index] = apic_id;
+	return index;
+}
@@ -0,0 +1,41 @@
+#ifndef CPU_H
+#define CPU_H
+
+#include "percpu.h"
+#include <stdint.h>
+
+enum {
+	MAX_CPUS = 64
+};
+
+// Bit n selects CPU n
+typedef uint64_t cpu_mask;
+
+DECLARE_PER_CPU (uint32_t, cpu_number);
+
+// Enables the local APIC of the bootstrap processor and registers it as CPU 0.
+// Also moves it to a GDT and TSS of its own, with the double-fault stack that
+// IDT_initialize points #DF at. Requires bootmem_initialize.
+void cpu_initialize (void);
+
+// Run first on an application processor: enables its local APIC, sets up its
+// per-CPU area and loads its own GDT and TSS. Returns its index, or UINT32_MAX
+// if it was not registered.
+uint32_t cpu_initialize_ap (void);
+
+// Dense index of the calling CPU, from 0 to cpu_count () - 1. The bootstrap
+// processor is always CPU 0.
+static inline
+uint32_t cpu_index (void)
+{
+	return this_cpu_read (cpu_number);
+}
+
+uint32_t cpu_count (void);
+uint8_t cpu_apic_id (uint32_t index);
+
+// Assigns the next index to a CPU about to be started. Returns UINT32_MAX when
+// MAX_CPUS are already registered.
+uint32_t cpu_register (uint8_t apic_id);
+
+#endif
@@ -0,0 +1,27 @@
+#include "percpu.h"
+#include "cpu.h"
+#include "x86/msr.h"
+
+DEFINE_PER_CPU (uintptr_t, percpu_self_offset);
+
+// Exports MAX_CPUS - 1 as the absolute symbol kernel.ld multiplies the per-CPU
+// area by, so the two cannot disagree. Never called; only assembled.
+__attribute__ ((used))
+static
+void export_percpu_copies (void)
+{
+	__asm__ (".globl _kpercpu_copies\n\t.set _kpercpu_copies, %c0" :: "i" (MAX_CPUS - 1));
+}
+
+
+// Extern functions
+
+// Nothing runs outside ring 0, so no entry path executes swapgs; both MSRs
+// hold the same base and a future one would be harmless.
+void percpu_initialize_cpu (uint32_t cpu)
+{
+	uintptr_t offset = cpu * percpu_stride ();
+	wrmsr (MSR_IA32_GS_BASE, offset);
+	wrmsr (MSR_IA32_KERNEL_GS_BASE, offset);
+	this_cpu_write (percpu_self_offset, offset);
+}
@@ -0,0 +1,54 @@
+#ifndef PERCPU_H
+#define PERCPU_H
+
+#include "kernel.h"
+#include <stdint.h>
+
+/* Per-CPU variables live in .bss.percpu, which kernel.ld lays out as CPU 0's
+ * area followed by MAX_CPUS - 1 copies of it, percpu_stride () bytes apart.
+ * Each CPU's GS base holds the distance from CPU 0's area to its own, so a
+ * GS-relative access to a variable's link address reaches the calling CPU's
+ * copy in a single instruction. Per-CPU variables start out zeroed.
+ *
+ * GS base is 0 until percpu_initialize_cpu runs, so early code on the
+ * bootstrap processor already sees CPU 0's area.
+ */
+
+#define DEFINE_PER_CPU(type, name) \
+	__attribute__ ((section (".bss.percpu"))) type name
+#define DECLARE_PER_CPU(type, name) \
+	extern __attribute__ ((section (".bss.percpu"))) type name
+
+#define this_cpu_gs(var) \
+	((__seg_gs __typeof__ (var)*) (uintptr_t) &(var))
+#define this_cpu_read(var) \
+	(*this_cpu_gs (var))
+#define this_cpu_write(var, value) \
+	(*this_cpu_gs (var) = (value))
+#define this_cpu_add(var, value) \
+	(*this_cpu_gs (var) += (value))
+
+#define per_cpu_ptr(var, cpu) \
+	((__typeof__ (var)*) ((uintptr_t) &(var) + (uintptr_t) (cpu) * percpu_stride ()))
+#define this_cpu_ptr(var) \
+	((__typeof__ (var)*) ((uintptr_t) &(var) + percpu_offset ()))
+
+DECLARE_PER_CPU (uintptr_t, percpu_self_offset);
+
+static inline
+uintptr_t percpu_stride (void)
+{
+	return _linkaddr (_kpercpu_end) - _linkaddr (_kpercpu_start);
+}
+
+static inline
+uintptr_t percpu_offset (void)
+{
+	return this_cpu_read (percpu_self_offset);
+}
+
+// Points GS base (and the swapgs shadow in KERNEL_GS_BASE) at the given CPU's
+// area. Must run on that CPU before anything uses its per-CPU variables.
+void percpu_initialize_cpu (uint32_t cpu);
+
+#endif
@@ -0,0 +1,201 @@
+#include "smp.h"
+#include "cpu.h"
+#include "call.h"
+#include "acpi/acpi.h"
+#include "memory/bootmem.h"
+#include "sched/idle.h"
+#include "sched/thread.h"
+#include "time/clock.h"
+#include "time/clockevent.h"
+#include "x86/control.h"
+#include "x86/fpu.h"
+#include "x86/interrupts/LAPIC.h"
+#include <stddef.h>
+
+/* Processors are started in parallel: one INIT IPI to each, a single 10 ms
+ * wait for all of them, then the startup IPIs. A second startup IPI goes only
+ * to processors that have not already come online, as required by processors
+ * that drop the first one. Every AP runs the same trampoline at once, picking
+ * its stack out of a table indexed by APIC ID.
+ */
+
+enum {
+	TRAMPOLINE_BASE = 0x8000, // Must match smp/trampoline.s
+	AP_STACK_SIZE   = 16384,
+	APIC_IDS        = 256,
+
+	INIT_DELAY_NS     = 10000000,
+	SIPI_DELAY_NS     = 200000,
+	ONLINE_TIMEOUT_NS = 100000000
+};
+
+typedef struct __attribute__ ((packed)) trampoline_data {
+	uint16_t  gdt_limit;
+	uint32_t  gdt_base;
+	uint16_t  padding;
+	uint64_t  cr3;
+	uint64_t* stacks;
+	void (*entry) (uint32_t apic_id);
+} trampoline_data;
+_Static_assert (sizeof (trampoline_data) == 32, "trampoline_data does not match smp/trampoline.s");
+
+typedef struct __attribute__ ((packed)) descriptor_register {
+	uint16_t limit;
+	uint64_t base;
+} descriptor_register;
+
+extern const uint8_t ap_trampoline_start [];
+extern const uint8_t ap_trampoline_data [];
+extern const uint8_t ap_trampoline_end [];
+
+static descriptor_register idtr;
+static void*               fpu_areas [MAX_CPUS];
+static uint8_t             online [MAX_CPUS];
+static uint32_t            online_count;
+static uint64_t            boot_time_ns;
+
+static
+void delay_ns (uint64_t ns)
+{
+	uint64_t start = clock_now_ns ();
+	while (clock_now_ns () - start < ns)
+		cpu_relax ();
+}
+
+static
+bool wait_online (uint32_t expected, uint64_t timeout_ns)
+{
+	uint64_t start = clock_now_ns ();
+	while (__atomic_load_n (&online_count, __ATOMIC_ACQUIRE) < expected)
+		if (clock_now_ns () - start >= timeout_ns)
+			return false;
+		else
+			cpu_relax ();
+	return true;
+}
+
+static
+void ap_main (uint32_t apic_id)
+{
+	__asm__ volatile ("lidt %0" :: "m" (idtr));
+	uint32_t cpu = cpu_initialize_ap ();
+	if (cpu == UINT32_MAX || cpu_apic_id (cpu) != apic_id)
+		return; // Not one of ours; halt in the trampoline
+
+	fpu_initialize_cpu (fpu_areas [cpu]);
+	clockevent_initialize_cpu ();
+	threads_initialize_cpu ();
+
+	__atomic_store_n (&online [cpu], 1, __ATOMIC_RELEASE);
+	__atomic_add_fetch (&online_count, 1, __ATOMIC_RELEASE);
+	idle_loop ();
+}
+
+static
+uint32_t register_processors (const acpi_madt* madt, uint64_t* stacks)
+{
+	uint8_t bsp = LAPIC_id ();
+	uint32_t count = 0;
+	for (const acpi_madt_entry* entry = acpi_madt_begin (madt);
+	     entry < acpi_madt_end (madt);
+	     entry = acpi_madt_next (entry))
+	{
+		if (entry->length == 0)
+			break;
+		if (entry->type != MADT_LOCAL_APIC)
+			continue;
+		const acpi_madt_local_apic* lapic = (const acpi_madt_local_apic*) entry;
+		if (!(lapic->flags & MADT_LOCAL_APIC_ENABLED) || lapic->apic_id == bsp)
+			continue;
+
+		uint8_t* stack = bootmem_alloc (AP_STACK_SIZE, 16);
+		void* area = bootmem_alloc (fpu_area_size (), FPU_AREA_ALIGN);
+		if (stack == NULL || area == NULL)
+			break;
+		uint32_t cpu = cpu_register (lapic->apic_id);
+		if (cpu == UINT32_MAX)
+			break;
+		stacks [lapic->apic_id] = (uint64_t) (stack + AP_STACK_SIZE);
+		fpu_areas [cpu] = area;
+		++count;
+	}
+	return count;
+}
+
+static
+void install_trampoline (uint64_t* stacks)
+{
+	uint8_t* base = (uint8_t*) TRAMPOLINE_BASE;
+	for (const uint8_t* p = ap_trampoline_start; p != ap_trampoline_end; ++p)
+		base [p - ap_trampoline_start] = *p;
+
+	descriptor_register gdtr;
+	__asm__ volatile ("sgdt %0" : "=m" (gdtr));
+	__asm__ volatile ("sidt %0" : "=m" (idtr));
+	uint64_t cr3;
+	__asm__ volatile ("mov %%cr3, %0" : "=r" (cr3));
+
+	trampoline_data* data =
+		(trampoline_data*) (base + (ap_trampoline_data - ap_trampoline_start));
+	data->gdt_limit = gdtr.limit;
+	data->gdt_base  = gdtr.base;
+	data->cr3       = cr3;
+	data->stacks    = stacks;
+	data->entry     = &ap_main;
+}
+
+
+// Extern functions
+
+void smp_initialize (void)
+{
+	online [0]   = 1;
+	online_count = 1;
+	smp_call_initialize ();
+
+	if (!LAPIC_present ())
+		return;
+	const acpi_madt* madt = (const acpi_madt*) acpi_find_table ("APIC");
+	if (madt == NULL)
+		return;
+
+	uint64_t* stacks = bootmem_alloc (APIC_IDS * sizeof (uint64_t), sizeof (uint64_t));
+	if (stacks == NULL)
+		return;
+	uint32_t count = register_processors (madt, stacks);
+	if (count == 0)
+		return;
+	install_trampoline (stacks);
+	__atomic_thread_fence (__ATOMIC_SEQ_CST);
+
+	uint64_t start = clock_now_ns ();
+	for (uint32_t cpu = 1; cpu <= count; ++cpu)
+		LAPIC_send_INIT (cpu_apic_id (cpu));
+	delay_ns (INIT_DELAY_NS);
+
+	uint8_t page = TRAMPOLINE_BASE >> 12;
+	for (uint32_t cpu = 1; cpu <= count; ++cpu)
+		LAPIC_send_SIPI (cpu_apic_id (cpu), page);
+	if (!wait_online (count + 1, SIPI_DELAY_NS))
+		for (uint32_t cpu = 1; cpu <= count; ++cpu)
+			if (!__atomic_load_n (&online [cpu], __ATOMIC_ACQUIRE))
+				LAPIC_send_SIPI (cpu_apic_id (cpu), page);
+	wait_online (count + 1, ONLINE_TIMEOUT_NS);
+
+	boot_time_ns = clock_now_ns () - start;
+}
+
+uint32_t smp_online_count (void)
+{
+	return __atomic_load_n (&online_count, __ATOMIC_ACQUIRE);
+}
+
+bool smp_cpu_online (uint32_t cpu)
+{
+	return __atomic_load_n (&online [cpu], __ATOMIC_ACQUIRE);
+}
+
+uint64_t smp_boot_time_ns (void)
+{
+	return boot_time_ns;
+}
@@ -0,0 +1,20 @@
+#ifndef SMP_H
+#define SMP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Starts every enabled processor listed in the ACPI MADT and waits for each to
+// reach its idle loop. Requires bootmem_initialize, clock_initialize,
+// cpu_initialize, timers_initialize, idle_initialize and threads_initialize.
+// Does nothing without a local APIC or a MADT.
+void smp_initialize (void);
+
+// Processors running, including the bootstrap processor
+uint32_t smp_online_count (void);
+bool smp_cpu_online (uint32_t cpu);
+
+// Time from the first INIT IPI until the last processor came online
+uint64_t smp_boot_time_ns (void);
+
+#endif
@@ -0,0 +1,92 @@
+# Application processor start-up code. smp_initialize copies everything between
+# ap_trampoline_start and ap_trampoline_end to TRAMPOLINE_BASE and fills in
+# ap_trampoline_data before sending the startup IPIs, so every address below is
+# computed relative to that copy. An AP arrives in real mode at
+# TRAMPOLINE_BASE:0 and leaves for ap_main in long mode, on the GDT and page
+# tables of the bootstrap processor.
+
+	.set TRAMPOLINE_BASE, 0x8000
+	.set MSR_EFER, 0xC0000080
+
+	.set CR0_PE, 1 << 0
+	.set CR0_WP, 1 << 16
+	.set CR0_PG, 1 << 31
+	.set CR4_PAE, 1 << 5
+	.set CR4_PGE, 1 << 7
+	.set EFER_LME, 1 << 8
+	.set EFER_NXE, 1 << 11
+
+	.section .rodata.ap_trampoline, "a"
+	.global ap_trampoline_start
+	.global ap_trampoline_data
+	.global ap_trampoline_end
+
+	.code16
+ap_trampoline_start:
+	cli
+	cld
+	xorw	%ax, %ax
+	movw	%ax, %ds
+	lgdtl	(TRAMPOLINE_BASE + ap_gdtr - ap_trampoline_start)
+
+	movl	%cr0, %eax
+	orl	$CR0_PE, %eax
+	movl	%eax, %cr0
+	ljmpl	$(1 << 3), $(TRAMPOLINE_BASE + ap_protected - ap_trampoline_start)
+
+	.code32
+ap_protected:
+	movw	$(2 << 3), %ax
+	movw	%ax, %ds
+	movw	%ax, %es
+	movw	%ax, %ss
+	movw	%ax, %fs
+	movw	%ax, %gs
+
+	movl	%cr4, %eax
+	orl	$(CR4_PAE | CR4_PGE), %eax
+	movl	%eax, %cr4
+	movl	(TRAMPOLINE_BASE + ap_cr3 - ap_trampoline_start), %eax
+	movl	%eax, %cr3
+
+	movl	$MSR_EFER, %ecx
+	rdmsr
+	orl	$(EFER_LME | EFER_NXE), %eax
+	wrmsr
+
+	movl	%cr0, %eax
+	orl	$(CR0_PG | CR0_WP), %eax
+	movl	%eax, %cr0
+	ljmpl	$(3 << 3), $(TRAMPOLINE_BASE + ap_long - ap_trampoline_start)
+
+	.code64
+ap_long:
+	# Every AP runs this code at once, so each picks its stack by APIC ID.
+	movl	$1, %eax
+	cpuid
+	shrl	$24, %ebx
+	movl	%ebx, %edi
+	movq	(TRAMPOLINE_BASE + ap_stacks - ap_trampoline_start), %rax
+	movq	(%rax,%rdi,8), %rsp
+	xorl	%ebp, %ebp
+	movq	(TRAMPOLINE_BASE + ap_entry - ap_trampoline_start), %rax
+	call	*%rax
+ap_halt:
+	cli
+	hlt
+	jmp	ap_halt
+
+	# Layout must match ap_trampoline_data in smp/smp.c
+	.balign 8
+ap_trampoline_data:
+ap_gdtr:
+	.word 0 # Limit
+	.long 0 # Base
+	.word 0
+ap_cr3:
+	.quad 0
+ap_stacks:
+	.quad 0 # uint64_t [256], stack tops indexed by APIC ID
+ap_entry:
+	.quad 0 # void (*) (uint32_t apic_id)
+ap_trampoline_end:
@@ -0,0 +1,109 @@
+#ifndef LOCKSTAT_H
+#define LOCKSTAT_H
+
+#include "time/clock.h"
+#include "x86/tsc.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Building with -DLOCK_STATS (e.g. make C64FLAGS=-DLOCK_STATS) fills the
+ * lock_stats in every spinlock. It is updated by the new owner right after
+ * acquisition, so it needs no atomics of its own. Without LOCK_STATS the
+ * structs are empty and the hooks below do nothing, so the locks keep their
+ * minimal size and callers need no #ifdefs.
+ *
+ * Sleeping locks keep mutex_stats instead, which count time asleep in
+ * nanoseconds rather than cycles spent spinning.
+ */
+
+#ifdef LOCK_STATS
+
+typedef struct lock_stats {
+	uint64_t acquisitions;
+	uint64_t contended;         // Acquisitions that had to wait
+	uint64_t max_wait_cycles;
+	uint64_t total_wait_cycles;
+} lock_stats;
+
+typedef struct mutex_stats {
+	uint64_t acquisitions;
+	uint64_t spun;          // Acquisitions that spun on a running owner
+	uint64_t slept;         // Acquisitions that slept
+	uint64_t max_sleep_ns;
+	uint64_t total_sleep_ns;
+} mutex_stats;
+
+static inline
+uint64_t lock_stats_wait_begin (void)
+{
+	return rdtsc ();
+}
+
+// wait_start is 0 for an acquisition that did not wait
+static inline
+void lock_stats_record (lock_stats* stats, uint64_t wait_start)
+{
+	++stats->acquisitions;
+	if (wait_start == 0)
+		return;
+	uint64_t cycles = rdtsc () - wait_start;
+	++stats->contended;
+	stats->total_wait_cycles += cycles;
+	if (cycles > stats->max_wait_cycles)
+		stats->max_wait_cycles = cycles;
+}
+
+static inline
+void mutex_stats_reset (mutex_stats* stats)
+{
+	*stats = (mutex_stats) {.acquisitions = 0};
+}
+
+// sleep_start is the clock_now_ns () at which the caller went to sleep, or 0
+static inline
+void mutex_stats_acquired (mutex_stats* stats, bool spun, uint64_t sleep_start)
+{
+	++stats->acquisitions;
+	stats->spun += spun;
+	if (sleep_start == 0)
+		return;
+	uint64_t sleep_ns = clock_now_ns () - sleep_start;
+	++stats->slept;
+	stats->total_sleep_ns += sleep_ns;
+	if (sleep_ns > stats->max_sleep_ns)
+		stats->max_sleep_ns = sleep_ns;
+}
+
+#else
+
+// Empty structs take no space in GNU C
+typedef struct lock_stats {} lock_stats;
+typedef struct mutex_stats {} mutex_stats;
+
+static inline
+uint64_t lock_stats_wait_begin (void)
+{
+	return 0;
+}
+
+static inline
+void lock_stats_record (__attribute__ ((unused)) lock_stats* stats,
+                        __attribute__ ((unused)) uint64_t wait_start)
+{
+}
+
+static inline
+void mutex_stats_reset (__attribute__ ((unused)) mutex_stats* stats)
+{
+}
+
+static inline
+void mutex_stats_acquired (__attribute__ ((unused)) mutex_stats* stats,
+                           __attribute__ ((unused)) bool spun,
+                           __attribute__ ((unused)) uint64_t sleep_start)
+{
+}
+
+#endif
+
+#endif
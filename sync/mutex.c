@@ -0,0 +1,97 @@
+#include "mutex.h"
+#include "time/clock.h"
+#include "x86/control.h"
+#include <stddef.h>
+
+static inline
+thread* owner_thread (uintptr_t owner)
+{
+	return (thread*) (owner & ~(uintptr_t) MUTEX_WAITERS);
+}
+
+// Threads are never freed, only recycled, so a stale owner can still be read
+static inline
+bool owner_running (const thread* owner, const thread* self)
+{
+	return __atomic_load_n (&owner->state, __ATOMIC_RELAXED) == THREAD_RUNNING &&
+	       owner->cpu != self->cpu;
+}
+
+// Spins while the mutex is held by a thread running on another CPU. Returns
+// true once acquired, false when it is time to sleep.
+static
+bool spin (mutex* m, thread* self, bool* spun)
+{
+	for (;;) {
+		uintptr_t owner = __atomic_load_n (&m->owner, __ATOMIC_RELAXED);
+		if (owner == 0) {
+			if (__atomic_compare_exchange_n (&m->owner, &owner, (uintptr_t) self, false,
+			                                 __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+				return true;
+			continue;
+		}
+		if (!owner_running (owner_thread (owner), self))
+			return false;
+		*spun = true;
+		cpu_relax ();
+	}
+}
+
+
+// Extern functions
+
+void mutex_initialize (mutex* m)
+{
+	m->owner = 0;
+	wait_queue_initialize (&m->waiters);
+	mutex_stats_reset (&m->stats);
+}
+
+bool mutex_acquire_slow (mutex* m, uint64_t deadline_ns)
+{
+	thread* self = thread_current ();
+	bool spun = false;
+	if (spin (m, self, &spun)) {
+		mutex_stats_acquired (&m->stats, spun, 0);
+		return true;
+	}
+
+	uint64_t sleep_start = clock_now_ns ();
+	waiter w;
+	uint64_t flags = qspinlock_acquire_irqsave (&m->waiters.lock);
+	for (;;) {
+		// Free only if nobody is queued, as release hands off otherwise
+		uintptr_t owner = __atomic_load_n (&m->owner, __ATOMIC_RELAXED);
+		uintptr_t desired = (owner == 0) ? (uintptr_t) self : owner | MUTEX_WAITERS;
+		if (__atomic_compare_exchange_n (&m->owner, &owner, desired, false,
+		                                 __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+			if (desired == (uintptr_t) self) {
+				qspinlock_release_irqrestore (&m->waiters.lock, flags);
+				mutex_stats_acquired (&m->stats, spun, 0);
+				return true;
+			}
+			break;
+		}
+	}
+	wait_queue_add_locked (&m->waiters, &w);
+	qspinlock_release_irqrestore (&m->waiters.lock, flags);
+
+	// A wakeup comes with ownership
+	if (!wait_queue_sleep (&m->waiters, &w, deadline_ns))
+		return false;
+	mutex_stats_acquired (&m->stats, spun, sleep_start);
+	return true;
+}
+
+void mutex_release_slow (mutex* m)
+{
+	uint64_t flags = qspinlock_acquire_irqsave (&m->waiters.lock);
+	waiter* w = wait_queue_pop_locked (&m->waiters);
+	uintptr_t next = 0;
+	if (w != NULL)
+		next = (uintptr_t) w->thread | (wait_queue_empty (&m->waiters) ? 0 : MUTEX_WAITERS);
+	__atomic_store_n (&m->owner, next, __ATOMIC_RELEASE);
+	if (w != NULL)
+		waiter_wake (w);
+	qspinlock_release_irqrestore (&m->waiters.lock, flags);
+}
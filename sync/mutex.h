@@ -0,0 +1,80 @@
+#ifndef MUTEX_H
+#define MUTEX_H
+
+#include "lockstat.h"
+#include "sched/thread.h"
+#include "sched/waitqueue.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* A sleeping lock for critical sections that may take long or block, such as
+ * I/O. A thread that finds the mutex taken spins only while the owner is
+ * running on another CPU, since it is then likely to release the mutex soon;
+ * otherwise it sleeps on the mutex's wait queue.
+ *
+ * The owner word holds the owning thread and MUTEX_WAITERS while anyone
+ * sleeps. Without waiters, acquiring and releasing are a single CAS each.
+ * With waiters, release hands ownership directly to the first one and wakes
+ * only that thread, so a woken waiter never has to compete for the lock.
+ *
+ * Mutexes are for threads: not for interrupt handlers, and not for the idle
+ * thread while the owner may be on the same CPU.
+ */
+
+enum {
+	MUTEX_WAITERS = 1
+};
+
+typedef struct mutex {
+	uintptr_t  owner; // 0 when free
+	wait_queue waiters;
+	mutex_stats stats;
+} mutex;
+
+void mutex_initialize (mutex* m);
+
+bool mutex_acquire_slow (mutex* m, uint64_t deadline_ns);
+void mutex_release_slow (mutex* m);
+
+static inline
+bool mutex_try_acquire (mutex* m)
+{
+	uintptr_t unlocked = 0;
+	if (!__atomic_compare_exchange_n (&m->owner, &unlocked, (uintptr_t) thread_current (), false,
+	                                  __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		return false;
+	mutex_stats_acquired (&m->stats, false, 0);
+	return true;
+}
+
+static inline
+void mutex_acquire (mutex* m)
+{
+	if (!mutex_try_acquire (m))
+		mutex_acquire_slow (m, WAIT_FOREVER);
+}
+
+// Gives up once the clock reaches deadline_ns. Returns true if acquired.
+static inline
+bool mutex_acquire_timeout (mutex* m, uint64_t deadline_ns)
+{
+	return mutex_try_acquire (m) || mutex_acquire_slow (m, deadline_ns);
+}
+
+static inline
+void mutex_release (mutex* m)
+{
+	uintptr_t self = (uintptr_t) thread_current ();
+	if (!__atomic_compare_exchange_n (&m->owner, &self, 0, false,
+	                                  __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+		mutex_release_slow (m);
+}
+
+static inline
+bool mutex_held (const mutex* m)
+{
+	return (__atomic_load_n (&m->owner, __ATOMIC_RELAXED) & ~(uintptr_t) MUTEX_WAITERS) ==
+	       (uintptr_t) thread_current ();
+}
+
+#endif
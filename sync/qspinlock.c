@@ -0,0 +1,96 @@
+#include "qspinlock.h"
+#include "smp/cpu.h"
+#include <stddef.h>
+
+enum {
+	CACHE_LINE = 64,
+
+	// A CPU can be queued on one lock per context it can be interrupted in:
+	// thread, interrupt, and two levels of nested interrupt.
+	MAX_NESTING = 4,
+	NESTING_BITS = 2
+};
+
+typedef struct __attribute__ ((aligned (CACHE_LINE))) qspinlock_node {
+	struct qspinlock_node* next;
+	uint32_t               head;  // Set by the predecessor when it leaves the queue
+	uint32_t               count; // Nodes in use on this CPU; kept in the first node only
+} qspinlock_node;
+
+static DEFINE_PER_CPU (qspinlock_node, cpu_nodes [MAX_NESTING]);
+
+static inline
+uint16_t encode_tail (uint32_t cpu, uint32_t index)
+{
+	return (cpu + 1) << NESTING_BITS | index;
+}
+
+static inline
+qspinlock_node* decode_tail (uint16_t tail)
+{
+	uint32_t cpu   = (tail >> NESTING_BITS) - 1;
+	uint32_t index = tail & ((1 << NESTING_BITS) - 1);
+	return &(*per_cpu_ptr (cpu_nodes, cpu)) [index];
+}
+
+// Swaps in a new tail, leaving the locked byte as it is
+static
+uint16_t exchange_tail (qspinlock* lock, uint16_t tail)
+{
+	return __atomic_exchange_n (&lock->tail, tail, __ATOMIC_ACQ_REL);
+}
+
+
+// Extern functions
+
+void qspinlock_acquire_slow (qspinlock* lock)
+{
+	uint64_t wait_start = lock_stats_wait_begin ();
+
+	qspinlock_node* nodes = *this_cpu_ptr (cpu_nodes);
+	uint32_t index = nodes [0].count;
+	if (index == MAX_NESTING) {
+		// Out of nodes: spin on the lock word like a plain test-and-set lock
+		uint32_t unlocked = 0;
+		while (!__atomic_compare_exchange_n (&lock->value, &unlocked, 1, false,
+		                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+			unlocked = 0;
+			cpu_relax ();
+		}
+		lock_stats_record (&lock->stats, wait_start);
+		return;
+	}
+	nodes [0].count = index + 1;
+	qspinlock_node* node = &nodes [index];
+	node->next = NULL;
+	node->head = 0;
+	uint16_t tail = encode_tail (cpu_index (), index);
+
+	uint16_t previous = exchange_tail (lock, tail);
+	if (previous != 0) {
+		__atomic_store_n (&decode_tail (previous)->next, node, __ATOMIC_RELEASE);
+		while (!__atomic_load_n (&node->head, __ATOMIC_ACQUIRE))
+			cpu_relax ();
+	}
+
+	// At the head of the queue: wait for the owner, then take the lock. With
+	// the queue non-empty the fast path cannot succeed, so only the head ever
+	// sets the locked byte here.
+	uint32_t value;
+	while ((value = __atomic_load_n (&lock->value, __ATOMIC_ACQUIRE)) & 0xFF)
+		cpu_relax ();
+
+	// If this node is still the tail, leave the queue empty while locking
+	if ((value >> 16) != tail ||
+	    !__atomic_compare_exchange_n (&lock->value, &value, 1, false,
+	                                  __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+		__atomic_store_n (&lock->locked, 1, __ATOMIC_RELAXED);
+		qspinlock_node* next;
+		while ((next = __atomic_load_n (&node->next, __ATOMIC_ACQUIRE)) == NULL)
+			cpu_relax ();
+		__atomic_store_n (&next->head, 1, __ATOMIC_RELEASE);
+	}
+
+	--nodes [0].count;
+	lock_stats_record (&lock->stats, wait_start);
+}
@@ -0,0 +1,81 @@
+#ifndef QSPINLOCK_H
+#define QSPINLOCK_H
+
+#include "lockstat.h"
+#include "x86/control.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* A queued spinlock in the style of MCS: waiters form a queue of per-CPU
+ * nodes, each on its own cache line, and spin only on their own node until
+ * they reach its head. Only the head of the queue spins on the lock word
+ * itself. The lock stays one word; the queue is reached through the tail
+ * field, which holds the last waiter's CPU and nesting level.
+ */
+typedef struct qspinlock {
+	union {
+		uint32_t value;
+		struct {
+			uint8_t  locked;
+			uint8_t  reserved;
+			uint16_t tail; // 0 if nobody is queued
+		};
+	};
+	lock_stats stats;
+} qspinlock;
+
+static inline
+qspinlock make_qspinlock (void)
+{
+	return (qspinlock) {.value = 0};
+}
+
+void qspinlock_acquire_slow (qspinlock* lock);
+
+static inline
+void qspinlock_acquire (qspinlock* lock)
+{
+	uint32_t unlocked = 0;
+	if (__atomic_compare_exchange_n (&lock->value, &unlocked, 1, false,
+	                                 __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+		lock_stats_record (&lock->stats, 0);
+		return;
+	}
+	qspinlock_acquire_slow (lock);
+}
+
+static inline
+bool qspinlock_try_acquire (qspinlock* lock)
+{
+	uint32_t unlocked = 0;
+	if (!__atomic_compare_exchange_n (&lock->value, &unlocked, 1, false,
+	                                  __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		return false;
+	lock_stats_record (&lock->stats, 0);
+	return true;
+}
+
+static inline
+void qspinlock_release (qspinlock* lock)
+{
+	__atomic_store_n (&lock->locked, 0, __ATOMIC_RELEASE);
+}
+
+// Disables interrupts for as long as the lock is held; pass the result to
+// qspinlock_release_irqrestore.
+static inline
+uint64_t qspinlock_acquire_irqsave (qspinlock* lock)
+{
+	uint64_t flags = save_flags_cli ();
+	qspinlock_acquire (lock);
+	return flags;
+}
+
+static inline
+void qspinlock_release_irqrestore (qspinlock* lock, uint64_t flags)
+{
+	qspinlock_release (lock);
+	restore_flags (flags);
+}
+
+#endif
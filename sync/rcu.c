@@ -0,0 +1,123 @@
+#include "rcu.h"
+#include "sched/idle.h"
+#include "sched/thread.h"
+#include "smp/cpu.h"
+#include "smp/smp.h"
+#include "sync/qspinlock.h"
+#include "x86/control.h"
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Grace periods are numbered by gp_seq. Each CPU records the number it saw at
+ * its last quiescent state, so a CPU whose record has reached a grace
+ * period's number has left every read section it was in when that period
+ * started. rcu_synchronize starts a period and waits for the records of the
+ * other online CPUs to catch up; the caller itself is quiescent.
+ */
+
+static uint64_t  gp_seq;
+static rcu_stats stats;
+
+static qspinlock  callback_lock;
+static rcu_head*  pending;
+static rcu_head** pending_tail;
+static thread*    callback_thread;
+
+static DEFINE_PER_CPU (uint64_t, cpu_qs_seq);
+
+static inline
+bool reported (uint32_t cpu, uint64_t target)
+{
+	return __atomic_load_n (per_cpu_ptr (cpu_qs_seq, cpu), __ATOMIC_ACQUIRE) >= target;
+}
+
+static
+void run_callbacks (__attribute__ ((unused)) void* arg)
+{
+	for (;;) {
+		uint64_t flags = qspinlock_acquire_irqsave (&callback_lock);
+		rcu_head* batch = pending;
+		pending = NULL;
+		pending_tail = &pending;
+		qspinlock_release_irqrestore (&callback_lock, flags);
+
+		if (batch == NULL) {
+			thread_block ();
+			continue;
+		}
+
+		// Everything in the batch was queued before this grace period
+		rcu_synchronize ();
+		while (batch != NULL) {
+			rcu_head* next = batch->next;
+			batch->function (batch);
+			__atomic_add_fetch (&stats.callbacks, 1, __ATOMIC_RELAXED);
+			batch = next;
+		}
+	}
+}
+
+
+// Extern functions
+
+void rcu_initialize (void)
+{
+	callback_lock = make_qspinlock ();
+	pending_tail = &pending;
+	callback_thread = thread_create_on (0, &run_callbacks, NULL);
+}
+
+void rcu_quiescent (void)
+{
+	// Reads from earlier read sections complete before the report
+	__atomic_thread_fence (__ATOMIC_RELEASE);
+	this_cpu_write (cpu_qs_seq, __atomic_load_n (&gp_seq, __ATOMIC_ACQUIRE));
+}
+
+void rcu_synchronize (void)
+{
+	// Ordered after the caller's rcu_assign_pointer: a CPU that reports the
+	// new number afterwards also sees the new pointer.
+	uint64_t target = __atomic_add_fetch (&gp_seq, 1, __ATOMIC_SEQ_CST);
+	rcu_quiescent ();
+	uint32_t self = cpu_index ();
+
+	// Wake every CPU that still has to report first, so that they report
+	// in parallel
+	for (uint32_t cpu = 0; cpu < MAX_CPUS; ++cpu)
+		if (cpu != self && smp_cpu_online (cpu) && !reported (cpu, target))
+			idle_wake (cpu);
+
+	for (uint32_t cpu = 0; cpu < MAX_CPUS; ++cpu) {
+		if (cpu == self || !smp_cpu_online (cpu))
+			continue;
+		while (!reported (cpu, target)) {
+			thread_yield ();
+			cpu_relax ();
+		}
+	}
+	__atomic_add_fetch (&stats.grace_periods, 1, __ATOMIC_RELAXED);
+}
+
+void rcu_call (rcu_head* head, rcu_callback function)
+{
+	head->next     = NULL;
+	head->function = function;
+
+	uint64_t flags = qspinlock_acquire_irqsave (&callback_lock);
+	*pending_tail = head;
+	pending_tail = &head->next;
+	bool first = (pending == head);
+	qspinlock_release_irqrestore (&callback_lock, flags);
+
+	if (first)
+		thread_wake (callback_thread);
+}
+
+rcu_stats rcu_statistics (void)
+{
+	return (rcu_stats) {
+		.grace_periods = __atomic_load_n (&stats.grace_periods, __ATOMIC_RELAXED),
+		.callbacks     = __atomic_load_n (&stats.callbacks, __ATOMIC_RELAXED)
+	};
+}
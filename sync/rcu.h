@@ -0,0 +1,57 @@
+#ifndef RCU_H
+#define RCU_H
+
+#include <stdint.h>
+
+/* Read-copy-update for read-mostly data. Readers follow a published pointer
+ * without locks or shared writes; an updater builds a new version, publishes
+ * it with rcu_assign_pointer and frees the old one after a grace period, once
+ * every CPU has passed a quiescent state.
+ *
+ * Threads are cooperative, so a CPU that switches threads or goes through its
+ * idle loop cannot be inside a read section; these are the quiescent states,
+ * and rcu_read_lock costs nothing. Read sections must therefore not block,
+ * yield or sleep. A CPU that runs one thread (or handler) for a long time
+ * delays every grace period by as much.
+ */
+
+typedef struct rcu_head rcu_head;
+typedef void (*rcu_callback) (rcu_head* head);
+
+// Embedded in the object to be reclaimed
+struct rcu_head {
+	rcu_head*    next;
+	rcu_callback function;
+};
+
+#define rcu_read_lock()   __asm__ volatile ("" ::: "memory")
+#define rcu_read_unlock() __asm__ volatile ("" ::: "memory")
+
+#define rcu_dereference(p) __atomic_load_n (&(p), __ATOMIC_CONSUME)
+#define rcu_assign_pointer(p, v) __atomic_store_n (&(p), (v), __ATOMIC_RELEASE)
+
+// Starts the thread that runs rcu_call callbacks. Requires threads_initialize.
+void rcu_initialize (void);
+
+// Reports a quiescent state for the calling CPU. Called on context switches
+// and from the idle loop.
+void rcu_quiescent (void);
+
+// Returns once every read section that was running on any online CPU at the
+// time of the call has ended. Idle CPUs are woken to report, and the caller
+// yields while it waits; it must not be inside a read section.
+void rcu_synchronize (void);
+
+// Runs function (head) from a kernel thread on CPU 0 after a grace period.
+// Callbacks queued close together share one grace period. Requires
+// rcu_initialize.
+void rcu_call (rcu_head* head, rcu_callback function);
+
+typedef struct rcu_stats {
+	uint64_t grace_periods;
+	uint64_t callbacks;
+} rcu_stats;
+
+rcu_stats rcu_statistics (void);
+
+#endif
@@ -0,0 +1,95 @@
+#include "ring.h"
+#include <stdbool.h>
+
+static inline
+uint32_t min_count (uint64_t a, uint32_t b)
+{
+	return (a < b) ? a : b;
+}
+
+
+// Extern functions
+
+void spsc_ring_initialize (spsc_ring* ring, uint64_t* slots, uint64_t size)
+{
+	ring->head        = 0;
+	ring->cached_tail = 0;
+	ring->tail        = 0;
+	ring->cached_head = 0;
+	ring->mask        = size - 1;
+	ring->slots       = slots;
+}
+
+void mpsc_ring_initialize (mpsc_ring* ring, mpsc_slot* slots, uint64_t size)
+{
+	ring->head  = 0;
+	ring->tail  = 0;
+	ring->mask  = size - 1;
+	ring->slots = slots;
+	// A sequence left over from earlier use could look published
+	for (uint64_t i = 0; i < size; ++i)
+		slots [i].sequence = 0;
+}
+
+uint32_t spsc_ring_enqueue (spsc_ring* ring, const uint64_t* values, uint32_t count)
+{
+	uint64_t tail = ring->tail;
+	uint64_t size = ring->mask + 1;
+	if (tail - ring->cached_head + count > size)
+		ring->cached_head = __atomic_load_n (&ring->head, __ATOMIC_ACQUIRE);
+	uint32_t n = min_count (size - (tail - ring->cached_head), count);
+
+	for (uint32_t i = 0; i < n; ++i)
+		ring->slots [(tail + i) & ring->mask] = values [i];
+	__atomic_store_n (&ring->tail, tail + n, __ATOMIC_RELEASE);
+	return n;
+}
+
+uint32_t spsc_ring_dequeue (spsc_ring* ring, uint64_t* values, uint32_t max)
+{
+	uint64_t head = ring->head;
+	if (ring->cached_tail - head < max)
+		ring->cached_tail = __atomic_load_n (&ring->tail, __ATOMIC_ACQUIRE);
+	uint32_t n = min_count (ring->cached_tail - head, max);
+
+	for (uint32_t i = 0; i < n; ++i)
+		values [i] = ring->slots [(head + i) & ring->mask];
+	__atomic_store_n (&ring->head, head + n, __ATOMIC_RELEASE);
+	return n;
+}
+
+uint32_t mpsc_ring_enqueue (mpsc_ring* ring, const uint64_t* values, uint32_t count)
+{
+	uint64_t size = ring->mask + 1;
+	uint64_t tail = __atomic_load_n (&ring->tail, __ATOMIC_RELAXED);
+	uint32_t n;
+	do {
+		uint64_t head = __atomic_load_n (&ring->head, __ATOMIC_ACQUIRE);
+		n = min_count (size - (tail - head), count);
+		if (n == 0)
+			return 0;
+	}
+	while (!__atomic_compare_exchange_n (&ring->tail, &tail, tail + n, true,
+	                                     __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+	for (uint32_t i = 0; i < n; ++i) {
+		mpsc_slot* slot = &ring->slots [(tail + i) & ring->mask];
+		slot->value = values [i];
+		__atomic_store_n (&slot->sequence, tail + i + 1, __ATOMIC_RELEASE);
+	}
+	return n;
+}
+
+uint32_t mpsc_ring_dequeue (mpsc_ring* ring, uint64_t* values, uint32_t max)
+{
+	uint64_t head = ring->head;
+	uint32_t n = 0;
+	for (; n < max; ++n) {
+		mpsc_slot* slot = &ring->slots [(head + n) & ring->mask];
+		if (__atomic_load_n (&slot->sequence, __ATOMIC_ACQUIRE) != head + n + 1)
+			break;
+		values [n] = slot->value;
+	}
+	__atomic_store_n (&ring->head, head + n, __ATOMIC_RELEASE);
+	return n;
+}
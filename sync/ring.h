@@ -0,0 +1,59 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stdint.h>
+
+/* Bounded rings of 64-bit values (integers or pointers) in caller-provided
+ * storage whose size is a power of two. No operation takes a lock or waits:
+ * enqueue stores what fits and returns the count, dequeue takes what is
+ * there. Both work from interrupt handlers as well as threads.
+ *
+ * Indices run freely and are masked into the storage, and each sits on its
+ * own cache line. In the SPSC ring, each side also keeps a cached copy of the
+ * opposite index, so it only touches the other side's line when its cached
+ * view says the ring is full or empty. MPSC producers read the head on every
+ * enqueue, since they already contend on the tail.
+ */
+
+enum {
+	RING_CACHE_LINE = 64
+};
+
+// One producer and one consumer at a time
+typedef struct spsc_ring {
+	__attribute__ ((aligned (RING_CACHE_LINE))) uint64_t head; // Consumer
+	uint64_t  cached_tail;
+	__attribute__ ((aligned (RING_CACHE_LINE))) uint64_t tail; // Producer
+	uint64_t  cached_head;
+	__attribute__ ((aligned (RING_CACHE_LINE))) uint64_t mask;
+	uint64_t* slots;
+} spsc_ring;
+
+// Producers reserve slots with a compare-and-swap on the tail and publish
+// each slot with its own sequence number, so a producer interrupted between
+// the two (even by another producer on the same CPU) holds up only the
+// consumer, and only at that slot.
+typedef struct mpsc_slot {
+	uint64_t sequence; // Index + 1 once the slot holds that index's value
+	uint64_t value;
+} mpsc_slot;
+
+typedef struct mpsc_ring {
+	__attribute__ ((aligned (RING_CACHE_LINE))) uint64_t head; // Consumer
+	__attribute__ ((aligned (RING_CACHE_LINE))) uint64_t tail; // Producers
+	__attribute__ ((aligned (RING_CACHE_LINE))) uint64_t mask;
+	mpsc_slot* slots;
+} mpsc_ring;
+
+// Initialises a ring in place; size must be a power of two. MPSC slots must
+// start zeroed.
+void spsc_ring_initialize (spsc_ring* ring, uint64_t* slots, uint64_t size);
+void mpsc_ring_initialize (mpsc_ring* ring, mpsc_slot* slots, uint64_t size);
+
+uint32_t spsc_ring_enqueue (spsc_ring* ring, const uint64_t* values, uint32_t count);
+uint32_t spsc_ring_dequeue (spsc_ring* ring, uint64_t* values, uint32_t max);
+
+uint32_t mpsc_ring_enqueue (mpsc_ring* ring, const uint64_t* values, uint32_t count);
+uint32_t mpsc_ring_dequeue (mpsc_ring* ring, uint64_t* values, uint32_t max);
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include "x86/control.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// Readers never write shared state: they snapshot the sequence number, read
+// the protected data and retry if a writer was active in the meantime. Writers
+// must be serialized by the caller and must not be interrupted by readers on
+// the same CPU.
+typedef struct seqlock {
+	uint32_t sequence;
+} seqlock;
+
+static inline
+uint32_t seqlock_read_begin (const seqlock* lock)
+{
+	uint32_t sequence;
+	while ((sequence = __atomic_load_n (&lock->sequence, __ATOMIC_ACQUIRE)) & 1)
+		cpu_relax ();
+	return sequence;
+}
+
+static inline
+bool seqlock_read_retry (const seqlock* lock, uint32_t sequence)
+{
+	__atomic_thread_fence (__ATOMIC_ACQUIRE);
+	return __atomic_load_n (&lock->sequence, __ATOMIC_RELAXED) != sequence;
+}
+
+static inline
+void seqlock_write_begin (seqlock* lock)
+{
+	__atomic_store_n (&lock->sequence, lock->sequence + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence (__ATOMIC_RELEASE);
+}
+
+static inline
+void seqlock_write_end (seqlock* lock)
+{
+	__atomic_store_n (&lock->sequence, lock->sequence + 1, __ATOMIC_RELEASE);
+}
+
+#endif
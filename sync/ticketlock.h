@@ -0,0 +1,74 @@
+#ifndef TICKETLOCK_H
+#define TICKETLOCK_H
+
+#include "lockstat.h"
+#include "x86/control.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// Waiters take a ticket and are served in order. Every waiter spins on the
+// same word, so each release invalidates the line in every waiting CPU; use a
+// qspinlock where many CPUs contend.
+typedef struct ticketlock {
+	uint16_t owner; // Ticket being served
+	uint16_t next;  // Next ticket to hand out
+	lock_stats stats;
+} ticketlock;
+
+static inline
+ticketlock make_ticketlock (void)
+{
+	return (ticketlock) {.owner = 0, .next = 0};
+}
+
+static inline
+void ticketlock_acquire (ticketlock* lock)
+{
+	uint16_t ticket = __atomic_fetch_add (&lock->next, 1, __ATOMIC_RELAXED);
+	if (__atomic_load_n (&lock->owner, __ATOMIC_ACQUIRE) == ticket) {
+		lock_stats_record (&lock->stats, 0);
+		return;
+	}
+
+	uint64_t wait_start = lock_stats_wait_begin ();
+	while (__atomic_load_n (&lock->owner, __ATOMIC_ACQUIRE) != ticket)
+		cpu_relax ();
+	lock_stats_record (&lock->stats, wait_start);
+}
+
+static inline
+bool ticketlock_try_acquire (ticketlock* lock)
+{
+	uint16_t owner = __atomic_load_n (&lock->owner, __ATOMIC_RELAXED);
+	uint16_t ticket = owner;
+	if (!__atomic_compare_exchange_n (&lock->next, &ticket, (uint16_t) (owner + 1), false,
+	                                  __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		return false;
+	lock_stats_record (&lock->stats, 0);
+	return true;
+}
+
+static inline
+void ticketlock_release (ticketlock* lock)
+{
+	__atomic_store_n (&lock->owner, lock->owner + 1, __ATOMIC_RELEASE);
+}
+
+// Disables interrupts for as long as the lock is held; pass the result to
+// ticketlock_release_irqrestore.
+static inline
+uint64_t ticketlock_acquire_irqsave (ticketlock* lock)
+{
+	uint64_t flags = save_flags_cli ();
+	ticketlock_acquire (lock);
+	return flags;
+}
+
+static inline
+void ticketlock_release_irqrestore (ticketlock* lock, uint64_t flags)
+{
+	ticketlock_release (lock);
+	restore_flags (flags);
+}
+
+#endif
@@ -0,0 +1,37 @@
+#include "8254.h"
+#include "x86/portio.h"
+
+
+// Extern functions
+
+void pit_channel0_oneshot (uint16_t count)
+{
+	outb (PIT_COMMAND, PIT_SELECT_CH0 | PIT_ACCESS_LOHI | PIT_MODE_ONESHOT);
+	outb (PIT_CHANNEL0, count & 0xFF);
+	outb (PIT_CHANNEL0, count >> 8);
+}
+
+void pit_channel0_periodic (uint16_t count)
+{
+	outb (PIT_COMMAND, PIT_SELECT_CH0 | PIT_ACCESS_LOHI | PIT_MODE_SQUARE);
+	outb (PIT_CHANNEL0, count & 0xFF);
+	outb (PIT_CHANNEL0, count >> 8);
+}
+
+void pit_channel2_start (uint16_t count)
+{
+	uint8_t port_b = inb (PIT_PORT_B);
+	outb (PIT_PORT_B, (port_b & ~PIT_PORT_B_SPKR) & ~PIT_PORT_B_GATE2);
+
+	outb (PIT_COMMAND, PIT_SELECT_CH2 | PIT_ACCESS_LOHI | PIT_MODE_ONESHOT);
+	outb (PIT_CHANNEL2, count & 0xFF);
+	outb (PIT_CHANNEL2, count >> 8);
+
+	// Counting starts on the rising edge of the gate
+	outb (PIT_PORT_B, (port_b & ~PIT_PORT_B_SPKR) | PIT_PORT_B_GATE2);
+}
+
+bool pit_channel2_expired (void)
+{
+	return inb (PIT_PORT_B) & PIT_PORT_B_OUT2;
+}
@@ -0,0 +1,42 @@
+#ifndef _8254_H
+#define _8254_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+enum {
+	// 8254 PIT input clock
+	PIT_FREQUENCY = 1193182,
+
+	// 8254 PIT I/O ports
+	PIT_CHANNEL0 = 0x40,
+	PIT_CHANNEL2 = 0x42,
+	PIT_COMMAND  = 0x43,
+
+	// Keyboard controller port B, which gates channel 2 and reads its output
+	PIT_PORT_B        = 0x61,
+	PIT_PORT_B_GATE2  = 0x01,
+	PIT_PORT_B_SPKR   = 0x02,
+	PIT_PORT_B_OUT2   = 0x20,
+
+	// Command word fields
+	PIT_SELECT_CH0   = 0x00,
+	PIT_SELECT_CH2   = 0x80,
+	PIT_ACCESS_LOHI  = 0x30,
+	PIT_MODE_ONESHOT = 0x00, // Mode 0: interrupt on terminal count
+	PIT_MODE_SQUARE  = 0x06  // Mode 3: square wave generator
+};
+
+// Programs channel 0 to raise IRQ 0 once, after count input clocks.
+void pit_channel0_oneshot (uint16_t count);
+
+// Programs channel 0 to raise IRQ 0 every count input clocks. Only for when
+// the PIT is not the clock event device.
+void pit_channel0_periodic (uint16_t count);
+
+// Starts channel 2 counting down from count with the speaker disconnected. Its
+// output goes high, visible through pit_channel2_expired, at terminal count.
+void pit_channel2_start (uint16_t count);
+bool pit_channel2_expired (void);
+
+#endif
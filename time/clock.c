@@ -0,0 +1,158 @@
+#include "clock.h"
+#include "8254.h"
+#include "hpet.h"
+#include "sync/seqlock.h"
+#include "x86/control.h"
+#include "x86/cpuid.h"
+#include "x86/tsc.h"
+
+enum {
+	NSEC_PER_SEC  = 1000000000,
+	FSEC_PER_NSEC = 1000000,
+
+	// Cycle deltas are scaled by mult / 2^CLOCK_SHIFT
+	CLOCK_SHIFT = 32,
+
+	CALIBRATE_NS     = 10000000,
+	CALIBRATE_ROUNDS = 3,
+	CALIBRATE_PIT_COUNT = (uint64_t) PIT_FREQUENCY * CALIBRATE_NS / NSEC_PER_SEC,
+
+	CPUID_80000007_EDX_INVARIANT_TSC = 1 << 8
+};
+
+typedef struct clock_data {
+	clock_source source;
+	uint64_t     base_cycles;
+	uint64_t     base_ns;
+	uint64_t     mult;
+} clock_data;
+
+static seqlock    clock_lock;
+static clock_data data;
+static uint64_t   tsc_hz;
+static bool       tsc_invariant;
+
+static inline
+__attribute__ ((always_inline))
+uint64_t read_cycles (clock_source source)
+{
+	if (source == CLOCK_HPET)
+		return hpet_read_counter ();
+	return rdtsc ();
+}
+
+static inline
+__attribute__ ((always_inline))
+uint64_t scale (uint64_t cycles, uint64_t mult)
+{
+	return ((unsigned __int128) cycles * mult) >> CLOCK_SHIFT;
+}
+
+static
+bool detect_invariant_tsc (void)
+{
+	if (cpuid_max_extended_leaf () < 0x80000007)
+		return false;
+	return cpuid (0x80000007, 0).edx & CPUID_80000007_EDX_INVARIANT_TSC;
+}
+
+// Each round is timed separately and the shortest kept, since SMIs and
+// emulation exits can only lengthen the TSC interval around a fixed reference
+// interval.
+static
+uint64_t calibrate_pit (void)
+{
+	uint64_t best = UINT64_MAX;
+	for (int i = 0; i < CALIBRATE_ROUNDS; ++i) {
+		pit_channel2_start (CALIBRATE_PIT_COUNT);
+		uint64_t start = rdtsc_ordered ();
+		while (!pit_channel2_expired ())
+			;
+		uint64_t cycles = rdtsc_ordered () - start;
+		if (cycles < best)
+			best = cycles;
+	}
+	return best * PIT_FREQUENCY / CALIBRATE_PIT_COUNT;
+}
+
+static
+uint64_t calibrate_hpet (void)
+{
+	uint64_t ticks = (uint64_t) CALIBRATE_NS * FSEC_PER_NSEC / hpet_period_fs ();
+	uint64_t mask  = hpet_counter_64bit () ? UINT64_MAX : UINT32_MAX;
+	uint64_t best_hz = 0;
+	for (int i = 0; i < CALIBRATE_ROUNDS; ++i) {
+		uint64_t hpet_start = hpet_read_counter ();
+		uint64_t tsc_start  = rdtsc_ordered ();
+		uint64_t hpet_ticks;
+		while ((hpet_ticks = (hpet_read_counter () - hpet_start) & mask) < ticks)
+			;
+		uint64_t tsc_cycles = rdtsc_ordered () - tsc_start;
+		uint64_t elapsed_ns = hpet_ticks * hpet_period_fs () / FSEC_PER_NSEC;
+		uint64_t hz = tsc_cycles * NSEC_PER_SEC / elapsed_ns;
+		if (best_hz == 0 || hz < best_hz)
+			best_hz = hz;
+	}
+	return best_hz;
+}
+
+
+// Extern functions
+
+void clock_initialize (void)
+{
+	tsc_invariant = detect_invariant_tsc ();
+	bool hpet = hpet_initialize ();
+	tsc_hz = hpet ? calibrate_hpet () : calibrate_pit ();
+
+	clock_source source = CLOCK_TSC;
+	uint64_t mult = ((uint64_t) NSEC_PER_SEC << CLOCK_SHIFT) / tsc_hz;
+	if (!tsc_invariant && hpet && hpet_counter_64bit ()) {
+		source = CLOCK_HPET;
+		mult   = (hpet_period_fs () << CLOCK_SHIFT) / FSEC_PER_NSEC;
+	}
+
+	uint64_t flags = save_flags_cli ();
+	uint64_t now = clock_now_ns ();
+	seqlock_write_begin (&clock_lock);
+	data = (clock_data) {
+		.source      = source,
+		.base_cycles = read_cycles (source),
+		.base_ns     = now,
+		.mult        = mult
+	};
+	seqlock_write_end (&clock_lock);
+	restore_flags (flags);
+}
+
+uint64_t clock_now_ns (void)
+{
+	uint32_t sequence;
+	uint64_t ns;
+	do {
+		sequence = seqlock_read_begin (&clock_lock);
+		ns = data.base_ns + scale (read_cycles (data.source) - data.base_cycles, data.mult);
+	}
+	while (seqlock_read_retry (&clock_lock, sequence));
+	return ns;
+}
+
+clock_source clock_get_source (void)
+{
+	return data.source;
+}
+
+const char* clock_source_name (void)
+{
+	return (data.source == CLOCK_HPET) ? "HPET" : "TSC";
+}
+
+uint64_t clock_tsc_hz (void)
+{
+	return tsc_hz;
+}
+
+bool clock_tsc_invariant (void)
+{
+	return tsc_invariant;
+}
@@ -0,0 +1,25 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum {
+	CLOCK_TSC,
+	CLOCK_HPET
+} clock_source;
+
+// Calibrates the TSC against the HPET, or the PIT if there is no HPET, and
+// selects the clock source: the TSC if it is invariant, otherwise the HPET
+// when it has a 64-bit counter, otherwise the TSC regardless.
+void clock_initialize (void);
+
+// Nanoseconds since clock_initialize. Lock-free; safe from any context.
+uint64_t clock_now_ns (void);
+
+clock_source clock_get_source (void);
+const char* clock_source_name (void);
+uint64_t clock_tsc_hz (void);
+bool clock_tsc_invariant (void);
+
+#endif
@@ -0,0 +1,178 @@
+#include "clockevent.h"
+#include "clock.h"
+#include "8254.h"
+#include "x86/cpuid.h"
+#include "x86/msr.h"
+#include "x86/tsc.h"
+#include "x86/interrupts/ISR.h"
+#include "x86/interrupts/IRQ.h"
+#include "x86/interrupts/LAPIC.h"
+
+enum {
+	NSEC_PER_SEC = 1000000000,
+
+	// Device ticks are delta_ns * mult / 2^CLOCKEVENT_SHIFT
+	CLOCKEVENT_SHIFT = 32,
+
+	LAPIC_CALIBRATE_NS = 10000000
+};
+
+// Longer deltas are clamped; the handler then programs the remainder.
+static const uint64_t max_delta_ns = (uint64_t) 1 << 40;
+
+static clockevent_mode    mode;
+static clockevent_handler event_handler;
+static uint64_t           tsc_mult;
+static uint64_t           lapic_mult;
+static uint64_t           pit_mult;
+
+static
+uint64_t rate_mult (uint64_t hz)
+{
+	uint64_t whole = hz / NSEC_PER_SEC;
+	uint64_t part  = hz % NSEC_PER_SEC;
+	return (whole << CLOCKEVENT_SHIFT) + (part << CLOCKEVENT_SHIFT) / NSEC_PER_SEC;
+}
+
+static inline
+uint64_t delta_ticks (uint64_t delta_ns, uint64_t mult)
+{
+	if (delta_ns > max_delta_ns)
+		delta_ns = max_delta_ns;
+	return ((unsigned __int128) delta_ns * mult) >> CLOCKEVENT_SHIFT;
+}
+
+static
+uint64_t calibrate_lapic_timer (void)
+{
+	LAPIC_write (LAPIC_REG_TIMER_DIVIDE, LAPIC_TIMER_DIVIDE_16);
+	LAPIC_write (LAPIC_REG_LVT_TIMER, LAPIC_LVT_MASKED | LAPIC_LVT_TIMER_ONESHOT | INT_LAPIC_timer);
+
+	uint64_t start = clock_now_ns ();
+	LAPIC_write (LAPIC_REG_TIMER_INITIAL, UINT32_MAX);
+	uint64_t elapsed;
+	while ((elapsed = clock_now_ns () - start) < LAPIC_CALIBRATE_NS)
+		;
+	uint32_t ticks = UINT32_MAX - LAPIC_read (LAPIC_REG_TIMER_CURRENT);
+	LAPIC_write (LAPIC_REG_TIMER_INITIAL, 0);
+
+	return (uint64_t) ticks * NSEC_PER_SEC / elapsed;
+}
+
+static
+void setup_lvt (void)
+{
+	if (mode == CLOCKEVENT_TSC_DEADLINE) {
+		LAPIC_write (LAPIC_REG_LVT_TIMER, LAPIC_LVT_TIMER_TSC_DEADLINE | INT_LAPIC_timer);
+		// Order the LVT write before any write to IA32_TSC_DEADLINE
+		__asm__ volatile ("mfence" ::: "memory");
+	}
+	else if (mode == CLOCKEVENT_LAPIC_ONESHOT) {
+		LAPIC_write (LAPIC_REG_TIMER_DIVIDE, LAPIC_TIMER_DIVIDE_16);
+		LAPIC_write (LAPIC_REG_LVT_TIMER, LAPIC_LVT_TIMER_ONESHOT | INT_LAPIC_timer);
+	}
+}
+
+static
+void clockevent_ISR (__attribute__ ((unused)) INT_index interrupt,
+                     __attribute__ ((unused)) uint64_t error)
+{
+	event_handler ();
+}
+
+
+// Extern functions
+
+void clockevent_initialize (clockevent_handler handler)
+{
+	event_handler = handler;
+	LAPIC_initialize ();
+
+	if (!LAPIC_present ()) {
+		mode = CLOCKEVENT_PIT;
+		pit_mult = rate_mult (PIT_FREQUENCY);
+		set_ISR (INT_PIT, &clockevent_ISR);
+		return;
+	}
+
+	set_ISR (INT_LAPIC_timer, &clockevent_ISR);
+	if (cpuid (1, 0).ecx & CPUID_1_ECX_TSC_DEADLINE) {
+		mode = CLOCKEVENT_TSC_DEADLINE;
+		tsc_mult = rate_mult (clock_tsc_hz ());
+	}
+	else {
+		mode = CLOCKEVENT_LAPIC_ONESHOT;
+		lapic_mult = rate_mult (calibrate_lapic_timer ());
+	}
+	setup_lvt ();
+}
+
+void clockevent_initialize_cpu (void)
+{
+	LAPIC_initialize ();
+	setup_lvt ();
+}
+
+void clockevent_program (uint64_t deadline_ns)
+{
+	uint64_t now = clock_now_ns ();
+	uint64_t delta_ns = (deadline_ns > now) ? deadline_ns - now : 0;
+
+	switch (mode) {
+	case CLOCKEVENT_TSC_DEADLINE:
+		// A deadline already in the past fires immediately
+		wrmsr (MSR_IA32_TSC_DEADLINE, rdtsc () + delta_ticks (delta_ns, tsc_mult) + 1);
+		break;
+
+	case CLOCKEVENT_LAPIC_ONESHOT: {
+		uint64_t ticks = delta_ticks (delta_ns, lapic_mult);
+		if (ticks == 0)
+			ticks = 1; // A zero count stops the timer
+		if (ticks > UINT32_MAX)
+			ticks = UINT32_MAX;
+		LAPIC_write (LAPIC_REG_TIMER_INITIAL, ticks);
+		break;
+	}
+
+	case CLOCKEVENT_PIT: {
+		uint64_t ticks = delta_ticks (delta_ns, pit_mult);
+		if (ticks == 0)
+			ticks = 1;
+		if (ticks > UINT16_MAX)
+			ticks = UINT16_MAX;
+		pit_channel0_oneshot (ticks);
+		IRQ_enable (IRQ_PIT);
+		break;
+	}
+	}
+}
+
+void clockevent_cancel (void)
+{
+	switch (mode) {
+	case CLOCKEVENT_TSC_DEADLINE:
+		wrmsr (MSR_IA32_TSC_DEADLINE, 0);
+		break;
+	case CLOCKEVENT_LAPIC_ONESHOT:
+		LAPIC_write (LAPIC_REG_TIMER_INITIAL, 0);
+		break;
+	case CLOCKEVENT_PIT:
+		IRQ_disable (IRQ_PIT);
+		break;
+	}
+}
+
+clockevent_mode clockevent_get_mode (void)
+{
+	return mode;
+}
+
+const char* clockevent_name (void)
+{
+	switch (mode) {
+	case CLOCKEVENT_TSC_DEADLINE:  return "LAPIC TSC-deadline";
+	case CLOCKEVENT_LAPIC_ONESHOT: return "LAPIC one-shot";
+	case CLOCKEVENT_PIT:           return "PIT one-shot";
+	}
+	return "none";
+}
@@ -0,0 +1,32 @@
+#ifndef CLOCKEVENT_H
+#define CLOCKEVENT_H
+
+#include <stdint.h>
+
+typedef enum {
+	CLOCKEVENT_TSC_DEADLINE,
+	CLOCKEVENT_LAPIC_ONESHOT,
+	CLOCKEVENT_PIT
+} clockevent_mode;
+
+typedef void (*clockevent_handler) (void);
+
+// Selects the best one-shot event device: the local APIC timer in TSC-deadline
+// mode, then the local APIC timer counting down, then PIT channel 0. Requires
+// clock_initialize. The handler runs in interrupt context when an event fires.
+void clockevent_initialize (clockevent_handler handler);
+
+// Sets up the local timer of an application processor in the mode chosen by
+// clockevent_initialize.
+void clockevent_initialize_cpu (void);
+
+// Deadlines are in the clock_now_ns timebase. Devices have a limited range, so
+// an event may fire before the deadline; the handler must check the time and
+// program the device again.
+void clockevent_program (uint64_t deadline_ns);
+void clockevent_cancel (void);
+
+clockevent_mode clockevent_get_mode (void);
+const char* clockevent_name (void);
+
+#endif
@@ -0,0 +1,76 @@
+#include "hpet.h"
+#include "acpi/acpi.h"
+#include <stddef.h>
+
+enum {
+	// Register offsets
+	HPET_CAPABILITIES  = 0x000,
+	HPET_CONFIGURATION = 0x010,
+	HPET_MAIN_COUNTER  = 0x0F0,
+
+	HPET_CAP_COUNT_SIZE = 1 << 13,
+	HPET_CONF_ENABLE    = 1 << 0,
+
+	// The specification caps the period at 100 ns
+	HPET_MAX_PERIOD_FS = 100000000
+};
+
+static volatile uint8_t* hpet_base;
+static uint64_t          period_fs;
+static bool              counter_64bit;
+
+static inline
+uint64_t hpet_read (uint32_t reg)
+{
+	return *(volatile uint64_t*) (hpet_base + reg);
+}
+
+static inline
+void hpet_write (uint32_t reg, uint64_t value)
+{
+	*(volatile uint64_t*) (hpet_base + reg) = value;
+}
+
+
+// Extern functions
+
+bool hpet_initialize (void)
+{
+	const acpi_hpet* table = (const acpi_hpet*) acpi_find_table ("HPET");
+	if (table == NULL || table->base_address.address_space != 0)
+		return false;
+
+	hpet_base = (volatile uint8_t*) (uintptr_t) table->base_address.address;
+	uint64_t capabilities = hpet_read (HPET_CAPABILITIES);
+	period_fs     = capabilities >> 32;
+	counter_64bit = capabilities & HPET_CAP_COUNT_SIZE;
+	if (period_fs == 0 || period_fs > HPET_MAX_PERIOD_FS) {
+		hpet_base = NULL;
+		return false;
+	}
+
+	hpet_write (HPET_CONFIGURATION, hpet_read (HPET_CONFIGURATION) | HPET_CONF_ENABLE);
+	return true;
+}
+
+bool hpet_present (void)
+{
+	return hpet_base != NULL;
+}
+
+bool hpet_counter_64bit (void)
+{
+	return counter_64bit;
+}
+
+uint64_t hpet_period_fs (void)
+{
+	return period_fs;
+}
+
+uint64_t hpet_read_counter (void)
+{
+	if (counter_64bit)
+		return hpet_read (HPET_MAIN_COUNTER);
+	return *(volatile uint32_t*) (hpet_base + HPET_MAIN_COUNTER);
+}
@@ -0,0 +1,16 @@
+#ifndef HPET_H
+#define HPET_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Locates the HPET through ACPI and starts its main counter. Returns false if
+// there is no usable HPET.
+bool hpet_initialize (void);
+
+bool hpet_present (void);
+bool hpet_counter_64bit (void);
+uint64_t hpet_period_fs (void);
+uint64_t hpet_read_counter (void);
+
+#endif
@@ -0,0 +1,202 @@
+#include "timer.h"
+#include "clock.h"
+#include "clockevent.h"
+#include "smp/cpu.h"
+#include "x86/control.h"
+#include <stddef.h>
+
+/* Each CPU owns a hierarchical timing wheel. Deadlines are rounded up to ticks
+ * of 2^TICK_SHIFT ns, and a tick value is read as WHEEL_LEVELS digits of
+ * WHEEL_BITS bits each. A timer lives on the level of the most significant
+ * digit in which its expiry tick differs from the wheel clock, in the slot
+ * given by its own digit on that level: level 0 slots hold timers expiring on
+ * exactly that tick, higher slots hold every expiry within their range.
+ *
+ * Every occupied slot therefore lies after the clock's digit on its level, and
+ * the first occupied slot of the lowest occupied level starts the earliest
+ * range that can contain an expiry. That is the next hardware deadline. When
+ * it is reached, a level 0 slot expires and a higher slot is cascaded: its
+ * timers are redistributed to lower levels relative to the new clock. Nothing
+ * is cascaded ahead of time, and the clock skips over empty stretches instead
+ * of stepping through them.
+ */
+
+enum {
+	TICK_SHIFT   = 10, // ~1 us
+	WHEEL_BITS   = 6,
+	WHEEL_SIZE   = 1 << WHEEL_BITS,
+	WHEEL_LEVELS = 10  // Enough digits for any deadline in ticks
+};
+
+typedef struct timer_wheel {
+	uint64_t clk;        // Every timer expiring at or before clk has run
+	uint64_t programmed; // Tick the event device is set for, or UINT64_MAX
+	uint64_t occupied [WHEEL_LEVELS];
+	timer*   slots [WHEEL_LEVELS] [WHEEL_SIZE];
+} timer_wheel;
+
+static DEFINE_PER_CPU (timer_wheel, cpu_wheel);
+
+static inline
+uint32_t level_shift (uint32_t level)
+{
+	return level * WHEEL_BITS;
+}
+
+static inline
+uint32_t digit (uint64_t tick, uint32_t level)
+{
+	return (tick >> level_shift (level)) & (WHEEL_SIZE - 1);
+}
+
+static inline
+uint64_t deadline_tick (uint64_t deadline_ns)
+{
+	return (deadline_ns >> TICK_SHIFT) + ((deadline_ns & ((1 << TICK_SHIFT) - 1)) != 0);
+}
+
+static
+void enqueue (timer_wheel* wheel, timer* t)
+{
+	uint64_t differing = t->expires ^ wheel->clk;
+	uint32_t level = (differing == 0) ? 0 : (63 - __builtin_clzll (differing)) / WHEEL_BITS;
+	uint32_t slot  = digit (t->expires, level);
+
+	timer** head = &wheel->slots [level] [slot];
+	t->next  = *head;
+	t->pprev = head;
+	if (*head != NULL)
+		(*head)->pprev = &t->next;
+	*head = t;
+	t->slot = level * WHEEL_SIZE + slot;
+	wheel->occupied [level] |= (uint64_t) 1 << slot;
+}
+
+static
+void dequeue (timer_wheel* wheel, timer* t)
+{
+	*t->pprev = t->next;
+	if (t->next != NULL)
+		t->next->pprev = t->pprev;
+
+	uint32_t level = t->slot / WHEEL_SIZE;
+	uint32_t slot  = t->slot % WHEEL_SIZE;
+	if (wheel->slots [level] [slot] == NULL)
+		wheel->occupied [level] &= ~((uint64_t) 1 << slot);
+
+	t->next  = NULL;
+	t->pprev = NULL;
+}
+
+static
+uint64_t next_tick (const timer_wheel* wheel, uint32_t* level_out)
+{
+	for (uint32_t level = 0; level < WHEEL_LEVELS; ++level) {
+		if (wheel->occupied [level] == 0)
+			continue;
+		uint32_t shift = level_shift (level);
+		uint32_t slot  = __builtin_ctzll (wheel->occupied [level]);
+		uint64_t window = wheel->clk >> (shift + WHEEL_BITS) << (shift + WHEEL_BITS);
+		*level_out = level;
+		return window | ((uint64_t) slot << shift);
+	}
+	return UINT64_MAX;
+}
+
+static
+void run_wheel (timer_wheel* wheel, uint64_t now)
+{
+	for (;;) {
+		uint32_t level;
+		uint64_t next = next_tick (wheel, &level);
+		if (next > now)
+			break;
+
+		wheel->clk = next;
+		timer** head = &wheel->slots [level] [digit (next, level)];
+		while (*head != NULL) {
+			timer* t = *head;
+			dequeue (wheel, t);
+			if (t->expires == wheel->clk)
+				t->function (t->arg);
+			else
+				enqueue (wheel, t);
+		}
+	}
+
+	if (now > wheel->clk)
+		wheel->clk = now;
+}
+
+static
+void reprogram (timer_wheel* wheel)
+{
+	uint32_t level;
+	uint64_t next = next_tick (wheel, &level);
+	if (next == wheel->programmed)
+		return;
+
+	wheel->programmed = next;
+	if (next == UINT64_MAX)
+		clockevent_cancel ();
+	else
+		clockevent_program (next << TICK_SHIFT);
+}
+
+static
+void timer_expire (void)
+{
+	timer_wheel* wheel = this_cpu_ptr (cpu_wheel);
+	wheel->programmed = UINT64_MAX;
+	run_wheel (wheel, clock_now_ns () >> TICK_SHIFT);
+	reprogram (wheel);
+}
+
+
+// Extern functions
+
+void timers_initialize (void)
+{
+	for (uint32_t cpu = 0; cpu < MAX_CPUS; ++cpu)
+		per_cpu_ptr (cpu_wheel, cpu)->programmed = UINT64_MAX;
+	clockevent_initialize (&timer_expire);
+}
+
+void timer_arm (timer* t, uint64_t deadline_ns)
+{
+	uint64_t flags = save_flags_cli ();
+	uint32_t cpu = cpu_index ();
+	timer_wheel* wheel = this_cpu_ptr (cpu_wheel);
+	if (timer_pending (t))
+		dequeue (per_cpu_ptr (cpu_wheel, t->cpu), t);
+
+	t->deadline_ns = deadline_ns;
+	t->expires     = deadline_tick (deadline_ns);
+	if (t->expires <= wheel->clk)
+		t->expires = wheel->clk + 1;
+	t->cpu = cpu;
+	enqueue (wheel, t);
+
+	reprogram (wheel);
+	restore_flags (flags);
+}
+
+bool timer_cancel (timer* t)
+{
+	uint64_t flags = save_flags_cli ();
+	bool was_pending = timer_pending (t);
+	if (was_pending) {
+		timer_wheel* wheel = per_cpu_ptr (cpu_wheel, t->cpu);
+		dequeue (wheel, t);
+		reprogram (wheel);
+	}
+	restore_flags (flags);
+	return was_pending;
+}
+
+uint64_t timer_next_deadline (void)
+{
+	uint32_t level;
+	uint64_t next = next_tick (this_cpu_ptr (cpu_wheel), &level);
+	return (next == UINT64_MAX) ? UINT64_MAX : next << TICK_SHIFT;
+}
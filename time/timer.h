@@ -0,0 +1,58 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef void (*timer_function) (void* arg);
+
+typedef struct timer {
+	struct timer*  next;
+	struct timer** pprev; // NULL unless pending
+	uint64_t       deadline_ns;
+	uint64_t       expires; // Wheel tick
+	timer_function function;
+	void*          arg;
+	uint16_t       cpu;
+	uint16_t       slot;
+} timer;
+
+static inline
+timer make_timer (timer_function function, void* arg)
+{
+	return (timer) {
+		.next        = 0,
+		.pprev       = 0,
+		.deadline_ns = 0,
+		.expires     = 0,
+		.function    = function,
+		.arg         = arg,
+		.cpu         = 0,
+		.slot        = 0
+	};
+}
+
+static inline
+bool timer_pending (const timer* t)
+{
+	return t->pprev != 0;
+}
+
+// Sets up the event device. There is no periodic tick: the device is only
+// programmed for the next deadline of the calling CPU's timer wheel.
+void timers_initialize (void);
+
+// Timers are kept in a per-CPU hierarchical timing wheel; arming and
+// cancelling take constant time. A timer is armed on the calling CPU and must
+// be cancelled or re-armed on the same CPU. Timer functions run in interrupt
+// context and may re-arm their own timer. Arming a pending timer moves it to
+// the new deadline.
+void timer_arm (timer* t, uint64_t deadline_ns);
+bool timer_cancel (timer* t);
+
+// Lower bound on the earliest pending deadline of the calling CPU, or
+// UINT64_MAX if there is none. Timers more than one wheel slot away are only
+// known to the granularity of their slot.
+uint64_t timer_next_deadline (void);
+
+#endif
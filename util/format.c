@@ -1,14 +1,22 @@
 #include "format.h"
 #include <stddef.h>
 
-static inline
-char digit_to_ascii (uint_fast8_t digit)
-{
-	if (digit < 10)
-		return digit + '0';
-	else
-		return (digit - 10) + 'A';
-}
+static const char digit_chars [] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+// "00" to "99", so base 10 takes one division per two digits
+static const char digit_pairs [200] =
+	"00010203040506070809" "10111213141516171819" "20212223242526272829"
+	"30313233343536373839" "40414243444546474849" "50515253545556575859"
+	"60616263646566676869" "70717273747576777879" "80818283848586878889"
+	"90919293949596979899";
+
+static const uint64_t powers_of_10 [] = {
+	1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull,
+	100000000ull, 1000000000ull, 10000000000ull, 100000000000ull,
+	1000000000000ull, 10000000000000ull, 100000000000000ull,
+	1000000000000000ull, 10000000000000000ull, 100000000000000000ull,
+	1000000000000000000ull, 10000000000000000000ull
+};
 
 static inline
 void creverse (char* begin, char* end)
@@ -27,61 +35,80 @@ void creverse (char* begin, char* end)
 }
 
 static inline
-size_t fmt_strlen (const char* str)
+uint32_t bit_length (uint64_t value)
 {
-	size_t len = 0;
-	while (str [len] != '\0')
-		++len;
-	return len;
+	return 64 - __builtin_clzll (value | 1);
 }
 
-
-// Extern functions
+// log10 (2) is about 1233/4096, which gives the count or one less
+static inline
+uint32_t decimal_length (uint64_t value)
+{
+	if (value < 10)
+		return 1;
+	uint32_t estimate = bit_length (value) * 1233 >> 12;
+	return estimate + (value >= powers_of_10 [estimate]);
+}
 
-char* numsep (char* bufstr, char sep)
+// -Os would compile the constant divisions to div instructions; these are
+// the reciprocal multiplications -O2 uses instead
+static inline
+uint64_t divide_100 (uint64_t value)
 {
-	size_t n = fmt_strlen (bufstr);
-	size_t m = n + (n - 1)/3;
-	char* src = bufstr + n - 1;
-	char* dst = bufstr + m - 1;
-	for (int i = 0; src != dst;) {
-		if (i == 3) {
-			i = 0;
-			*dst = sep;
-		}
-		else {
-			i = i + 1;
-			*dst = *src;
-			--src;
-		}
-		--dst;
-	}
-	bufstr [m] = '\0';
-	return bufstr;
+	return ((unsigned __int128) (value >> 2) * 0x28F5C28F5C28F5C3) >> 66;
 }
 
-char* format_int (char* buffer, int64_t value, uint_fast8_t mincol, uint_fast8_t base)
+static inline
+uint64_t divide_1000 (uint64_t value)
 {
-	if (value < 0) {
-		char* numstring = format_uint (buffer + 1, -value, mincol, base);
-		--numstring;
-		numstring [0] = '-';
-		return numstring;
+	return ((unsigned __int128) (value >> 3) * 0x20C49BA5E353F7CF) >> 68;
+}
+
+static inline
+char* put_pair (char* end, uint32_t pair)
+{
+	end -= 2;
+	end [0] = digit_pairs [2 * pair];
+	end [1] = digit_pairs [2 * pair + 1];
+	return end;
+}
+
+// Writes the digits of value so that they end at end
+static inline
+void put_decimal (char* end, uint64_t value)
+{
+	while (value >= 100) {
+		uint64_t quotient = divide_100 (value);
+		end = put_pair (end, value - quotient * 100);
+		value = quotient;
 	}
+	if (value >= 10)
+		put_pair (end, value);
 	else
-		return format_uint (buffer, value, mincol, base);
+		end [-1] = '0' + value;
 }
 
-char* format_uint (char* buffer, uint64_t value, uint_fast8_t mincol, uint_fast8_t base)
+static
+char* format_pow2 (char* buffer, uint64_t value, uint_fast8_t mincol, uint32_t shift)
+{
+	uint32_t length = (bit_length (value) + shift - 1) / shift;
+	if (length < mincol)
+		length = mincol;
+	uint64_t mask = ((uint64_t) 1 << shift) - 1;
+	for (char* cursor = buffer + length; cursor != buffer; value >>= shift)
+		*--cursor = digit_chars [value & mask];
+	buffer [length] = '\0';
+	return buffer;
+}
+
+static
+char* format_generic (char* buffer, uint64_t value, uint_fast8_t mincol, uint_fast8_t base)
 {
 	char* cursor = buffer;
 
 	do {
-		uint64_t div = value / base;
-		uint64_t mod = value % base;
-		*cursor = digit_to_ascii (mod);
-		value = div;
-		++cursor;
+		*cursor++ = digit_chars [value % base];
+		value /= base;
 	}
 	while (value != 0);
 
@@ -92,3 +119,57 @@ char* format_uint (char* buffer, uint64_t value, uint_fast8_t mincol, uint_fast8
 
 	return buffer;
 }
+
+
+// Extern functions
+
+char* format_int (char* buffer, int64_t value, uint_fast8_t mincol, uint_fast8_t base)
+{
+	if (value < 0) {
+		char* numstring = format_uint (buffer + 1, -value, mincol, base);
+		--numstring;
+		numstring [0] = '-';
+		return numstring;
+	}
+	else
+		return format_uint (buffer, value, mincol, base);
+}
+
+char* format_uint (char* buffer, uint64_t value, uint_fast8_t mincol, uint_fast8_t base)
+{
+	if (base == 10) {
+		uint32_t length = decimal_length (value);
+		uint32_t zeros = (length < mincol) ? mincol - length : 0;
+		for (uint32_t i = 0; i < zeros; ++i)
+			buffer [i] = '0';
+		put_decimal (buffer + zeros + length, value);
+		buffer [zeros + length] = '\0';
+		return buffer;
+	}
+	if ((base & (base - 1)) == 0)
+		return format_pow2 (buffer, value, mincol, __builtin_ctz (base));
+	return format_generic (buffer, value, mincol, base);
+}
+
+size_t format_decimal (char* buffer, uint64_t value, char sep)
+{
+	uint32_t digits = decimal_length (value);
+	if (sep == '\0' || digits <= 3) {
+		put_decimal (buffer + digits, value);
+		return digits;
+	}
+
+	// Whole groups of three from the right, then the leading group
+	uint32_t length = digits + (digits - 1) / 3;
+	char* end = buffer + length;
+	while (value >= 1000) {
+		uint64_t quotient = divide_1000 (value);
+		uint32_t group = value - quotient * 1000;
+		value = quotient;
+		end = put_pair (end, group % 100);
+		*--end = '0' + group / 100;
+		*--end = sep;
+	}
+	put_decimal (end, value);
+	return length;
+}
@@ -1,10 +1,14 @@
 #ifndef FORMAT_H
 #define FORMAT_H
 
+#include <stddef.h>
 #include <stdint.h>
 
-char* numsep (char* bufstr, char sep);
 char* format_int (char* buffer, int64_t value, uint_fast8_t mincol, uint_fast8_t base);
 char* format_uint (char* buffer, uint64_t value, uint_fast8_t mincol, uint_fast8_t base);
 
+// Writes value in decimal, with sep between groups of three digits unless it
+// is '\0'. Nothing is terminated; returns the length, at most 26.
+size_t format_decimal (char* buffer, uint64_t value, char sep);
+
 #endif
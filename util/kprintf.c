@@ -0,0 +1,288 @@
+#include "kprintf.h"
+#include "format.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+enum {
+	DIGITS_MAX = 32 // 22 octal digits, or 20 decimal ones and 6 separators
+};
+
+typedef struct output {
+	char*         buffer;
+	size_t        capacity; // Excluding the terminator
+	size_t        used;
+	size_t        total;
+	kprintf_sink* sink;     // NULL: cut at capacity
+} output;
+
+typedef struct spec {
+	bool     left;
+	bool     zero;
+	bool     group;
+	bool     wide;      // 64-bit argument
+	uint32_t width;
+	int32_t  precision; // -1 if none
+} spec;
+
+static
+void flush (output* out)
+{
+	if (out->sink != NULL && out->used != 0) {
+		out->buffer [out->used] = '\0';
+		out->sink->write (out->sink, out->buffer, out->used);
+	}
+	out->used = 0;
+}
+
+static inline
+void emit (output* out, char c)
+{
+	++out->total;
+	if (out->used == out->capacity) {
+		if (out->sink == NULL)
+			return;
+		flush (out);
+	}
+	out->buffer [out->used++] = c;
+}
+
+static
+void emit_repeat (output* out, char c, size_t count)
+{
+	for (; count != 0; --count)
+		emit (out, c);
+}
+
+static
+void emit_string (output* out, const char* str, size_t length)
+{
+	for (size_t i = 0; i < length; ++i)
+		emit (out, str [i]);
+}
+
+static inline
+size_t padding (const spec* spec, size_t length)
+{
+	return spec->width > length ? spec->width - length : 0;
+}
+
+static
+void emit_number (output* out, const spec* spec, uint64_t value, bool negative,
+                  uint32_t base, bool upper, const char* prefix)
+{
+	static const char lower_digits [] = "0123456789abcdef";
+	static const char upper_digits [] = "0123456789ABCDEF";
+	const char* set = upper ? upper_digits : lower_digits;
+
+	char digits [DIGITS_MAX];
+	char* end = digits + DIGITS_MAX;
+	char* p = end;
+	if (base == 10) {
+		char grouped [DIGITS_MAX];
+		size_t length = format_decimal (grouped, value, spec->group ? ',' : '\0');
+		p -= length;
+		for (size_t i = 0; i < length; ++i)
+			p [i] = grouped [i];
+	}
+	else {
+		uint32_t shift = (base == 16) ? 4 : 3;
+		do {
+			*--p = set [value & (base - 1)];
+			value >>= shift;
+		}
+		while (value != 0);
+	}
+
+	size_t ndigits = end - p;
+	if (spec->precision == 0 && ndigits == 1 && *p == '0')
+		ndigits = 0;
+	size_t precision = spec->precision > 0 ? (size_t) spec->precision : 0;
+	size_t zeros = precision > ndigits ? precision - ndigits : 0;
+	size_t prefix_length = 0;
+	while (prefix [prefix_length] != '\0')
+		++prefix_length;
+	size_t pad = padding (spec, negative + prefix_length + zeros + ndigits);
+
+	bool zero_pad = spec->zero && !spec->left && spec->precision < 0;
+	if (!spec->left && !zero_pad)
+		emit_repeat (out, ' ', pad);
+	if (negative)
+		emit (out, '-');
+	emit_string (out, prefix, prefix_length);
+	if (zero_pad)
+		emit_repeat (out, '0', pad);
+	emit_repeat (out, '0', zeros);
+	emit_string (out, end - ndigits, ndigits);
+	if (spec->left)
+		emit_repeat (out, ' ', pad);
+}
+
+static
+void emit_text (output* out, const spec* spec, const char* str)
+{
+	if (str == NULL)
+		str = "(null)";
+	size_t length = 0;
+	while (str [length] != '\0' && (spec->precision < 0 || length < (size_t) spec->precision))
+		++length;
+	size_t pad = padding (spec, length);
+	if (!spec->left)
+		emit_repeat (out, ' ', pad);
+	emit_string (out, str, length);
+	if (spec->left)
+		emit_repeat (out, ' ', pad);
+}
+
+static
+void format_output (output* out, const char* fmt, va_list args)
+{
+	while (*fmt != '\0') {
+		if (*fmt != '%') {
+			emit (out, *fmt++);
+			continue;
+		}
+		++fmt;
+
+		spec spec = {
+			.left = false, .zero = false, .group = false, .wide = false,
+			.width = 0, .precision = -1
+		};
+		for (;; ++fmt) {
+			if (*fmt == '-')
+				spec.left = true;
+			else if (*fmt == '0')
+				spec.zero = true;
+			else if (*fmt == '\'')
+				spec.group = true;
+			else
+				break;
+		}
+		if (*fmt == '*') {
+			int width = va_arg (args, int);
+			spec.left |= (width < 0);
+			spec.width = (width < 0) ? -width : width;
+			++fmt;
+		}
+		else
+			for (; *fmt >= '0' && *fmt <= '9'; ++fmt)
+				spec.width = spec.width * 10 + (*fmt - '0');
+		if (*fmt == '.') {
+			++fmt;
+			spec.precision = 0;
+			if (*fmt == '*') {
+				int precision = va_arg (args, int);
+				spec.precision = (precision < 0) ? -1 : precision;
+				++fmt;
+			}
+			else
+				for (; *fmt >= '0' && *fmt <= '9'; ++fmt)
+					spec.precision = spec.precision * 10 + (*fmt - '0');
+		}
+		while (*fmt == 'l' || *fmt == 'z') {
+			spec.wide = true;
+			++fmt;
+		}
+
+		switch (*fmt) {
+		case 'd':
+		case 'i': {
+			int64_t value = spec.wide ? va_arg (args, long long) : va_arg (args, int);
+			uint64_t magnitude = (value < 0) ? -(uint64_t) value : (uint64_t) value;
+			emit_number (out, &spec, magnitude, value < 0, 10, false, "");
+			break;
+		}
+		case 'u':
+		case 'x':
+		case 'X':
+		case 'o': {
+			uint64_t value = spec.wide ? va_arg (args, unsigned long long) : va_arg (args, unsigned);
+			uint32_t base = (*fmt == 'u') ? 10 : (*fmt == 'o') ? 8 : 16;
+			emit_number (out, &spec, value, false, base, *fmt == 'X', "");
+			break;
+		}
+		case 'p':
+			spec.precision = 16;
+			emit_number (out, &spec, (uintptr_t) va_arg (args, void*), false, 16, false, "0x");
+			break;
+		case 's':
+			emit_text (out, &spec, va_arg (args, const char*));
+			break;
+		case 'c': {
+			char c = va_arg (args, int);
+			spec.precision = -1;
+			emit_repeat (out, ' ', spec.left ? 0 : padding (&spec, 1));
+			emit (out, c);
+			emit_repeat (out, ' ', spec.left ? padding (&spec, 1) : 0);
+			break;
+		}
+		case '%':
+			emit (out, '%');
+			break;
+		default:
+			// Unknown conversions are printed as they are
+			emit (out, '%');
+			if (*fmt == '\0')
+				return;
+			emit (out, *fmt);
+			break;
+		}
+		++fmt;
+	}
+}
+
+
+// Extern functions
+
+size_t kprintf (kprintf_sink* sink, const char* fmt, ...)
+{
+	va_list args;
+	va_start (args, fmt);
+	size_t total = kvprintf (sink, fmt, args);
+	va_end (args);
+	return total;
+}
+
+size_t kvprintf (kprintf_sink* sink, const char* fmt, va_list args)
+{
+	char buffer [KPRINTF_CHUNK + 1];
+	output out = {
+		.buffer   = buffer,
+		.capacity = KPRINTF_CHUNK,
+		.used     = 0,
+		.total    = 0,
+		.sink     = sink
+	};
+	va_list copy;
+	va_copy (copy, args);
+	format_output (&out, fmt, copy);
+	va_end (copy);
+	flush (&out);
+	return out.total;
+}
+
+size_t ksnprintf (char* buffer, size_t size, const char* fmt, ...)
+{
+	va_list args;
+	va_start (args, fmt);
+	size_t total = kvsnprintf (buffer, size, fmt, args);
+	va_end (args);
+	return total;
+}
+
+size_t kvsnprintf (char* buffer, size_t size, const char* fmt, va_list args)
+{
+	output out = {
+		.buffer   = buffer,
+		.capacity = size ? size - 1 : 0,
+		.used     = 0,
+		.total    = 0,
+		.sink     = NULL
+	};
+	va_list copy;
+	va_copy (copy, args);
+	format_output (&out, fmt, copy);
+	va_end (copy);
+	if (size != 0)
+		buffer [out.used] = '\0';
+	return out.total;
+}
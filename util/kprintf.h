@@ -0,0 +1,41 @@
+#ifndef KPRINTF_H
+#define KPRINTF_H
+
+#include <stdarg.h>
+#include <stddef.h>
+
+/* printf-style formatting in one pass over the format string. Supported:
+ *
+ *   %[flags][width][length]conversion
+ *   flags       '-' left-justify, '0' zero-pad, '\'' group thousands with ','
+ *   width       digits or '*'
+ *   length      'l', 'll', 'z' (all 64-bit here)
+ *   conversion  d i u x X o c s p %
+ *
+ * %p prints "0x" and 16 hex digits. kprintf collects the output in a buffer
+ * on the stack and hands it to the sink once per call, or once per
+ * KPRINTF_CHUNK bytes for longer output; ksnprintf writes straight into the
+ * destination.
+ */
+
+enum {
+	KPRINTF_CHUNK = 160
+};
+
+// data is always terminated at data [length]
+typedef struct kprintf_sink {
+	void (*write) (struct kprintf_sink* sink, const char* data, size_t length);
+} kprintf_sink;
+
+// Both return the length of the whole output
+__attribute__ ((format (printf, 2, 3)))
+size_t kprintf (kprintf_sink* sink, const char* fmt, ...);
+size_t kvprintf (kprintf_sink* sink, const char* fmt, va_list args);
+
+// Like snprintf: the output is cut to fit size - 1 bytes and terminated
+// (unless size is 0), and the length it would have had is returned
+__attribute__ ((format (printf, 3, 4)))
+size_t ksnprintf (char* buffer, size_t size, const char* fmt, ...);
+size_t kvsnprintf (char* buffer, size_t size, const char* fmt, va_list args);
+
+#endif
@@ -0,0 +1,340 @@
+#include "mem.h"
+#include "x86/cpuid.h"
+#include <stdbool.h>
+
+// GCC recognises the loops below as memcpy and memset, and would compile
+// them into calls to the functions they are part of
+#define NO_LIBCALLS __attribute__ ((optimize ("no-tree-loop-distribute-patterns")))
+
+enum {
+	SHORT_COPY = 64, // Below this, overlapping moves beat starting a rep
+
+	CACHE_FALLBACK = 1 << 20,
+
+	// CPUID.04H and CPUID.8000001DH
+	CACHE_TYPE_MASK = 0x1f
+};
+
+typedef uint64_t __attribute__ ((may_alias, aligned (1))) unaligned_u64;
+typedef uint32_t __attribute__ ((may_alias, aligned (1))) unaligned_u32;
+typedef uint16_t __attribute__ ((may_alias, aligned (1))) unaligned_u16;
+
+typedef struct mem_config {
+	mem_strategy copy;
+	mem_strategy set;
+	bool         short_rep;   // rep movsb is fast from the first byte
+	size_t       nontemporal; // 0 if never
+} mem_config;
+
+// All zero until mem_initialize, which is MEM_LOOP and never non-temporal
+static mem_config config;
+
+static inline
+uint64_t splat (int c)
+{
+	return (uint8_t) c * 0x0101010101010101ull;
+}
+
+// Sizes of the caches described by a leaf in the format of CPUID.04H; the
+// largest one wins
+static
+size_t largest_cache (uint32_t leaf)
+{
+	size_t largest = 0;
+	for (uint32_t index = 0;; ++index) {
+		cpuid_result r = cpuid (leaf, index);
+		if ((r.eax & CACHE_TYPE_MASK) == 0)
+			break;
+		size_t ways       = (r.ebx >> 22) + 1;
+		size_t partitions = ((r.ebx >> 12) & 0x3ff) + 1;
+		size_t line       = (r.ebx & 0xfff) + 1;
+		size_t sets       = (size_t) r.ecx + 1;
+		size_t size = ways * partitions * line * sets;
+		if (size > largest)
+			largest = size;
+	}
+	return largest;
+}
+
+static
+size_t last_level_cache (void)
+{
+	size_t size = 0;
+	if (cpuid_max_extended_leaf () >= 0x8000001D
+	 && (cpuid (0x80000001, 0).ecx & CPUID_80000001_ECX_TOPOEXT))
+		size = largest_cache (0x8000001D);
+	if (size == 0 && cpuid_max_leaf () >= 4)
+		size = largest_cache (4);
+	return size != 0 ? size : CACHE_FALLBACK;
+}
+
+static inline
+void rep_movsb (void* dst, const void* src, size_t n)
+{
+	__asm__ volatile ("rep movsb" : "+D" (dst), "+S" (src), "+c" (n) :: "memory");
+}
+
+static inline
+void rep_stosb (void* dst, uint8_t value, size_t n)
+{
+	__asm__ volatile ("rep stosb" : "+D" (dst), "+c" (n) : "a" (value) : "memory");
+}
+
+static
+NO_LIBCALLS
+void copy_loop (uint8_t* dst, const uint8_t* src, size_t n)
+{
+	for (; n >= 8; n -= 8, dst += 8, src += 8)
+		*(unaligned_u64*) dst = *(const unaligned_u64*) src;
+	for (; n != 0; --n)
+		*dst++ = *src++;
+}
+
+static
+NO_LIBCALLS
+void copy_backward (uint8_t* dst, const uint8_t* src, size_t n)
+{
+	for (; n >= 8; n -= 8)
+		*(unaligned_u64*) (dst + n - 8) = *(const unaligned_u64*) (src + n - 8);
+	for (; n != 0; --n)
+		dst [n - 1] = src [n - 1];
+}
+
+static
+void copy_rep_qword (uint8_t* dst, const uint8_t* src, size_t n)
+{
+	size_t words = n / 8;
+	__asm__ volatile ("rep movsq" : "+D" (dst), "+S" (src), "+c" (words) :: "memory");
+	rep_movsb (dst, src, n & 7);
+}
+
+// The destination is aligned with ordinary stores first, since movnti to a
+// split line is slow. Fences, so the stores are ordered before anything after.
+static
+NO_LIBCALLS
+void copy_nontemporal (uint8_t* dst, const uint8_t* src, size_t n)
+{
+	for (; n != 0 && ((uintptr_t) dst & 7) != 0; --n)
+		*dst++ = *src++;
+	for (; n >= 8; n -= 8, dst += 8, src += 8)
+		__asm__ volatile ("movnti %1, %0"
+		                  : "=m" (*(uint64_t*) dst) : "r" (*(const unaligned_u64*) src));
+	for (; n != 0; --n)
+		*dst++ = *src++;
+	__asm__ volatile ("sfence" ::: "memory");
+}
+
+// Every length below SHORT_COPY in at most two moves of each width, the last
+// overlapping the one before where the length is not a multiple
+static inline
+__attribute__ ((always_inline))
+void copy_short (uint8_t* dst, const uint8_t* src, size_t n)
+{
+	if (n >= 8) {
+		uint64_t last = *(const unaligned_u64*) (src + n - 8);
+		for (size_t i = 0; i + 8 < n; i += 8)
+			*(unaligned_u64*) (dst + i) = *(const unaligned_u64*) (src + i);
+		*(unaligned_u64*) (dst + n - 8) = last;
+	}
+	else if (n >= 4) {
+		uint32_t first = *(const unaligned_u32*) src;
+		*(unaligned_u32*) (dst + n - 4) = *(const unaligned_u32*) (src + n - 4);
+		*(unaligned_u32*) dst = first;
+	}
+	else if (n >= 2) {
+		uint16_t first = *(const unaligned_u16*) src;
+		*(unaligned_u16*) (dst + n - 2) = *(const unaligned_u16*) (src + n - 2);
+		*(unaligned_u16*) dst = first;
+	}
+	else if (n == 1)
+		*dst = *src;
+}
+
+static
+NO_LIBCALLS
+void set_loop (uint8_t* dst, int c, size_t n)
+{
+	uint64_t value = splat (c);
+	for (; n >= 8; n -= 8, dst += 8)
+		*(unaligned_u64*) dst = value;
+	for (; n != 0; --n)
+		*dst++ = (uint8_t) c;
+}
+
+static
+void set_rep_qword (uint8_t* dst, int c, size_t n)
+{
+	size_t words = n / 8;
+	__asm__ volatile ("rep stosq" : "+D" (dst), "+c" (words) : "a" (splat (c)) : "memory");
+	rep_stosb (dst, (uint8_t) c, n & 7);
+}
+
+static
+NO_LIBCALLS
+void set_nontemporal (uint8_t* dst, int c, size_t n)
+{
+	uint64_t value = splat (c);
+	for (; n != 0 && ((uintptr_t) dst & 7) != 0; --n)
+		*dst++ = (uint8_t) c;
+	for (; n >= 8; n -= 8, dst += 8)
+		__asm__ volatile ("movnti %1, %0" : "=m" (*(uint64_t*) dst) : "r" (value));
+	for (; n != 0; --n)
+		*dst++ = (uint8_t) c;
+	__asm__ volatile ("sfence" ::: "memory");
+}
+
+static inline
+__attribute__ ((always_inline))
+void set_short (uint8_t* dst, int c, size_t n)
+{
+	uint64_t value = splat (c);
+	if (n >= 8) {
+		for (size_t i = 0; i + 8 < n; i += 8)
+			*(unaligned_u64*) (dst + i) = value;
+		*(unaligned_u64*) (dst + n - 8) = value;
+	}
+	else if (n >= 4) {
+		*(unaligned_u32*) dst = (uint32_t) value;
+		*(unaligned_u32*) (dst + n - 4) = (uint32_t) value;
+	}
+	else if (n >= 2) {
+		*(unaligned_u16*) dst = (uint16_t) value;
+		*(unaligned_u16*) (dst + n - 2) = (uint16_t) value;
+	}
+	else if (n == 1)
+		*dst = (uint8_t) c;
+}
+
+static inline
+bool use_nontemporal (size_t n)
+{
+	return config.nontemporal != 0 && n >= config.nontemporal;
+}
+
+
+// Extern functions
+
+void mem_initialize (void)
+{
+	cpuid_result features = {.eax = 0, .ebx = 0, .ecx = 0, .edx = 0};
+	if (cpuid_max_leaf () >= 7)
+		features = cpuid (7, 0);
+
+	if (features.ebx & CPUID_7_EBX_ERMS) {
+		config.copy = MEM_REP_BYTE;
+		config.set  = MEM_REP_BYTE;
+	}
+	else {
+		config.copy = MEM_REP_QWORD;
+		config.set  = MEM_REP_QWORD;
+	}
+	config.short_rep   = (features.edx & CPUID_7_EDX_FSRM) != 0;
+	config.nontemporal = last_level_cache ();
+}
+
+mem_strategy mem_copy_strategy (void)
+{
+	return config.copy;
+}
+
+mem_strategy mem_set_strategy (void)
+{
+	return config.set;
+}
+
+size_t mem_nontemporal_threshold (void)
+{
+	return config.nontemporal;
+}
+
+const char* mem_strategy_name (mem_strategy strategy)
+{
+	switch (strategy) {
+	case MEM_LOOP:        return "loop";
+	case MEM_REP_QWORD:   return "rep movsq/stosq";
+	case MEM_REP_BYTE:    return "rep movsb/stosb";
+	case MEM_NONTEMPORAL: return "movnti";
+	default:              return "?";
+	}
+}
+
+void mem_copy_with (mem_strategy strategy, void* dst, const void* src, size_t n)
+{
+	switch (strategy) {
+	case MEM_REP_QWORD:   copy_rep_qword (dst, src, n);   break;
+	case MEM_REP_BYTE:    rep_movsb (dst, src, n);        break;
+	case MEM_NONTEMPORAL: copy_nontemporal (dst, src, n); break;
+	default:              copy_loop (dst, src, n);        break;
+	}
+}
+
+void mem_set_with (mem_strategy strategy, void* dst, int c, size_t n)
+{
+	switch (strategy) {
+	case MEM_REP_QWORD:   set_rep_qword (dst, c, n);         break;
+	case MEM_REP_BYTE:    rep_stosb (dst, (uint8_t) c, n);   break;
+	case MEM_NONTEMPORAL: set_nontemporal (dst, c, n);       break;
+	default:              set_loop (dst, c, n);              break;
+	}
+}
+
+void* memcpy (void* restrict dst, const void* restrict src, size_t n)
+{
+	if (n < SHORT_COPY && !config.short_rep)
+		copy_short (dst, src, n);
+	else if (use_nontemporal (n))
+		copy_nontemporal (dst, src, n);
+	else
+		mem_copy_with (config.copy, dst, src, n);
+	return dst;
+}
+
+void* memset (void* dst, int c, size_t n)
+{
+	if (n < SHORT_COPY)
+		set_short (dst, c, n);
+	else if (use_nontemporal (n))
+		set_nontemporal (dst, c, n);
+	else
+		mem_set_with (config.set, dst, c, n);
+	return dst;
+}
+
+// Forwards, the string instructions copy correctly onto a destination below
+// the source; backwards, a loop is faster than rep with the direction flag set
+void* memmove (void* dst, const void* src, size_t n)
+{
+	if ((uintptr_t) dst - (uintptr_t) src >= n) {
+		if (n < SHORT_COPY)
+			copy_short (dst, src, n);
+		else
+			mem_copy_with (config.copy, dst, src, n);
+	}
+	else
+		copy_backward (dst, src, n);
+	return dst;
+}
+
+void clear_page (void* page)
+{
+	mem_set_with (config.set, page, 0, MEM_PAGE_SIZE);
+}
+
+void clear_page_nontemporal (void* page)
+{
+	set_nontemporal (page, 0, MEM_PAGE_SIZE);
+}
+
+void copy_page (void* dst, const void* src)
+{
+	mem_copy_with (config.copy, dst, src, MEM_PAGE_SIZE);
+}
+
+void clear_pages (void* first, size_t count)
+{
+	size_t bytes = count * MEM_PAGE_SIZE;
+	if (use_nontemporal (bytes))
+		set_nontemporal (first, 0, bytes);
+	else
+		mem_set_with (config.set, first, 0, bytes);
+}
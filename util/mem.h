@@ -0,0 +1,61 @@
+#ifndef MEM_H
+#define MEM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* memcpy, memset and memmove for the kernel, and page-sized variants. The
+ * kernel is built without SSE, so the strategies are string instructions and
+ * 64-bit general-purpose stores:
+ *
+ *   MEM_LOOP         8 bytes per move in a loop
+ *   MEM_REP_QWORD    rep movsq / rep stosq, then the odd bytes
+ *   MEM_REP_BYTE     rep movsb / rep stosb, which microcode widens on CPUs
+ *                    with ERMS
+ *   MEM_NONTEMPORAL  movnti, which writes around the cache
+ *
+ * mem_initialize picks the string instruction from CPUID, and a size from the
+ * largest cache beyond which copies and fills go non-temporal, since a buffer
+ * that large would only evict the cache on its way through. Until then,
+ * everything uses MEM_LOOP. Short copies use a loop with overlapping word
+ * moves, unless the CPU has fast short rep movsb.
+ */
+
+typedef enum {
+	MEM_LOOP,
+	MEM_REP_QWORD,
+	MEM_REP_BYTE,
+	MEM_NONTEMPORAL,
+	MEM_STRATEGIES
+} mem_strategy;
+
+enum {
+	MEM_PAGE_SIZE = 4096
+};
+
+void mem_initialize (void);
+mem_strategy mem_copy_strategy (void);
+mem_strategy mem_set_strategy (void);
+size_t mem_nontemporal_threshold (void); // 0 if never
+const char* mem_strategy_name (mem_strategy strategy);
+
+// One strategy regardless of size, for comparing them
+void mem_copy_with (mem_strategy strategy, void* dst, const void* src, size_t n);
+void mem_set_with (mem_strategy strategy, void* dst, int c, size_t n);
+
+void* memcpy (void* restrict dst, const void* restrict src, size_t n);
+void* memset (void* dst, int c, size_t n);
+void* memmove (void* dst, const void* src, size_t n);
+
+// Through the cache, for pages about to be used
+void clear_page (void* page);
+void copy_page (void* dst, const void* src);
+
+// With movnti, for pages that will not be touched soon, such as ones cleared
+// ahead of time for a free list; the page does not displace anything cached
+void clear_page_nontemporal (void* page);
+
+// Non-temporal once the pages reach the threshold
+void clear_pages (void* first, size_t count);
+
+#endif
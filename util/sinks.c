@@ -0,0 +1,99 @@
+#include "sinks.h"
+
+static
+void vga_sink_write (kprintf_sink* sink, const char* data, __attribute__ ((unused)) size_t length)
+{
+	vga_put (((vga_sink*) sink)->vga, data);
+}
+
+static
+void fb_console_sink_write (kprintf_sink* sink, const char* data,
+                            __attribute__ ((unused)) size_t length)
+{
+	fb_console_put (((fb_console_sink*) sink)->console, data);
+}
+
+static
+void serial_sink_write (kprintf_sink* sink, const char* data, size_t length)
+{
+	serial_port* port = ((serial_sink*) sink)->port;
+	size_t start = 0;
+	for (size_t i = 0; i < length; ++i)
+		if (data [i] == '\n') {
+			serial_write (port, data + start, i - start);
+			serial_write (port, "\r\n", 2);
+			start = i + 1;
+		}
+	serial_write (port, data + start, length - start);
+}
+
+// kprintf hands over up to KPRINTF_CHUNK bytes at a time, more than fits in a
+// record
+static
+void log_sink_write (kprintf_sink* sink, const char* data, size_t length)
+{
+	log_level level = ((log_sink*) sink)->level;
+	char piece [LOG_MESSAGE_MAX];
+	while (length > LOG_MESSAGE_MAX - 1) {
+		for (size_t i = 0; i < LOG_MESSAGE_MAX - 1; ++i)
+			piece [i] = data [i];
+		piece [LOG_MESSAGE_MAX - 1] = '\0';
+		log_write (level, piece);
+		data   += LOG_MESSAGE_MAX - 1;
+		length -= LOG_MESSAGE_MAX - 1;
+	}
+	log_write (level, data);
+}
+
+static
+void tee_sink_write (kprintf_sink* sink, const char* data, size_t length)
+{
+	tee_sink* tee = (tee_sink*) sink;
+	tee->first->write (tee->first, data, length);
+	if (tee->second != NULL)
+		tee->second->write (tee->second, data, length);
+}
+
+
+// Extern functions
+
+vga_sink make_vga_sink (tinyvga* vga)
+{
+	return (vga_sink) {
+		.sink = {.write = &vga_sink_write},
+		.vga  = vga
+	};
+}
+
+fb_console_sink make_fb_console_sink (fb_console* console)
+{
+	return (fb_console_sink) {
+		.sink    = {.write = &fb_console_sink_write},
+		.console = console
+	};
+}
+
+serial_sink make_serial_sink (serial_port* port)
+{
+	return (serial_sink) {
+		.sink = {.write = &serial_sink_write},
+		.port = port
+	};
+}
+
+log_sink make_log_sink (log_level level)
+{
+	return (log_sink) {
+		.sink  = {.write = &log_sink_write},
+		.level = level
+	};
+}
+
+tee_sink make_tee_sink (kprintf_sink* first, kprintf_sink* second)
+{
+	return (tee_sink) {
+		.sink   = {.write = &tee_sink_write},
+		.first  = first,
+		.second = second
+	};
+}
@@ -0,0 +1,48 @@
+#ifndef SINKS_H
+#define SINKS_H
+
+#include "kprintf.h"
+#include "fb/text_console.h"
+#include "log/log.h"
+#include "serial/serial.h"
+#include "vga/tinyvga.h"
+
+// kprintf sinks for the devices the kernel can print to
+
+typedef struct vga_sink {
+	kprintf_sink sink;
+	tinyvga*     vga;
+} vga_sink;
+
+typedef struct fb_console_sink {
+	kprintf_sink sink;
+	fb_console*  console;
+} fb_console_sink;
+
+// Newlines go out as CR LF
+typedef struct serial_sink {
+	kprintf_sink sink;
+	serial_port* port;
+} serial_sink;
+
+// Each kprintf call becomes one record, so the output should not end in a
+// newline. Output past LOG_MESSAGE_MAX - 1 bytes becomes further records.
+typedef struct log_sink {
+	kprintf_sink sink;
+	log_level    level;
+} log_sink;
+
+// Writes everything to first, then to second unless it is NULL
+typedef struct tee_sink {
+	kprintf_sink  sink;
+	kprintf_sink* first;
+	kprintf_sink* second;
+} tee_sink;
+
+vga_sink make_vga_sink (tinyvga* vga);
+fb_console_sink make_fb_console_sink (fb_console* console);
+serial_sink make_serial_sink (serial_port* port);
+log_sink make_log_sink (log_level level);
+tee_sink make_tee_sink (kprintf_sink* first, kprintf_sink* second);
+
+#endif
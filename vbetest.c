@@ -1,14 +1,29 @@
 #include "multiboot/multiboot.h"
 #include "vbe/vbe.h"
-#include "util/format.h"
+#include "fb/double_buffer.h"
+#include "fb/framebuffer.h"
+#include "fb/text_console.h"
+#include "memory/bootmem.h"
+#include "util/mem.h"
+#include "util/kprintf.h"
+#include "util/sinks.h"
+#include "time/clock.h"
+#include "time/timer.h"
 #include "x86/interrupts/IDT.h"
 #include "x86/interrupts/ISR.h"
 #include "x86/interrupts/IRQ.h"
+#include "x86/fpu.h"
+#include "smp/cpu.h"
+#include "sched/idle.h"
 #include <stdint.h>
 #include <stddef.h>
 
 static IDT idt;
 static ISR_table_t isrt;
+static framebuffer screen;
+static fb_double_buffer display;
+static fb_console console;
+static fb_console_sink text;
 
 
 
@@ -23,62 +38,46 @@ void halt (void)
 	);
 }
 
-void wait (void)
-{
-	__asm__ volatile (
-		"sti;"
-		"wait%=:"
-		"hlt;"
-		"jmp wait%="
-		:
-	);
-}
-
 
 
-void plot_pixel (ModeInfoBlock* mode_info,
-                 uint32_t x, uint32_t y,
-                 uint32_t R, uint32_t G, uint32_t B)
-{
-	uint8_t* base   = (uint8_t*)(uintptr_t) mode_info->PhysBasePtr;
-	uint16_t pitch  = mode_info->BytesPerScanLine;
-	uint16_t width  = (mode_info->BitsPerPixel + 8 - 1) / 8;
-	uint32_t offset = y * pitch + x * width;
-
-	const uint32_t cdata =
-		(R & ((1 << mode_info->RedMaskSize)   - 1)) << mode_info->RedFieldPosition   |
-		(G & ((1 << mode_info->GreenMaskSize) - 1)) << mode_info->GreenFieldPosition |
-		(B & ((1 << mode_info->BlueMaskSize)  - 1)) << mode_info->BlueFieldPosition;
-	const uint8_t* cdata_raw = (const uint8_t*) &cdata;
-
-	for (uint8_t i = 0; i < width; ++i)
-		base [offset + i] = cdata_raw [i];
-}
-
 #include "kernel.h"
 
 void kernel_main (multiboot_info_t* info,
                   __attribute__ ((unused)) multiboot_uint32_t magic)
 {
+	mem_initialize ();
+	bootmem_initialize (info);
 	ISR_table_initialize (&isrt, &null_ISR);
 	IDT_initialize (&idt);
 	IRQ_disable (IRQ_PIT);
+	fpu_initialize ();
+	clock_initialize ();
+	cpu_initialize ();
+	timers_initialize ();
+	idle_initialize ();
 
 	ModeInfoBlock* mode_info = (ModeInfoBlock*)(uintptr_t) info->vbe_mode_info;
+	screen = make_framebuffer_vbe (mode_info);
+	if (!fb_double_buffer_initialize (&display, &screen))
+		halt ();
+	uint64_t start = clock_now_ns ();
+	fb_gradient (&display.back, 0, 0, screen.width, screen.height,
+	             make_fb_rgb (0, 0, 255), make_fb_rgb (255, 0, 255), make_fb_rgb (0, 255, 255));
+	uint64_t drawn = clock_now_ns ();
+	fb_damage_all (&display);
+	fb_present (&display);
+	uint64_t presented = clock_now_ns ();
 
-	const uint32_t xres = mode_info->XResolution;
-	const uint32_t yres = mode_info->XResolution;
-	const uint32_t Rmax = (1 << mode_info->RedMaskSize)   - 1;
-	const uint32_t Gmax = (1 << mode_info->GreenMaskSize) - 1;
-	const uint32_t Bmax = (1 << mode_info->BlueMaskSize)  - 1;
-	for (uint32_t y = 0; y < yres; ++y)
-		for (uint32_t x = 0; x < xres; ++x)
-			plot_pixel (mode_info, x, y,
-			            (x * (Rmax+1)) / xres,
-			            (y * (Gmax+1)) / yres,
-			            Bmax);
+	if (!fb_console_initialize (&console, &display, 2,
+	                            make_fb_rgb (255, 255, 255), make_fb_rgb (0, 0, 0)))
+		halt ();
+	text = make_fb_console_sink (&console);
+	kprintf (&text.sink, "Mode:     %ux%u, %u bpp, pitch %u\n",
+	         screen.width, screen.height, screen.format.bytes_per_pixel * 8, screen.pitch);
+	kprintf (&text.sink, "Gradient: %'lu us drawn, %'lu us presented\n",
+	         (drawn - start) / 1000, (presented - drawn) / 1000);
 
-	wait ();
+	idle_loop ();
 }
 
 #define FLAGS (MULTIBOOT_PAGE_ALIGN | MULTIBOOT_MEMORY_INFO | MULTIBOOT_VIDEO_MODE)
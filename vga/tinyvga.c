@@ -1,14 +1,78 @@
 #include "tinyvga.h"
 #include "x86/portio.h"
 
+enum {
+	VGA_ALL_ROWS = (1 << VGA_HEIGHT) - 1,
+
+	// CRT controller registers
+	CRTC_START_HIGH  = 0x0C,
+	CRTC_START_LOW   = 0x0D,
+	CRTC_CURSOR_HIGH = 0x0E,
+	CRTC_CURSOR_LOW  = 0x0F
+};
+
+// Volatile stores one eight-byte word at a time; the aperture is row-major
+typedef volatile uint64_t (*vga_aperture) [VGA_WIDTH / 4];
+
+static inline
+void vga_write_crtc (const tinyvga* vga, uint8_t reg, uint16_t value)
+{
+	outb (vga->io_base, reg + 1); // Low byte
+	outb (vga->io_base + 1, value & 0xFF);
+	outb (vga->io_base, reg);     // High byte
+	outb (vga->io_base + 1, value >> 8);
+}
+
 static inline
 void vga_draw_cursor (tinyvga* vga)
 {
-	uint16_t position = VGA_WIDTH * vga->current_row + vga->current_column;
-	outb (vga->io_base, 0x0F); // Position low byte
-	outb (vga->io_base + 1, position & 0xFF);
-	outb (vga->io_base, 0x0E); // Position high byte
-	outb (vga->io_base + 1, position >> 8);
+	uint16_t position = VGA_WIDTH * (vga->window_top + vga->current_row) + vga->current_column;
+	if (position == vga->drawn_cursor)
+		return;
+	vga_write_crtc (vga, CRTC_CURSOR_HIGH, position);
+	vga->drawn_cursor = position;
+}
+
+static inline
+void vga_draw_start (tinyvga* vga)
+{
+	if (vga->window_top == vga->drawn_top)
+		return;
+	vga_write_crtc (vga, CRTC_START_HIGH, VGA_WIDTH * vga->window_top);
+	vga->drawn_top = vga->window_top;
+}
+
+static inline
+uint64_t* vga_shadow_row (tinyvga* vga, size_t row)
+{
+	return vga->shadow.words [(vga->shadow_top + row) % VGA_HEIGHT];
+}
+
+static inline
+void vga_blank_row (tinyvga* vga, size_t row)
+{
+	uint64_t blank = make_vga_entry (' ', vga->current_color).value * 0x0001000100010001;
+	uint64_t* words = vga_shadow_row (vga, row);
+	for (size_t word = 0; word < VGA_WIDTH / 4; ++word)
+		words [word] = blank;
+	vga->dirty_rows |= 1 << row;
+}
+
+static
+void vga_scroll (tinyvga* vga)
+{
+	vga->shadow_top = (vga->shadow_top + 1) % VGA_HEIGHT;
+	if (!vga->hardware_scroll)
+		vga->dirty_rows = VGA_ALL_ROWS;
+	else if (vga->window_top + VGA_HEIGHT < VGA_APERTURE_ROWS) {
+		++vga->window_top;
+		vga->dirty_rows >>= 1;
+	}
+	else {
+		vga->window_top = 0;
+		vga->dirty_rows = VGA_ALL_ROWS;
+	}
+	vga_blank_row (vga, VGA_HEIGHT - 1);
 }
 
 static
@@ -16,14 +80,7 @@ void vga_advance_line (tinyvga* vga)
 {
 	vga->current_column = 0;
 	if (++vga->current_row >= VGA_HEIGHT) {
-		volatile uint16_t* dst = (*vga->buffer) [0];
-		volatile uint16_t* src = (*vga->buffer) [1];
-		volatile uint16_t* const dst_end = dst + VGA_WIDTH * (VGA_HEIGHT - 1);
-		volatile uint16_t* const src_end = src + VGA_WIDTH * (VGA_HEIGHT - 1);
-		while (dst != dst_end)
-			*dst++ = *src++;
-		while (dst != src_end)
-			*dst++ = make_vga_entry (' ', vga->current_color).value;
+		vga_scroll (vga);
 		vga->current_row = VGA_HEIGHT - 1;
 	}
 }
@@ -41,49 +98,90 @@ void vga_putraw (tinyvga* vga, char c)
 	if (c == '\n')
 		vga_advance_line (vga);
 	else {
-		(*vga->buffer) [vga->current_row] [vga->current_column] = make_vga_entry (c, vga->current_color).value;
+		uint16_t* cells = (uint16_t*) vga_shadow_row (vga, vga->current_row);
+		cells [vga->current_column] = make_vga_entry (c, vga->current_color).value;
+		vga->dirty_rows |= 1 << vga->current_row;
 		vga_advance_char (vga);
 	}
 }
 
-
+
 
 tinyvga vga_initialize (void)
 {
-	return (tinyvga) {
-		.buffer         = (volatile uint16_t (*) [VGA_HEIGHT] [VGA_WIDTH]) VGA_BASE,
-		.io_base        = *((volatile uint16_t*) VGA_PORTADDR),
-		.current_row    = 0,
-		.current_column = 0,
-		.current_color  = make_vga_color (COLOR_LIGHT_GREY, COLOR_BLACK)
+	tinyvga vga = {
+		.buffer          = (volatile vga_grid*) VGA_BASE,
+		.io_base         = *((volatile uint16_t*) VGA_PORTADDR),
+		.current_row     = 0,
+		.current_column  = 0,
+		.current_color   = make_vga_color (COLOR_LIGHT_GREY, COLOR_BLACK),
+		.dirty_rows      = 0,
+		.drawn_cursor    = UINT16_MAX,
+		.shadow_top      = 0,
+		.window_top      = 0,
+		.drawn_top       = 0,
+		.hardware_scroll = false
 	};
+	// The only read-back: whatever the firmware left on screen
+	for (size_t row = 0; row < VGA_HEIGHT; ++row)
+		for (size_t word = 0; word < VGA_WIDTH / 4; ++word)
+			vga.shadow.words [row] [word] = vga.buffer->words [row] [word];
+	return vga;
+}
+
+void vga_set_hardware_scroll (tinyvga* vga, bool enabled)
+{
+	vga->hardware_scroll = enabled;
+	if (!enabled && vga->window_top != 0) {
+		vga->window_top = 0;
+		vga->dirty_rows = VGA_ALL_ROWS;
+		vga_flush (vga);
+	}
+}
+
+// Rows go out before the start address moves, so the new window never shows
+// stale rows.
+void vga_flush (tinyvga* vga)
+{
+	vga_aperture aperture = (vga_aperture) vga->buffer;
+	for (uint32_t dirty = vga->dirty_rows; dirty != 0; dirty &= dirty - 1) {
+		size_t row = __builtin_ctz (dirty);
+		volatile uint64_t* dst = aperture [vga->window_top + row];
+		const uint64_t* src = vga_shadow_row (vga, row);
+		for (size_t word = 0; word < VGA_WIDTH / 4; ++word)
+			dst [word] = src [word];
+	}
+	vga->dirty_rows = 0;
+	vga_draw_start (vga);
+	vga_draw_cursor (vga);
 }
 
 void vga_clear (tinyvga* vga)
 {
 	for (size_t row = 0; row < VGA_HEIGHT; ++row)
-		for (size_t col = 0; col < VGA_WIDTH; ++col)
-			(*vga->buffer) [row] [col] = make_vga_entry (' ', vga->current_color).value;
+		vga_blank_row (vga, row);
 	vga->current_row = 0;
 	vga->current_column = 0;
-	vga_draw_cursor (vga);
+	vga_flush (vga);
 }
 
 void vga_putchar (tinyvga* vga, char c)
 {
 	vga_putraw (vga, c);
-	vga_draw_cursor (vga);
+	vga_flush (vga);
 }
 
 void vga_put (tinyvga* vga, const char* str)
 {
 	for (size_t i = 0; str [i] != '\0'; ++i)
 		vga_putraw (vga, str [i]);
-	vga_draw_cursor (vga);
+	vga_flush (vga);
 }
 
 void vga_putline (tinyvga* vga, const char* str)
 {
-	vga_put (vga, str);
-	vga_putchar (vga, '\n');
+	for (size_t i = 0; str [i] != '\0'; ++i)
+		vga_putraw (vga, str [i]);
+	vga_putraw (vga, '\n');
+	vga_flush (vga);
 }
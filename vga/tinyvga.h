@@ -3,12 +3,16 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <stdbool.h>
 
 enum {
 	VGA_BASE     = 0xB8000,
 	VGA_PORTADDR = 0x03D4,
 	VGA_WIDTH    = 80,
-	VGA_HEIGHT   = 25
+	VGA_HEIGHT   = 25,
+
+	// The text aperture at VGA_BASE holds this many rows
+	VGA_APERTURE_ROWS = 32768 / (2 * VGA_WIDTH)
 };
 
 typedef enum {
@@ -60,15 +64,40 @@ vga_entry make_vga_entry (uint8_t c, vga_color color)
 
 
 
+/* Output goes to a shadow of the text buffer in RAM, which is never read back
+ * from video memory. Rows that changed are marked dirty and copied out eight
+ * bytes at a time by vga_flush, which also moves the hardware cursor if it
+ * changed; every function below that prints ends with a flush. The shadow is
+ * a ring of rows, so scrolling it only clears one row.
+ *
+ * With hardware scrolling, the screen is a window onto the whole aperture:
+ * a scroll moves the CRTC start address down a row, and only the new bottom
+ * row needs writing. When the window reaches the end of the aperture, it
+ * starts over at the top with one full copy of the screen.
+ */
+typedef union {
+	uint16_t cells [VGA_HEIGHT] [VGA_WIDTH];
+	uint64_t words [VGA_HEIGHT] [VGA_WIDTH / 4];
+} vga_grid;
+
 typedef struct {
-	volatile uint16_t (*buffer) [VGA_HEIGHT] [VGA_WIDTH];
+	volatile vga_grid* buffer;
 	uint16_t io_base;
 	size_t current_row;
 	size_t current_column;
 	vga_color current_color;
+	uint32_t dirty_rows;     // Bit n set if screen row n of the shadow is ahead
+	uint16_t drawn_cursor;   // Cursor position the hardware shows
+	uint16_t shadow_top;     // Shadow row shown as screen row 0
+	uint16_t window_top;     // Aperture row shown as screen row 0
+	uint16_t drawn_top;      // Aperture row the CRTC starts at
+	bool     hardware_scroll;
+	vga_grid shadow;
 } tinyvga;
 
 tinyvga vga_initialize (void);
+void vga_set_hardware_scroll (tinyvga* vga, bool enabled);
+void vga_flush (tinyvga* vga);
 void vga_clear (tinyvga* vga);
 void vga_putchar (tinyvga* vga, char c);
 void vga_put (tinyvga* vga, const char* str);
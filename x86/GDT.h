@@ -3,6 +3,10 @@
 
 #include <stdint.h>
 
+/* Descriptor layouts shared by the 32-bit init code, which builds the first
+ * GDT and TSS, and the kernel, which gives every CPU its own.
+ */
+
 enum {
 	KERNEL_NULL_SELECTOR = 0,
 	KERNEL_INIT_SELECTOR = 1,
@@ -11,4 +15,98 @@ enum {
 	TSS_SELECTOR = 4
 };
 
+// Interrupt stack table slots, numbered from 1 as in IDT entries
+enum {
+	IST_NONE         = 0,
+	IST_DOUBLE_FAULT = 1
+};
+
+typedef struct __attribute__ ((packed)) __attribute__ ((aligned (8))) {
+	uint16_t limit_low;
+	uint16_t base_low;
+	uint8_t  base_high1;
+	uint8_t  accessed    : 1;
+	uint8_t  rw_bit      : 1;
+	uint8_t  dc_bit      : 1;
+	uint8_t  ex_bit      : 1;
+	uint8_t  one         : 1; // Unused
+	uint8_t  privilege   : 2;
+	uint8_t  present     : 1;
+	uint8_t  limit_high  : 4;
+	uint8_t  zero        : 1; // Unused
+	uint8_t  mode64      : 1;
+	uint8_t  mode32      : 1;
+	uint8_t  granularity : 1;
+	uint8_t  base_high2;
+} GDT_entry;
+_Static_assert (sizeof (GDT_entry) == 8, "GDT_entry not packed");
+
+typedef struct __attribute__ ((packed)) __attribute__ ((aligned (8))) {
+	uint16_t limit_low;
+	uint16_t base_low;
+	uint8_t  base_high1;
+	uint8_t  type        : 4;
+	uint8_t  zero0       : 1; // Must be zero
+	uint8_t  privilege   : 2;
+	uint8_t  present     : 1;
+	uint8_t  limit_high  : 4;
+	uint8_t              : 1;
+	uint8_t  zero1       : 2; // Must be zero
+	uint8_t  granularity : 1;
+	uint8_t  base_high2;
+	uint32_t base_high3;
+	uint32_t reserved; // Must be zero
+} TSS_descriptor;
+
+typedef struct __attribute__ ((packed)) __attribute__ ((aligned (8))) {
+	GDT_entry GDTEs [4];
+	TSS_descriptor TSSD;
+} GDT;
+_Static_assert (sizeof (GDT) == (4 * sizeof (GDT_entry) + sizeof (TSS_descriptor)), "GDT not packed");
+
+typedef struct __attribute__ ((packed)) {
+	uint32_t reserved0;
+	uint64_t rsp [3];     // Stacks for privilege levels 0 to 2
+	uint64_t reserved1;
+	uint64_t ist [7];     // Interrupt stacks 1 to 7
+	uint64_t reserved2;
+	uint16_t reserved3;
+	uint16_t iomap_base;
+} TSS_64;
+_Static_assert (sizeof (TSS_64) == 104, "TSS_64 not packed");
+
+typedef struct __attribute__ ((packed)) descriptor_register {
+	uint16_t limit;
+	uint64_t base;
+} descriptor_register;
+
+static inline
+TSS_descriptor make_TSSD (TSS_64* tss, uint8_t privilege)
+{
+	uint64_t base  = (uintptr_t) tss;
+	uint32_t limit = sizeof (TSS_64) - 1;
+	return (TSS_descriptor) {
+		.limit_low   = limit & 0xFFFF,
+		.base_low    = base & 0xFFFF,
+		.base_high1  = (base >> 16) & 0xFF,
+		.type        = 0b1001,
+		.zero0       = 0,
+		.privilege   = privilege,
+		.present     = 1,
+		.limit_high  = (limit >> 16) & 0xFF,
+		.zero1       = 0,
+		.granularity = 0,
+		.base_high2  = (base >> 24) & 0xFF,
+		.base_high3  = base >> 32,
+		.reserved    = 0
+	};
+}
+
+static inline
+void install_TSS (uint16_t selector)
+{
+	selector *= 8;
+	__asm__ volatile ("ltr %0" :: "r" (selector));
+}
+
 #endif
@@ -0,0 +1,102 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <stdint.h>
+
+enum {
+	CR0_MP = 1 << 1,  // Monitor coprocessor
+	CR0_EM = 1 << 2,  // x87 emulation
+	CR0_TS = 1 << 3,  // Task switched
+	CR0_NE = 1 << 5,  // Native x87 error reporting
+
+	CR4_OSFXSR     = 1 << 9,  // FXSAVE/FXRSTOR and SSE
+	CR4_OSXMMEXCPT = 1 << 10, // Unmasked SIMD exceptions raise #XM
+	CR4_OSXSAVE    = 1 << 18  // XSAVE and XCR0
+};
+
+static inline
+__attribute__ ((always_inline))
+uint64_t read_cr0 (void)
+{
+	uint64_t value;
+	__asm__ volatile ("mov %%cr0, %0" : "=r" (value));
+	return value;
+}
+
+static inline
+__attribute__ ((always_inline))
+void write_cr0 (uint64_t value)
+{
+	__asm__ volatile ("mov %0, %%cr0" :: "r" (value) : "memory");
+}
+
+static inline
+__attribute__ ((always_inline))
+uint64_t read_cr4 (void)
+{
+	uint64_t value;
+	__asm__ volatile ("mov %%cr4, %0" : "=r" (value));
+	return value;
+}
+
+static inline
+__attribute__ ((always_inline))
+void write_cr4 (uint64_t value)
+{
+	__asm__ volatile ("mov %0, %%cr4" :: "r" (value) : "memory");
+}
+
+static inline
+__attribute__ ((always_inline))
+void clts (void)
+{
+	__asm__ volatile ("clts" ::: "memory");
+}
+
+static inline
+__attribute__ ((always_inline))
+void stts (void)
+{
+	write_cr0 (read_cr0 () | CR0_TS);
+}
+
+static inline
+__attribute__ ((always_inline))
+uint64_t read_xcr (uint32_t index)
+{
+	uint32_t low, high;
+	__asm__ volatile ("xgetbv" : "=a" (low), "=d" (high) : "c" (index));
+	return (uint64_t) high << 32 | low;
+}
+
+static inline
+__attribute__ ((always_inline))
+void write_xcr (uint32_t index, uint64_t value)
+{
+	__asm__ volatile ("xsetbv" :: "a" ((uint32_t) value), "d" ((uint32_t) (value >> 32)), "c" (index));
+}
+
+static inline
+__attribute__ ((always_inline))
+uint64_t save_flags_cli (void)
+{
+	uint64_t flags;
+	__asm__ volatile ("pushfq; popq %0; cli" : "=r" (flags) :: "memory");
+	return flags;
+}
+
+static inline
+__attribute__ ((always_inline))
+void restore_flags (uint64_t flags)
+{
+	__asm__ volatile ("pushq %0; popfq" :: "r" (flags) : "memory", "cc");
+}
+
+static inline
+__attribute__ ((always_inline))
+void cpu_relax (void)
+{
+	__asm__ volatile ("pause" ::: "memory");
+}
+
+#endif
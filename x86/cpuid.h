@@ -0,0 +1,69 @@
+#ifndef CPUID_H
+#define CPUID_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct cpuid_result {
+	uint32_t eax;
+	uint32_t ebx;
+	uint32_t ecx;
+	uint32_t edx;
+} cpuid_result;
+
+enum {
+	// CPUID.01H:ECX
+	CPUID_1_ECX_SSE3         = 1 << 0,
+	CPUID_1_ECX_MONITOR      = 1 << 3,
+	CPUID_1_ECX_TSC_DEADLINE = 1 << 24,
+	CPUID_1_ECX_XSAVE        = 1 << 26,
+	CPUID_1_ECX_OSXSAVE      = 1 << 27,
+	CPUID_1_ECX_AVX          = 1 << 28,
+
+	// CPUID.01H:EDX
+	CPUID_1_EDX_APIC         = 1 << 9,
+	CPUID_1_EDX_FXSR         = 1 << 24,
+	CPUID_1_EDX_SSE          = 1 << 25,
+	CPUID_1_EDX_SSE2         = 1 << 26,
+
+	// CPUID.05H:ECX
+	CPUID_5_ECX_EMX          = 1 << 0, // Sub-states enumerated in EDX
+	CPUID_5_ECX_IBE          = 1 << 1, // Interrupts break MWAIT when masked
+
+	// CPUID.(EAX=07H,ECX=0)
+	CPUID_7_EBX_ERMS = 1 << 9, // Enhanced rep movsb/stosb
+	CPUID_7_EDX_FSRM = 1 << 4, // Fast rep movsb for short copies
+
+	// CPUID.(EAX=0DH,ECX=1):EAX
+	CPUID_D_1_EAX_XSAVEOPT = 1 << 0,
+
+	// CPUID.80000001H:ECX
+	CPUID_80000001_ECX_TOPOEXT = 1 << 22 // Leaf 8000001DH describes the caches
+};
+
+static inline
+__attribute__ ((always_inline))
+cpuid_result cpuid (uint32_t leaf, uint32_t subleaf)
+{
+	cpuid_result result;
+	__asm__ volatile (
+		"cpuid"
+		: "=a" (result.eax), "=b" (result.ebx), "=c" (result.ecx), "=d" (result.edx)
+		: "a" (leaf), "c" (subleaf)
+	);
+	return result;
+}
+
+static inline
+uint32_t cpuid_max_leaf (void)
+{
+	return cpuid (0, 0).eax;
+}
+
+static inline
+uint32_t cpuid_max_extended_leaf (void)
+{
+	return cpuid (0x80000000, 0).eax;
+}
+
+#endif
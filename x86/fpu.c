@@ -0,0 +1,329 @@
+#include "fpu.h"
+#include "x86/control.h"
+#include "x86/cpuid.h"
+#include "x86/tsc.h"
+#include "x86/interrupts/ISR.h"
+#include "smp/percpu.h"
+
+enum {
+	XFEATURE_X87       = 1 << 0,
+	XFEATURE_SSE       = 1 << 1,
+	XFEATURE_AVX       = 1 << 2,
+	XFEATURE_OPMASK    = 1 << 5,
+	XFEATURE_ZMM_HI256 = 1 << 6,
+	XFEATURE_HI16_ZMM  = 1 << 7,
+
+	// Legacy region plus XSAVE header
+	XSAVE_LEGACY_SIZE = 512,
+	XSAVE_HEADER_SIZE = 64,
+
+	// Offsets into the legacy region
+	FXSAVE_FCW   = 0,
+	FXSAVE_MXCSR = 24,
+
+	FCW_DEFAULT   = 0x037F,
+	MXCSR_DEFAULT = 0x1F80,
+
+	BENCHMARK_ROUNDS = 32
+};
+
+// Components are enabled a group at a time, since XCR0 rejects partial AVX-512
+// state.
+static const uint64_t xfeature_groups [] = {
+	XFEATURE_X87 | XFEATURE_SSE,
+	XFEATURE_AVX,
+	XFEATURE_OPMASK | XFEATURE_ZMM_HI256 | XFEATURE_HI16_ZMM
+};
+
+typedef struct fpu_cpu {
+	fpu_context* current; // The running context
+	fpu_context* owner;   // The context whose state is in the registers
+	uint64_t     kernel_fpu_flags;
+	fpu_context  boot_context;
+} fpu_cpu;
+
+static bool         use_xsave;
+static bool         use_xsaveopt;
+static uint64_t     xfeatures;
+static size_t       area_size;
+static fpu_strategy strategy;
+
+static DEFINE_PER_CPU (fpu_cpu, cpu_fpu);
+
+static __attribute__ ((aligned (FPU_AREA_ALIGN))) uint8_t init_area [FPU_AREA_MAX];
+static __attribute__ ((aligned (FPU_AREA_ALIGN))) uint8_t boot_area [FPU_AREA_MAX];
+static __attribute__ ((aligned (FPU_AREA_ALIGN))) uint8_t bench_area [FPU_AREA_MAX];
+
+static inline
+void fpu_save (void* area)
+{
+	if (use_xsaveopt)
+		__asm__ volatile ("xsaveopt64 (%0)" :: "r" (area), "a" (-1), "d" (-1) : "memory");
+	else if (use_xsave)
+		__asm__ volatile ("xsave64 (%0)" :: "r" (area), "a" (-1), "d" (-1) : "memory");
+	else
+		__asm__ volatile ("fxsave64 (%0)" :: "r" (area) : "memory");
+}
+
+static inline
+void fpu_restore (const void* area)
+{
+	if (use_xsave)
+		__asm__ volatile ("xrstor64 (%0)" :: "r" (area), "a" (-1), "d" (-1) : "memory");
+	else
+		__asm__ volatile ("fxrstor64 (%0)" :: "r" (area) : "memory");
+}
+
+static
+size_t xsave_size (uint64_t features)
+{
+	size_t size = XSAVE_LEGACY_SIZE + XSAVE_HEADER_SIZE;
+	for (uint32_t i = 2; i < 64; ++i)
+		if (features & ((uint64_t) 1 << i)) {
+			cpuid_result component = cpuid (0xD, i);
+			size_t end = component.ebx + component.eax;
+			if (end > size)
+				size = end;
+		}
+	return size;
+}
+
+static
+void select_xfeatures (void)
+{
+	cpuid_result leaf = cpuid (0xD, 0);
+	uint64_t supported = (uint64_t) leaf.edx << 32 | leaf.eax;
+
+	xfeatures = 0;
+	for (size_t i = 0; i < sizeof (xfeature_groups) / sizeof (xfeature_groups [0]); ++i) {
+		uint64_t group = xfeature_groups [i];
+		if ((supported & group) == group && xsave_size (xfeatures | group) <= FPU_AREA_MAX)
+			xfeatures |= group;
+	}
+}
+
+static
+void enable_fpu (void)
+{
+	write_cr0 ((read_cr0 () & ~(CR0_EM | CR0_TS)) | CR0_MP | CR0_NE);
+	uint64_t cr4 = read_cr4 () | CR4_OSFXSR | CR4_OSXMMEXCPT;
+	if (use_xsave)
+		cr4 |= CR4_OSXSAVE;
+	write_cr4 (cr4);
+
+	if (use_xsave)
+		write_xcr (0, xfeatures);
+}
+
+static inline
+fpu_cpu* this_cpu_fpu (void)
+{
+	return this_cpu_ptr (cpu_fpu);
+}
+
+static
+void start_cpu (void* area)
+{
+	fpu_cpu* cpu = this_cpu_fpu ();
+	fpu_context_initialize (&cpu->boot_context, area);
+	fpu_restore (area);
+	cpu->boot_context.used = true;
+	cpu->owner   = &cpu->boot_context;
+	cpu->current = &cpu->boot_context;
+}
+
+// With XSTATE_BV clear, XRSTOR puts every component in its initial
+// configuration; only FCW and MXCSR are taken from the legacy region. FXRSTOR
+// reads the same layout, where zeroed registers and tag word are the FNINIT
+// state.
+static
+void build_init_area (void)
+{
+	for (size_t i = 0; i < FPU_AREA_MAX; ++i)
+		init_area [i] = 0;
+	*(uint16_t*) &init_area [FXSAVE_FCW]   = FCW_DEFAULT;
+	*(uint32_t*) &init_area [FXSAVE_MXCSR] = MXCSR_DEFAULT;
+}
+
+static
+void copy_area (void* dst, const void* src)
+{
+	uint64_t* d = dst;
+	const uint64_t* s = src;
+	for (size_t i = 0; i < area_size / sizeof (uint64_t); ++i)
+		d [i] = s [i];
+}
+
+static
+void fpu_NM_ISR (__attribute__ ((unused)) INT_index interrupt,
+                 __attribute__ ((unused)) uint64_t error)
+{
+	fpu_cpu* cpu = this_cpu_fpu ();
+	clts ();
+	if (cpu->owner == cpu->current)
+		return;
+	if (cpu->owner != NULL)
+		fpu_save (cpu->owner->area);
+	fpu_restore (cpu->current->area);
+	cpu->current->used = true;
+	cpu->owner = cpu->current;
+}
+
+static inline
+void touch_fpu (void)
+{
+	__asm__ volatile ("fnop");
+}
+
+// Lazy switching costs a trap, a save and a restore whenever a context uses the
+// FPU after another one did; eager switching costs a save and a restore on
+// every switch into a context that has used the FPU. A context that uses the
+// FPU at all tends to use it again, so eager switching is chosen as soon as the
+// trap makes up more than half of the lazy cost.
+static
+fpu_strategy benchmark_strategy (void)
+{
+	fpu_cpu* cpu = this_cpu_fpu ();
+	fpu_context other = {.area = bench_area, .used = true};
+	copy_area (bench_area, init_area);
+
+	uint64_t lazy  = UINT64_MAX;
+	uint64_t eager = UINT64_MAX;
+	for (int i = 0; i < BENCHMARK_ROUNDS; ++i) {
+		fpu_context* next = (i % 2) ? &cpu->boot_context : &other;
+
+		stts ();
+		cpu->current = next;
+		uint64_t start = rdtsc_ordered ();
+		touch_fpu ();
+		uint64_t cycles = rdtsc_ordered () - start;
+		if (cycles < lazy)
+			lazy = cycles;
+
+		start = rdtsc_ordered ();
+		fpu_save (cpu->owner->area);
+		fpu_restore (next->area);
+		cycles = rdtsc_ordered () - start;
+		if (cycles < eager)
+			eager = cycles;
+	}
+
+	fpu_restore (cpu->boot_context.area);
+	cpu->owner   = &cpu->boot_context;
+	cpu->current = &cpu->boot_context;
+	return (2 * eager < lazy) ? FPU_EAGER : FPU_LAZY;
+}
+
+
+// Extern functions
+
+void fpu_initialize (void)
+{
+	cpuid_result leaf = cpuid (1, 0);
+	use_xsave = leaf.ecx & CPUID_1_ECX_XSAVE;
+	if (use_xsave)
+		select_xfeatures ();
+	enable_fpu ();
+
+	if (use_xsave) {
+		area_size    = cpuid (0xD, 0).ebx;
+		use_xsaveopt = cpuid (0xD, 1).eax & CPUID_D_1_EAX_XSAVEOPT;
+	}
+	else
+		area_size = XSAVE_LEGACY_SIZE;
+
+	build_init_area ();
+	start_cpu (boot_area);
+
+	set_ISR (INT_coprocessor_unavailable, &fpu_NM_ISR);
+	strategy = benchmark_strategy ();
+}
+
+void fpu_initialize_cpu (void* area)
+{
+	enable_fpu ();
+	start_cpu (area);
+}
+
+size_t fpu_area_size (void)
+{
+	return area_size;
+}
+
+fpu_strategy fpu_get_strategy (void)
+{
+	return strategy;
+}
+
+void fpu_set_strategy (fpu_strategy new_strategy)
+{
+	strategy = new_strategy;
+}
+
+void fpu_context_initialize (fpu_context* ctx, void* area)
+{
+	ctx->area = area;
+	ctx->used = false;
+	copy_area (area, init_area);
+}
+
+void fpu_context_release (fpu_context* ctx)
+{
+	fpu_cpu* cpu = this_cpu_fpu ();
+	if (cpu->owner == ctx)
+		cpu->owner = NULL;
+}
+
+fpu_context* fpu_current_context (void)
+{
+	return this_cpu_fpu ()->current;
+}
+
+void fpu_switch (fpu_context* next)
+{
+	fpu_cpu* cpu = this_cpu_fpu ();
+	if (next == cpu->current)
+		return;
+
+	if (strategy == FPU_EAGER && next->used) {
+		clts ();
+		if (cpu->owner != NULL && cpu->owner != next)
+			fpu_save (cpu->owner->area);
+		if (cpu->owner != next)
+			fpu_restore (next->area);
+		cpu->owner = next;
+	}
+	else if (cpu->owner == next)
+		clts ();
+	else
+		stts ();
+
+	cpu->current = next;
+}
+
+void kernel_fpu_begin (void)
+{
+	uint64_t flags = save_flags_cli ();
+	fpu_cpu* cpu = this_cpu_fpu ();
+	cpu->kernel_fpu_flags = flags;
+	clts ();
+	if (cpu->owner != NULL) {
+		fpu_save (cpu->owner->area);
+		cpu->owner = NULL;
+	}
+
+	uint32_t mxcsr = MXCSR_DEFAULT;
+	__asm__ volatile ("fninit; ldmxcsr %0" :: "m" (mxcsr));
+}
+
+void kernel_fpu_end (void)
+{
+	fpu_cpu* cpu = this_cpu_fpu ();
+	if (strategy == FPU_EAGER && cpu->current->used) {
+		fpu_restore (cpu->current->area);
+		cpu->owner = cpu->current;
+	}
+	else
+		stts ();
+	restore_flags (cpu->kernel_fpu_flags);
+}
@@ -0,0 +1,52 @@
+#ifndef FPU_H
+#define FPU_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+enum {
+	FPU_AREA_ALIGN = 64,
+	FPU_AREA_MAX   = 4096
+};
+
+typedef enum {
+	FPU_LAZY,  // Restore on first use after a switch (CR0.TS and #NM)
+	FPU_EAGER  // Save and restore on every switch (XSAVEOPT/XRSTOR)
+} fpu_strategy;
+
+// The x87/SSE/AVX register state of one execution context. The save area must
+// be FPU_AREA_ALIGN-aligned and at least fpu_area_size () bytes long; it is
+// owned by the caller.
+typedef struct fpu_context {
+	void* area;
+	bool  used;
+} fpu_context;
+
+// Must be called after ISR_table_initialize, since it installs the #NM handler
+// and measures its cost to choose a strategy. The caller's context becomes the
+// boot context, which has a statically-allocated save area.
+void fpu_initialize (void);
+
+// Enables the FPU on an application processor with the features chosen by
+// fpu_initialize, using the given area for that CPU's boot context.
+void fpu_initialize_cpu (void* area);
+
+size_t fpu_area_size (void);
+fpu_strategy fpu_get_strategy (void);
+void fpu_set_strategy (fpu_strategy strategy);
+
+void fpu_context_initialize (fpu_context* ctx, void* area);
+void fpu_context_release (fpu_context* ctx);
+fpu_context* fpu_current_context (void);
+void fpu_switch (fpu_context* next);
+
+// Code between kernel_fpu_begin and kernel_fpu_end may use the x87, SSE and AVX
+// registers without disturbing the state of the running context. Because the
+// kernel is built with -mno-sse, such code must be compiled with a target
+// attribute, e.g. __attribute__ ((target ("sse2"))). Interrupts are disabled
+// for the duration of the region, so regions do not nest.
+void kernel_fpu_begin (void);
+void kernel_fpu_end (void);
+
+#endif
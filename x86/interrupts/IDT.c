@@ -52,8 +52,11 @@ void IDT_initialize (IDT* idt)
 		(*idt) [i] = make_IDT_entry (_LOW_ISR(i));
 	for (uint8_t i = 0x14; i < 0x20; ++i)
 		(*idt) [i] = (IDT_entry) {.present = 0};
-	for (uint8_t i = 0x20; i < 0x30; ++i)
+	for (uint8_t i = 0x20; i < INT_LIMIT; ++i)
 		(*idt) [i] = make_IDT_entry (_HIGH_ISR(i - 0x20));
 
+	// The stack itself is set up by cpu_initialize
+	(*idt) [INT_double_fault].stack_table = IST_DOUBLE_FAULT;
+
 	install_IDT (idt);
 }
@@ -0,0 +1,279 @@
+#include "IOAPIC.h"
+#include "8259.h"
+#include "ISR.h"
+#include "LAPIC.h"
+#include "acpi/acpi.h"
+#include "smp/smp.h"
+#include "sync/qspinlock.h"
+#include "x86/portio.h"
+#include <stddef.h>
+
+enum {
+	MAX_IO_APICS = 8,
+
+	// Memory-mapped register window
+	IOAPIC_REGSEL = 0x00 / sizeof (uint32_t),
+	IOAPIC_WINDOW = 0x10 / sizeof (uint32_t),
+
+	// Registers
+	IOAPIC_REG_VERSION  = 0x01,
+	IOAPIC_REG_REDIRECT = 0x10, // Two per input, low half first
+
+	// Redirection entry, low half
+	IOAPIC_ACTIVE_LOW = 1 << 13,
+	IOAPIC_LEVEL      = 1 << 15,
+	IOAPIC_MASKED     = 1 << 16,
+
+	// MADT interrupt source override flags
+	MADT_POLARITY_MASK = 0x3,
+	MADT_POLARITY_LOW  = 0x3,
+	MADT_TRIGGER_MASK  = 0xC,
+	MADT_TRIGGER_LEVEL = 0xC
+};
+
+typedef struct io_apic {
+	volatile uint32_t* base;
+	uint32_t           gsi_base;
+	uint32_t           inputs;
+} io_apic;
+
+typedef struct IRQ_route {
+	const io_apic*   apic;
+	uint32_t         input;
+	uint32_t         mode; // Polarity and trigger bits of the low half
+	bool             enabled;
+	cpu_mask         affinity;
+	uint32_t         target;
+	IOAPIC_move_hook hook;
+	void*            hook_arg;
+} IRQ_route;
+
+static bool      present;
+static io_apic   apics [MAX_IO_APICS];
+static uint32_t  apic_count;
+static IRQ_route routes [IOAPIC_IRQS];
+static qspinlock lock; // Guards the register window and the routes
+
+static
+uint32_t read_register (const io_apic* apic, uint32_t reg)
+{
+	apic->base [IOAPIC_REGSEL] = reg;
+	return apic->base [IOAPIC_WINDOW];
+}
+
+static
+void write_register (const io_apic* apic, uint32_t reg, uint32_t value)
+{
+	apic->base [IOAPIC_REGSEL] = reg;
+	apic->base [IOAPIC_WINDOW] = value;
+}
+
+static
+const io_apic* find_apic (uint32_t gsi)
+{
+	for (uint32_t i = 0; i < apic_count; ++i)
+		if (apics [i].gsi_base <= gsi && gsi < apics [i].gsi_base + apics [i].inputs)
+			return &apics [i];
+	return NULL;
+}
+
+static
+uint32_t override_mode (uint16_t flags)
+{
+	uint32_t mode = 0;
+	if ((flags & MADT_POLARITY_MASK) == MADT_POLARITY_LOW)
+		mode |= IOAPIC_ACTIVE_LOW;
+	if ((flags & MADT_TRIGGER_MASK) == MADT_TRIGGER_LEVEL)
+		mode |= IOAPIC_LEVEL;
+	return mode;
+}
+
+// Called with the lock held. The high half goes first, so the entry never
+// points a new vector at a stale destination.
+static
+void write_entry (IRQ irq)
+{
+	const IRQ_route* route = &routes [irq];
+	uint32_t reg = IOAPIC_REG_REDIRECT + 2 * route->input;
+	uint32_t low = (INT_IRQ_MBASE + irq) | route->mode | (route->enabled ? 0 : IOAPIC_MASKED);
+	write_register (route->apic, reg + 1, (uint32_t) cpu_apic_id (route->target) << 24);
+	write_register (route->apic, reg, low);
+}
+
+static
+void add_apic (const acpi_madt_io_apic* entry)
+{
+	if (apic_count == MAX_IO_APICS)
+		return;
+	io_apic* apic = &apics [apic_count++];
+	apic->base     = (volatile uint32_t*) (uintptr_t) entry->address;
+	apic->gsi_base = entry->gsi_base;
+	apic->inputs   = ((read_register (apic, IOAPIC_REG_VERSION) >> 16) & 0xFF) + 1;
+}
+
+static
+cpu_mask online_mask (void)
+{
+	cpu_mask mask = 0;
+	for (uint32_t cpu = 0; cpu < MAX_CPUS; ++cpu)
+		if (cpu == 0 || smp_cpu_online (cpu))
+			mask |= (cpu_mask) 1 << cpu;
+	return mask;
+}
+
+static
+void call_hook (IRQ irq, uint32_t cpu)
+{
+	IOAPIC_move_hook hook = routes [irq].hook;
+	if (hook != NULL)
+		hook (irq, cpu, routes [irq].hook_arg);
+}
+
+
+// Extern functions
+
+bool IOAPIC_initialize (void)
+{
+	if (!LAPIC_present ())
+		return false;
+	const acpi_madt* madt = (const acpi_madt*) acpi_find_table ("APIC");
+	if (madt == NULL)
+		return false;
+
+	uint32_t gsis [IOAPIC_IRQS];
+	for (uint32_t irq = 0; irq < IOAPIC_IRQS; ++irq) {
+		gsis [irq] = irq;
+		routes [irq].mode = 0; // ISA: edge-triggered, active high
+	}
+	for (const acpi_madt_entry* entry = acpi_madt_begin (madt);
+	     entry < acpi_madt_end (madt); entry = acpi_madt_next (entry)) {
+		if (entry->type == MADT_IO_APIC)
+			add_apic ((const acpi_madt_io_apic*) entry);
+		else if (entry->type == MADT_SOURCE_OVERRIDE) {
+			const acpi_madt_source_override* o = (const acpi_madt_source_override*) entry;
+			if (o->bus == 0 && o->source < IOAPIC_IRQS) {
+				gsis [o->source]        = o->gsi;
+				routes [o->source].mode = override_mode (o->flags);
+			}
+		}
+	}
+	if (apic_count == 0)
+		return false;
+
+	lock = make_qspinlock ();
+	uint64_t flags = qspinlock_acquire_irqsave (&lock);
+	for (uint32_t i = 0; i < apic_count; ++i)
+		for (uint32_t input = 0; input < apics [i].inputs; ++input)
+			write_register (&apics [i], IOAPIC_REG_REDIRECT + 2 * input, IOAPIC_MASKED);
+
+	// IRQ 2 only chains the 8259s, and its input usually carries the PIT
+	uint16_t pic_masks = inb (PIC1_DATA) | inb (PIC2_DATA) << 8;
+	for (uint32_t irq = 0; irq < IOAPIC_IRQS; ++irq) {
+		IRQ_route* route = &routes [irq];
+		route->apic = (irq != IRQ_cascade) ? find_apic (gsis [irq]) : NULL;
+		if (route->apic == NULL)
+			continue;
+		route->input    = gsis [irq] - route->apic->gsi_base;
+		route->enabled  = !(pic_masks & (1 << irq));
+		route->affinity = (cpu_mask) 1;
+		route->target   = 0;
+		write_entry (irq);
+	}
+	outb (PIC1_DATA, 0xFF);
+	outb (PIC2_DATA, 0xFF);
+	present = true;
+	qspinlock_release_irqrestore (&lock, flags);
+	return true;
+}
+
+bool IOAPIC_present (void)
+{
+	return present;
+}
+
+bool IOAPIC_routed (IRQ irq)
+{
+	return present && (uint32_t) irq < IOAPIC_IRQS && routes [irq].apic != NULL;
+}
+
+void IOAPIC_enable (IRQ irq)
+{
+	if (!IOAPIC_routed (irq))
+		return;
+	uint64_t flags = qspinlock_acquire_irqsave (&lock);
+	routes [irq].enabled = true;
+	write_entry (irq);
+	qspinlock_release_irqrestore (&lock, flags);
+}
+
+void IOAPIC_disable (IRQ irq)
+{
+	if (!IOAPIC_routed (irq))
+		return;
+	uint64_t flags = qspinlock_acquire_irqsave (&lock);
+	routes [irq].enabled = false;
+	write_entry (irq);
+	qspinlock_release_irqrestore (&lock, flags);
+}
+
+bool IOAPIC_set_affinity (IRQ irq, cpu_mask mask)
+{
+	mask &= online_mask ();
+	if (!IOAPIC_routed (irq) || mask == 0)
+		return false;
+
+	uint64_t flags = qspinlock_acquire_irqsave (&lock);
+	IRQ_route* route = &routes [irq];
+	route->affinity = mask;
+	bool moved = !(mask & ((cpu_mask) 1 << route->target));
+	if (moved) {
+		route->target = __builtin_ctzll (mask);
+		write_entry (irq);
+	}
+	uint32_t target = route->target;
+	qspinlock_release_irqrestore (&lock, flags);
+
+	if (moved)
+		call_hook (irq, target);
+	return true;
+}
+
+cpu_mask IOAPIC_affinity (IRQ irq)
+{
+	return IOAPIC_routed (irq) ? routes [irq].affinity : 0;
+}
+
+bool IOAPIC_set_target (IRQ irq, uint32_t cpu)
+{
+	if (!IOAPIC_routed (irq) || cpu >= MAX_CPUS)
+		return false;
+
+	uint64_t flags = qspinlock_acquire_irqsave (&lock);
+	IRQ_route* route = &routes [irq];
+	bool allowed = route->affinity & ((cpu_mask) 1 << cpu);
+	bool moved = allowed && route->target != cpu;
+	if (moved) {
+		route->target = cpu;
+		write_entry (irq);
+	}
+	qspinlock_release_irqrestore (&lock, flags);
+
+	if (moved)
+		call_hook (irq, cpu);
+	return allowed;
+}
+
+uint32_t IOAPIC_target (IRQ irq)
+{
+	return IOAPIC_routed (irq) ? __atomic_load_n (&routes [irq].target, __ATOMIC_RELAXED) : 0;
+}
+
+void IOAPIC_set_move_hook (IRQ irq, IOAPIC_move_hook hook, void* arg)
+{
+	if (!IOAPIC_routed (irq))
+		return;
+	uint64_t flags = qspinlock_acquire_irqsave (&lock);
+	routes [irq].hook     = hook;
+	routes [irq].hook_arg = arg;
+	qspinlock_release_irqrestore (&lock, flags);
+}
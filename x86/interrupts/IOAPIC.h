@@ -0,0 +1,56 @@
+#ifndef IOAPIC_H
+#define IOAPIC_H
+
+#include "IRQ.h"
+#include "smp/cpu.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Routes the ISA IRQs through the I/O APICs listed in the ACPI MADT instead of
+ * the 8259s, which are then masked completely. Each IRQ keeps its vector,
+ * INT_IRQ_MBASE + irq, and is delivered to a single CPU in physical
+ * destination mode: the target, chosen from the IRQ's affinity mask. IRQs
+ * start out on CPU 0, enabled or disabled as they were on the 8259.
+ *
+ * A driver whose interrupts cause deferred work (a thread woken from the
+ * handler, say) installs a move hook, which runs whenever the IRQ gets a new
+ * target, so that the work can follow the interrupts to the new CPU. Hooks
+ * run with interrupts disabled, and from the timer interrupt when the move is
+ * IRQ_balance's, so they must not sleep or take a mutex.
+ *
+ * No current driver defers work to a particular CPU, so none installs a hook:
+ * the serial driver does all of its work in the handler, and serial_read
+ * takes received bytes from the ring on whichever CPU calls it.
+ */
+
+enum {
+	IOAPIC_IRQS = 16
+};
+
+typedef void (*IOAPIC_move_hook) (IRQ irq, uint32_t cpu, void* arg);
+
+// Takes over from the 8259s. Requires cpu_initialize. Returns false, leaving
+// the 8259s in charge, without a local APIC, a MADT or an I/O APIC.
+bool IOAPIC_initialize (void);
+
+bool IOAPIC_present (void);
+
+// True for IRQs delivered through an I/O APIC
+bool IOAPIC_routed (IRQ irq);
+
+void IOAPIC_enable (IRQ irq);
+void IOAPIC_disable (IRQ irq);
+
+// Restricts the IRQ to the online CPUs in mask. The target stays where it is
+// if allowed, and moves to the lowest allowed CPU otherwise. Returns false,
+// changing nothing, if no CPU in mask is online.
+bool IOAPIC_set_affinity (IRQ irq, cpu_mask mask);
+cpu_mask IOAPIC_affinity (IRQ irq);
+
+// Moves the IRQ to a CPU in its affinity mask. Returns false otherwise.
+bool IOAPIC_set_target (IRQ irq, uint32_t cpu);
+uint32_t IOAPIC_target (IRQ irq);
+
+void IOAPIC_set_move_hook (IRQ irq, IOAPIC_move_hook hook, void* arg);
+
+#endif
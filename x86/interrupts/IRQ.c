@@ -1,5 +1,6 @@
 #include "IRQ.h"
 #include "8259.h"
+#include "IOAPIC.h"
 #include "x86/portio.h"
 
 
@@ -18,6 +19,10 @@ void IRQ_EOI_slave (void)
 
 void IRQ_disable (IRQ irq)
 {
+	if (IOAPIC_present ()) {
+		IOAPIC_disable (irq);
+		return;
+	}
 	uint16_t port = (irq < 8) ? PIC1_DATA : PIC2_DATA;
 	uint8_t index = irq % 8;
 	outb (port, inb (port) | (1 << index));
@@ -25,6 +30,10 @@ void IRQ_disable (IRQ irq)
 
 void IRQ_enable (IRQ irq)
 {
+	if (IOAPIC_present ()) {
+		IOAPIC_enable (irq);
+		return;
+	}
 	uint16_t port = (irq < 8) ? PIC1_DATA : PIC2_DATA;
 	uint8_t index = irq % 8;
 	outb (port, inb (port) & ~(1 << index));
@@ -0,0 +1,104 @@
+#include "IRQ_balance.h"
+#include "IOAPIC.h"
+#include "ISR.h"
+#include "smp/smp.h"
+#include "time/clock.h"
+#include "time/timer.h"
+#include "x86/control.h"
+#include <stddef.h>
+
+enum {
+	// Below this many interrupts per pass on the busiest CPU, moving
+	// anything costs more locality than it gains
+	BALANCE_MIN_INTERRUPTS = 100
+};
+
+static uint64_t          last_totals [IOAPIC_IRQS];
+static uint64_t          interval_ns;
+static timer             balance_timer;
+static IRQ_balance_stats stats;
+
+static
+uint64_t total (IRQ irq)
+{
+	uint64_t sum = 0;
+	for (uint32_t cpu = 0; cpu < MAX_CPUS; ++cpu)
+		if (cpu == 0 || smp_cpu_online (cpu))
+			sum += ISR_count (cpu, INT_IRQ_MBASE + irq);
+	return sum;
+}
+
+static
+void balance_tick (__attribute__ ((unused)) void* arg)
+{
+	IRQ_balance_run ();
+	if (interval_ns != 0)
+		timer_arm (&balance_timer, clock_now_ns () + interval_ns);
+}
+
+
+// Extern functions
+
+void IRQ_balance_start (uint64_t interval)
+{
+	for (uint32_t irq = 0; irq < IOAPIC_IRQS; ++irq)
+		last_totals [irq] = total (irq);
+	interval_ns   = interval;
+	balance_timer = make_timer (&balance_tick, NULL);
+	timer_arm (&balance_timer, clock_now_ns () + interval_ns);
+}
+
+void IRQ_balance_stop (void)
+{
+	interval_ns = 0;
+	timer_cancel (&balance_timer);
+}
+
+bool IRQ_balance_run (void)
+{
+	uint64_t flags = save_flags_cli ();
+	++stats.passes;
+
+	uint64_t counts [IOAPIC_IRQS];
+	uint64_t load [MAX_CPUS] = {0};
+	for (uint32_t irq = 0; irq < IOAPIC_IRQS; ++irq) {
+		counts [irq] = 0;
+		if (!IOAPIC_routed (irq))
+			continue;
+		uint64_t now = total (irq);
+		counts [irq] = now - last_totals [irq];
+		last_totals [irq] = now;
+		load [IOAPIC_target (irq)] += counts [irq];
+	}
+
+	uint32_t busiest = 0, idlest = 0;
+	for (uint32_t cpu = 1; cpu < MAX_CPUS; ++cpu) {
+		if (!smp_cpu_online (cpu))
+			continue;
+		if (load [cpu] > load [busiest])
+			busiest = cpu;
+		if (load [cpu] < load [idlest])
+			idlest = cpu;
+	}
+
+	// The largest IRQ that still leaves the idlest CPU below the busiest
+	uint64_t gap = load [busiest] - load [idlest];
+	uint32_t chosen = IOAPIC_IRQS;
+	if (load [busiest] >= BALANCE_MIN_INTERRUPTS && gap > load [busiest] / 4)
+		for (uint32_t irq = 0; irq < IOAPIC_IRQS; ++irq)
+			if (counts [irq] != 0 && counts [irq] < gap &&
+			    IOAPIC_target (irq) == busiest &&
+			    (IOAPIC_affinity (irq) & ((cpu_mask) 1 << idlest)) &&
+			    (chosen == IOAPIC_IRQS || counts [irq] > counts [chosen]))
+				chosen = irq;
+
+	bool moved = chosen != IOAPIC_IRQS && IOAPIC_set_target (chosen, idlest);
+	stats.moves += moved;
+	restore_flags (flags);
+	return moved;
+}
+
+IRQ_balance_stats IRQ_balance_statistics (void)
+{
+	return stats;
+}
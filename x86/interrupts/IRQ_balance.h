@@ -0,0 +1,31 @@
+#ifndef IRQ_BALANCE_H
+#define IRQ_BALANCE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Spreads I/O APIC interrupts over the CPUs by the number each IRQ raised
+ * since the last pass, as counted by ISR_entry. A pass moves at most one IRQ,
+ * from the busiest CPU to the least busy one allowed by its affinity, and
+ * only if that narrows the gap; an IRQ that stays put keeps its cache-warm
+ * CPU. Moves go through IOAPIC_set_target, so move hooks carry a driver's
+ * deferred work along.
+ */
+
+typedef struct IRQ_balance_stats {
+	uint64_t passes;
+	uint64_t moves;
+} IRQ_balance_stats;
+
+// Runs a pass every interval_ns from a timer on the calling CPU
+void IRQ_balance_start (uint64_t interval_ns);
+
+// Must be called on the CPU that called IRQ_balance_start
+void IRQ_balance_stop (void);
+
+// A single pass. Returns true if an IRQ moved.
+bool IRQ_balance_run (void);
+
+IRQ_balance_stats IRQ_balance_statistics (void);
+
+#endif
@@ -1,9 +1,14 @@
 #include "ISR.h"
 #include "IRQ.h"
+#include "IOAPIC.h"
+#include "LAPIC.h"
+#include "smp/percpu.h"
 #include <stddef.h>
 
 ISR_table_t* ISR_table;
 
+static DEFINE_PER_CPU (uint64_t, ISR_counts [INT_LIMIT]);
+
 
 // Extern functions
 
@@ -14,21 +19,33 @@ void ISR_entry (uint32_t interrupt, uint64_t error)
 	 * (LPT1 for the primary PIC, HDD2 for the secondary PIC). The interrupt
 	 * handler should not be run and EOI should not be signalled for
 	 * spurious interrupts; however the primary PIC still must receive an
-	 * EOI for spurious interrupts proxied from the secondary PIC.
+	 * EOI for spurious interrupts proxied from the secondary PIC. With
+	 * the I/O APIC in charge, the 8259s are masked and none of this
+	 * applies.
 	 */
-	if (interrupt == INT_LPT1 && !IRQ_in_service (IRQ_LPT1))
+	bool ioapic = IOAPIC_present ();
+	if (!ioapic && interrupt == INT_LPT1 && !IRQ_in_service (IRQ_LPT1))
 		return;
-	if (interrupt == INT_HDD2 && !IRQ_in_service (IRQ_HDD2)) {
+	if (!ioapic && interrupt == INT_HDD2 && !IRQ_in_service (IRQ_HDD2)) {
 		IRQ_EOI_master ();
 		return;
 	}
+	// Spurious local APIC interrupts do not set an in-service bit, so they
+	// must not be acknowledged either.
+	if (interrupt == INT_LAPIC_spurious)
+		return;
 
+	this_cpu_add (ISR_counts [interrupt], 1);
 	(*(*ISR_table) [interrupt]) (interrupt, error);
 
-	if (INT_IRQ_MBASE <= interrupt && interrupt < INT_IRQ_SBASE)
+	if (ioapic && INT_IRQ_MBASE <= interrupt)
+		LAPIC_EOI ();
+	else if (INT_IRQ_MBASE <= interrupt && interrupt < INT_IRQ_SBASE)
 		IRQ_EOI_master ();
-	else if (INT_IRQ_SBASE <= interrupt)
+	else if (INT_IRQ_SBASE <= interrupt && interrupt < INT_LAPIC_BASE)
 		IRQ_EOI_slave ();
+	else if (INT_LAPIC_BASE <= interrupt)
+		LAPIC_EOI ();
 }
 
 void null_ISR (__attribute__ ((unused)) INT_index interrupt,
@@ -36,6 +53,11 @@ void null_ISR (__attribute__ ((unused)) INT_index interrupt,
 {
 }
 
+uint64_t ISR_count (uint32_t cpu, INT_index interrupt)
+{
+	return __atomic_load_n (&(*per_cpu_ptr (ISR_counts, cpu)) [interrupt], __ATOMIC_RELAXED);
+}
+
 void set_ISR (INT_index interrupt, ISR_t isr)
 {
 	(*ISR_table) [(size_t)interrupt] = isr;
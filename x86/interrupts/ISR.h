@@ -42,10 +42,18 @@ typedef enum {
 	INT_HDD1     = 0x2E,
 	INT_HDD2     = 0x2F,
 
+	// Local APIC
+	INT_LAPIC_timer    = 0x30,
+	INT_IPI_wakeup     = 0x31,
+	INT_IPI_call       = 0x32,
+	INT_LAPIC_error    = 0x3E,
+	INT_LAPIC_spurious = 0x3F, // Low four bits must be set on P6-family CPUs
+
 	// Limits
-	INT_IRQ_MBASE = 0x20,
-	INT_IRQ_SBASE = 0x28,
-	INT_LIMIT     = 0x30
+	INT_IRQ_MBASE  = 0x20,
+	INT_IRQ_SBASE  = 0x28,
+	INT_LAPIC_BASE = 0x30,
+	INT_LIMIT      = 0x40
 } INT_index;
 
 typedef void (*ISR_t) (INT_index interrupt, uint64_t error);
@@ -54,6 +62,10 @@ typedef ISR_t ISR_table_t [INT_LIMIT];
 extern ISR_table_t* ISR_table;
 
 void null_ISR (INT_index interrupt, uint64_t error);
+
+// Interrupts handled by the given CPU on the given vector since boot
+uint64_t ISR_count (uint32_t cpu, INT_index interrupt);
+
 void set_ISR (INT_index interrupt, ISR_t isr);
 void ISR_table_initialize (ISR_table_t* table, ISR_t default_ISR);
 
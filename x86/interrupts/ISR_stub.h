@@ -40,6 +40,22 @@ extern void _ISR_2C (void);
 extern void _ISR_2D (void);
 extern void _ISR_2E (void);
 extern void _ISR_2F (void);
+extern void _ISR_30 (void);
+extern void _ISR_31 (void);
+extern void _ISR_32 (void);
+extern void _ISR_33 (void);
+extern void _ISR_34 (void);
+extern void _ISR_35 (void);
+extern void _ISR_36 (void);
+extern void _ISR_37 (void);
+extern void _ISR_38 (void);
+extern void _ISR_39 (void);
+extern void _ISR_3A (void);
+extern void _ISR_3B (void);
+extern void _ISR_3C (void);
+extern void _ISR_3D (void);
+extern void _ISR_3E (void);
+extern void _ISR_3F (void);
 
 #define _LOW_ISR(i) ((void (*)(void))((const char*)&_ISR_00 + (i)*_linkaddr(_isr_size)))
 #define _HIGH_ISR(i) ((void (*)(void))((const char*)&_ISR_20 + (i)*_linkaddr(_isr_size)))
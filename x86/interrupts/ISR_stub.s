@@ -48,7 +48,7 @@ _ISR_entry:
         movq 16(%rsp), %rsi
         jmp _ISR_entry
         # The final jmp mnemonic above is assembled into a different encoding
-        # depending on the distance between the source and destination. _ISR_2F
+        # depending on the distance between the source and destination. _ISR_3F
         # at the farthest takes 0x23 bytes, so pad to that size (that way the
 	# IDT initialization routine can be implemented as a loop).
         . = \name + 0x23
@@ -92,3 +92,19 @@ _ISR_entry:
 	.isr $0x2D _ISR_2D
 	.isr $0x2E _ISR_2E
 	.isr $0x2F _ISR_2F
+	.isr $0x30 _ISR_30
+	.isr $0x31 _ISR_31
+	.isr $0x32 _ISR_32
+	.isr $0x33 _ISR_33
+	.isr $0x34 _ISR_34
+	.isr $0x35 _ISR_35
+	.isr $0x36 _ISR_36
+	.isr $0x37 _ISR_37
+	.isr $0x38 _ISR_38
+	.isr $0x39 _ISR_39
+	.isr $0x3A _ISR_3A
+	.isr $0x3B _ISR_3B
+	.isr $0x3C _ISR_3C
+	.isr $0x3D _ISR_3D
+	.isr $0x3E _ISR_3E
+	.isr $0x3F _ISR_3F
@@ -0,0 +1,77 @@
+#include "LAPIC.h"
+#include "ISR.h"
+#include "x86/cpuid.h"
+#include "x86/control.h"
+#include "x86/msr.h"
+#include <stddef.h>
+
+static volatile uint8_t* lapic_base;
+
+
+// Extern functions
+
+void LAPIC_initialize (void)
+{
+	if (!(cpuid (1, 0).edx & CPUID_1_EDX_APIC))
+		return;
+	if (lapic_base != NULL && (LAPIC_read (LAPIC_REG_SVR) & LAPIC_SVR_ENABLE))
+		return;
+
+	uint64_t base = rdmsr (MSR_IA32_APIC_BASE) | LAPIC_BASE_ENABLE;
+	wrmsr (MSR_IA32_APIC_BASE, base);
+	lapic_base = (volatile uint8_t*) (uintptr_t) (base & LAPIC_BASE_MASK);
+
+	LAPIC_write (LAPIC_REG_TPR, 0);
+	LAPIC_write (LAPIC_REG_LVT_TIMER, LAPIC_LVT_MASKED | INT_LAPIC_timer);
+	LAPIC_write (LAPIC_REG_LVT_ERROR, INT_LAPIC_error);
+	LAPIC_write (LAPIC_REG_SVR, LAPIC_SVR_ENABLE | INT_LAPIC_spurious);
+}
+
+bool LAPIC_present (void)
+{
+	return lapic_base != NULL;
+}
+
+uint32_t LAPIC_read (uint32_t reg)
+{
+	return *(volatile uint32_t*) (lapic_base + reg);
+}
+
+void LAPIC_write (uint32_t reg, uint32_t value)
+{
+	*(volatile uint32_t*) (lapic_base + reg) = value;
+}
+
+uint8_t LAPIC_id (void)
+{
+	return LAPIC_read (LAPIC_REG_ID) >> 24;
+}
+
+void LAPIC_EOI (void)
+{
+	LAPIC_write (LAPIC_REG_EOI, 0);
+}
+
+void LAPIC_send_command (uint8_t apic_id, uint32_t command)
+{
+	while (LAPIC_read (LAPIC_REG_ICR_LOW) & LAPIC_ICR_PENDING)
+		cpu_relax ();
+	LAPIC_write (LAPIC_REG_ICR_HIGH, (uint32_t) apic_id << 24);
+	LAPIC_write (LAPIC_REG_ICR_LOW, command);
+}
+
+void LAPIC_send_IPI (uint8_t apic_id, uint8_t vector)
+{
+	LAPIC_send_command (apic_id, LAPIC_ICR_FIXED | LAPIC_ICR_ASSERT | vector);
+}
+
+void LAPIC_send_INIT (uint8_t apic_id)
+{
+	LAPIC_send_command (apic_id, LAPIC_ICR_INIT | LAPIC_ICR_LEVEL | LAPIC_ICR_ASSERT);
+	LAPIC_send_command (apic_id, LAPIC_ICR_INIT | LAPIC_ICR_LEVEL);
+}
+
+void LAPIC_send_SIPI (uint8_t apic_id, uint8_t page)
+{
+	LAPIC_send_command (apic_id, LAPIC_ICR_STARTUP | LAPIC_ICR_ASSERT | page);
+}
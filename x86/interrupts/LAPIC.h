@@ -0,0 +1,67 @@
+#ifndef LAPIC_H
+#define LAPIC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+enum {
+	// Local APIC register offsets
+	LAPIC_REG_ID            = 0x020,
+	LAPIC_REG_VERSION       = 0x030,
+	LAPIC_REG_TPR           = 0x080,
+	LAPIC_REG_EOI           = 0x0B0,
+	LAPIC_REG_SVR           = 0x0F0,
+	LAPIC_REG_ESR           = 0x280,
+	LAPIC_REG_ICR_LOW       = 0x300,
+	LAPIC_REG_ICR_HIGH      = 0x310,
+	LAPIC_REG_LVT_TIMER     = 0x320,
+	LAPIC_REG_LVT_LINT0     = 0x350,
+	LAPIC_REG_LVT_LINT1     = 0x360,
+	LAPIC_REG_LVT_ERROR     = 0x370,
+	LAPIC_REG_TIMER_INITIAL = 0x380,
+	LAPIC_REG_TIMER_CURRENT = 0x390,
+	LAPIC_REG_TIMER_DIVIDE  = 0x3E0,
+
+	// IA32_APIC_BASE MSR
+	LAPIC_BASE_ENABLE = 1 << 11,
+	LAPIC_BASE_MASK   = ~0xFFF,
+
+	// Spurious interrupt vector register
+	LAPIC_SVR_ENABLE = 1 << 8,
+
+	// Local vector table entries
+	LAPIC_LVT_MASKED             = 1 << 16,
+	LAPIC_LVT_TIMER_ONESHOT      = 0 << 17,
+	LAPIC_LVT_TIMER_PERIODIC     = 1 << 17,
+	LAPIC_LVT_TIMER_TSC_DEADLINE = 2 << 17,
+
+	// Timer divide configuration
+	LAPIC_TIMER_DIVIDE_16 = 0x3,
+
+	// Interrupt command register
+	LAPIC_ICR_FIXED   = 0 << 8,
+	LAPIC_ICR_INIT    = 5 << 8,
+	LAPIC_ICR_STARTUP = 6 << 8,
+	LAPIC_ICR_PENDING = 1 << 12,
+	LAPIC_ICR_ASSERT  = 1 << 14,
+	LAPIC_ICR_LEVEL   = 1 << 15
+};
+
+// Enables the local APIC of the calling CPU in xAPIC mode. The 8259 remains
+// connected through LINT0 as configured by the firmware. Calling it again on
+// the same CPU has no further effect.
+void LAPIC_initialize (void);
+
+bool LAPIC_present (void);
+uint32_t LAPIC_read (uint32_t reg);
+void LAPIC_write (uint32_t reg, uint32_t value);
+uint8_t LAPIC_id (void);
+void LAPIC_EOI (void);
+void LAPIC_send_command (uint8_t apic_id, uint32_t command);
+void LAPIC_send_IPI (uint8_t apic_id, uint8_t vector);
+
+// INIT-SIPI-SIPI start-up; the AP begins executing in real mode at page << 12
+void LAPIC_send_INIT (uint8_t apic_id);
+void LAPIC_send_SIPI (uint8_t apic_id, uint8_t page);
+
+#endif
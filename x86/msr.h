@@ -0,0 +1,30 @@
+#ifndef MSR_H
+#define MSR_H
+
+#include <stdint.h>
+
+enum {
+	MSR_IA32_APIC_BASE      = 0x0000001B,
+	MSR_IA32_TSC_DEADLINE   = 0x000006E0,
+	MSR_IA32_EFER           = 0xC0000080,
+	MSR_IA32_GS_BASE        = 0xC0000101,
+	MSR_IA32_KERNEL_GS_BASE = 0xC0000102
+};
+
+static inline
+__attribute__ ((always_inline))
+uint64_t rdmsr (uint32_t msr)
+{
+	uint32_t low, high;
+	__asm__ volatile ("rdmsr" : "=a" (low), "=d" (high) : "c" (msr));
+	return (uint64_t) high << 32 | low;
+}
+
+static inline
+__attribute__ ((always_inline))
+void wrmsr (uint32_t msr, uint64_t value)
+{
+	__asm__ volatile ("wrmsr" :: "a" ((uint32_t) value), "d" ((uint32_t) (value >> 32)), "c" (msr));
+}
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef TSC_H
+#define TSC_H
+
+#include <stdint.h>
+
+static inline
+__attribute__ ((always_inline))
+uint64_t rdtsc (void)
+{
+	uint32_t low, high;
+	__asm__ volatile ("rdtsc" : "=a" (low), "=d" (high));
+	return (uint64_t) high << 32 | low;
+}
+
+// Waits for all prior instructions to complete before reading the TSC, so that
+// the end of a measured interval is not read early.
+static inline
+__attribute__ ((always_inline))
+uint64_t rdtsc_ordered (void)
+{
+	uint32_t low, high;
+	__asm__ volatile ("lfence; rdtsc" : "=a" (low), "=d" (high) :: "memory");
+	return (uint64_t) high << 32 | low;
+}
+
+#endif